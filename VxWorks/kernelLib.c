@@ -0,0 +1,162 @@
+/*****************************************************************************
+ * kernelLib.c - start up and scheduling settings of the v2lin VxWorks (R)
+ *               compatibility layer.
+ *
+ *               v2lin_init installs the signal handlers taskLib uses to
+ *               reach other tasks.  Every other entry point into the shim
+ *               calls it too, so forgetting it in main() is harmless.
+ *               There is no tick task: delays and timeouts sleep until an
+ *               absolute deadline, and wdLib has its own timer task.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "vxWorks.h"
+#include "taskLib.h"
+#include "v2lin.h"
+
+/*
+**  Tasks are spawned SCHED_FIFO, or SCHED_RR with round-robin enabled,
+**  when the process may use real-time priorities.  Otherwise they run
+**  SCHED_OTHER and VxWorks priorities are only recorded.
+*/
+static int round_robin = FALSE;
+static int time_slice = 0;
+static int real_time = FALSE;
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+/*****************************************************************************
+**  wake_handler - does nothing, being delivered is enough to interrupt the
+**                 system call the task is blocked in
+*****************************************************************************/
+static void
+    wake_handler( int sig )
+{
+}
+
+/*****************************************************************************
+**  suspend_handler - holds a task suspended by taskSuspend until taskResume
+**                    clears its suspended word.  Only futex calls are made,
+**                    which are safe in a signal handler.
+*****************************************************************************/
+static void
+    suspend_handler( int sig, siginfo_t *info, void *context )
+{
+    v2pthread_cb_t *tcb = (v2pthread_cb_t *)info->si_value.sival_ptr;
+
+    while ( __atomic_load_n( &tcb->suspended, __ATOMIC_ACQUIRE ) )
+        syscall( SYS_futex, &tcb->suspended, FUTEX_WAIT_PRIVATE, 1, NULL,
+                 NULL, 0 );
+}
+
+/*****************************************************************************
+**  init - one-off set up, see v2lin_init
+*****************************************************************************/
+static void
+    init( void )
+{
+    struct sigaction action;
+    struct rlimit rtprio;
+
+    memset( &action, 0, sizeof( action ) );
+    sigemptyset( &action.sa_mask );
+
+    /*
+    **  No SA_RESTART, interrupted futex waits and sleeps have to return
+    */
+    action.sa_handler = wake_handler;
+    sigaction( V2LIN_SIG_WAKE, &action, NULL );
+
+    action.sa_flags = SA_SIGINFO;
+    action.sa_sigaction = suspend_handler;
+    sigaction( V2LIN_SIG_SUSPEND, &action, NULL );
+
+    real_time = (geteuid() == 0) ||
+                ((getrlimit( RLIMIT_RTPRIO, &rtprio ) == 0) &&
+                 (rtprio.rlim_cur >= sched_get_priority_max( SCHED_FIFO )));
+}
+
+/*****************************************************************************
+**  v2lin_init_once - runs the set up the first time any caller gets here
+*****************************************************************************/
+void
+    v2lin_init_once( void )
+{
+    pthread_once( &init_once, init );
+}
+
+/*****************************************************************************
+**  v2lin_init - sets up the shim, should be called first thing in main()
+*****************************************************************************/
+int
+    v2lin_init( void )
+{
+    v2lin_init_once();
+    return( OK );
+}
+
+/*****************************************************************************
+**  v2lin_policy - scheduling policy for newly spawned tasks
+*****************************************************************************/
+int
+    v2lin_policy( void )
+{
+    if ( real_time == FALSE )
+        return( SCHED_OTHER );
+    return( round_robin ? SCHED_RR : SCHED_FIFO );
+}
+
+/*****************************************************************************
+**  Round-robin controls, only tasks spawned afterwards are affected
+*****************************************************************************/
+void
+    disableRoundRobin( void )
+{
+    round_robin = FALSE;
+}
+
+void
+    enableRoundRobin( void )
+{
+    round_robin = TRUE;
+}
+
+BOOL
+    roundRobinIsEnabled( void )
+{
+    return( round_robin );
+}
+
+/*****************************************************************************
+**  kernelTimeSlice - 0 turns round-robin off, anything else turns it on.
+**                    Linux picks the SCHED_RR quantum itself, the number of
+**                    ticks is only recorded.
+*****************************************************************************/
+STATUS
+    kernelTimeSlice( int ticks_per_quantum )
+{
+    time_slice = ticks_per_quantum;
+    if ( ticks_per_quantum == 0 )
+        disableRoundRobin();
+    else
+        enableRoundRobin();
+    return( OK );
+}
@@ -0,0 +1,797 @@
+/*****************************************************************************
+ * msgQLib.c - message queues for the v2lin VxWorks (R) compatibility layer,
+ *             built on the lock-free ring below rather than a mutex and
+ *             condition variable.
+ *
+ *             Each queue is a bounded multi-producer, multi-consumer ring
+ *             of fixed size cells.  Every cell carries a sequence number
+ *             saying whether it is free or full for the current lap of the
+ *             ring, so senders and receivers claim cells with a single
+ *             compare-and-swap and never take a lock.  Tasks only enter the
+ *             kernel to sleep on a full or empty queue, on the pend queue of
+ *             its receivers or of one ring's senders, see qLib.c.  Every
+ *             message sent wakes one receiver and every cell freed one
+ *             sender, the first in MSG_Q_FIFO or MSG_Q_PRIORITY order.
+ *
+ *             Messages are written and read in place: msgQLoan hands the
+ *             sender a cell's buffer to fill and msgQCommit publishes it,
+ *             msgQReceiveBatch drains every ready message in one claim.
+ *
+ *             A MSG_Q_ID is a handle into queue_table, see objLib.c.  A
+ *             deleted queue's rings are freed but its header is kept for
+ *             the next queue created.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vxWorks.h"
+#include "msgQLib.h"
+#include "v2lin.h"
+
+#define MSGQ_ALIGN  64         /* cache line, cells and indexes never share one */
+
+/*
+**  Urgent messages have a ring of their own which receivers always empty
+**  first, a lock-free FIFO can't put a message at its head.
+*/
+#define MSGQ_NORMAL 0
+#define MSGQ_URGENT 1
+#define MSGQ_RINGS  2
+
+/*****************************************************************************
+**  One message slot.  seq == 2 * pos while free for the sender claiming
+**  ring position pos, seq == 2 * pos + 1 once that message is committed,
+**  and seq == 2 * (pos + depth) after it has been received, free for the
+**  next lap.  Counting in twos keeps a committed cell from looking free
+**  for the next lap when depth is 1.
+*****************************************************************************/
+typedef struct
+{
+    uint64_t
+        seq;
+    uint32_t
+        len;
+    char
+        data[];
+} msgq_cell_t;
+
+typedef struct
+{
+        /*
+        ** Next position to send to and to receive from, only ever increase
+        */
+    uint64_t
+        enq __attribute__((aligned(MSGQ_ALIGN)));
+    uint64_t
+        deq __attribute__((aligned(MSGQ_ALIGN)));
+
+    char
+        *cells;
+
+        /*
+        ** Senders waiting for a free cell of this ring
+        */
+    v2lin_pendq_t
+        send_pend;
+} msgq_ring_t;
+
+typedef struct
+{
+        /*
+        ** The queue's ID, 0 once it is being deleted
+        */
+    int
+        handle;
+    uint32_t
+        depth;
+    uint32_t
+        msglen;
+    uint32_t
+        stride;
+
+        /*
+        ** Set by msgQDelete, users counts calls (and loans) still inside the
+        ** queue so its rings aren't freed under them
+        */
+    int
+        deleted;
+    int
+        users;
+
+        /*
+        ** Receivers waiting for a message
+        */
+    v2lin_pendq_t
+        recv_pend __attribute__((aligned(MSGQ_ALIGN)));
+
+    msgq_ring_t
+        ring[MSGQ_RINGS];
+} msgq_t;
+
+/*****************************************************************************
+**  A sender or receiver waiting on one of a queue's pend queues
+*****************************************************************************/
+typedef struct
+{
+    msgq_t *
+        queue;
+    v2lin_pendq_t *
+        pend;
+    v2lin_pender_t
+        pender;
+} msgq_wait_t;
+
+/*
+**  Every queue, by MSG_Q_ID
+*/
+static v2lin_table_t queue_table = V2LIN_TABLE_INITIALIZER;
+
+/*****************************************************************************
+**  wake_pend - wakes up to count tasks waiting on a pend queue, after a
+**              commit or receive has made a message or cells available.
+**              Only takes the lock if someone is waiting.
+*****************************************************************************/
+static void
+    wake_pend( v2lin_pendq_t *pend, int count )
+{
+    /*
+    **  Orders the cell just published or freed against the count, as
+    **  pend_on orders them the other way round for a waiter
+    */
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    if ( __atomic_load_n( &pend->count, __ATOMIC_RELAXED ) != 0 )
+    {
+        pthread_mutex_lock( &pend->lock );
+        v2lin_pend_wake( pend, count, V2LIN_PEND_READY );
+        pthread_mutex_unlock( &pend->lock );
+    }
+}
+
+/*****************************************************************************
+**  pend_on - puts the calling task on a pend queue.  The caller then has to
+**            look for a message or cell once more before it sleeps.
+*****************************************************************************/
+static void
+    pend_on( msgq_wait_t *wait )
+{
+    pthread_mutex_lock( &wait->pend->lock );
+    v2lin_pend_insert( wait->pend, &wait->pender );
+    pthread_mutex_unlock( &wait->pend->lock );
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+}
+
+/*****************************************************************************
+**  pend_off - takes the calling task off its pend queue.  Returns the state
+**             it had been woken with, V2LIN_PEND_WAITING if none, and with
+**             pass_on set hands a wake it won't use to the next task.
+*****************************************************************************/
+static int
+    pend_off( msgq_wait_t *wait, int pass_on )
+{
+    int state;
+
+    pthread_mutex_lock( &wait->pend->lock );
+    state = v2lin_pend_remove( wait->pend, &wait->pender );
+    if ( pass_on && (state == V2LIN_PEND_READY) )
+        v2lin_pend_wake( wait->pend, 1, V2LIN_PEND_READY );
+    pthread_mutex_unlock( &wait->pend->lock );
+    return( state );
+}
+
+/*****************************************************************************
+**  cell_at - the cell used by a ring position
+*****************************************************************************/
+static inline msgq_cell_t *
+    cell_at( msgq_t *queue, msgq_ring_t *ring, uint64_t pos )
+{
+    return( (msgq_cell_t *)(ring->cells + (pos % queue->depth) * queue->stride) );
+}
+
+/*****************************************************************************
+**  queue_enter - validates a queue and counts the caller as one of its users.
+**                Returns NULL, with errno set, if the queue isn't usable.
+*****************************************************************************/
+static msgq_t *
+    queue_enter( MSG_Q_ID queue_id )
+{
+    int id = (int)(intptr_t)queue_id;
+    msgq_t *queue = v2lin_handle_get( &queue_table, id );
+
+    if ( queue == (msgq_t *)NULL )
+    {
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( (msgq_t *)NULL );
+    }
+
+    /*
+    **  msgQDelete clears the handle before waiting for users to leave, so
+    **  once counted a queue still with its ID can't be reused
+    */
+    __atomic_add_fetch( &queue->users, 1, __ATOMIC_SEQ_CST );
+    if ( __atomic_load_n( &queue->handle, __ATOMIC_SEQ_CST ) != id )
+    {
+        __atomic_sub_fetch( &queue->users, 1, __ATOMIC_RELEASE );
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( (msgq_t *)NULL );
+    }
+    if ( __atomic_load_n( &queue->deleted, __ATOMIC_SEQ_CST ) )
+    {
+        __atomic_sub_fetch( &queue->users, 1, __ATOMIC_RELEASE );
+        errno = S_objLib_OBJ_DELETED;
+        return( (msgq_t *)NULL );
+    }
+    return( queue );
+}
+
+/*****************************************************************************
+**  queue_leave - drops a use taken by queue_enter
+*****************************************************************************/
+static void
+    queue_leave( msgq_t *queue )
+{
+    __atomic_sub_fetch( &queue->users, 1, __ATOMIC_RELEASE );
+}
+
+/*****************************************************************************
+**  wait_cancelled - takes a blocked sender or receiver off its pend queue
+**                   when taskDelete ends it, handing on any wake it had
+**                   just been given
+*****************************************************************************/
+static void
+    wait_cancelled( void *arg )
+{
+    msgq_wait_t *wait = (msgq_wait_t *)arg;
+
+    pend_off( wait, TRUE );
+    queue_leave( wait->queue );
+}
+
+/*****************************************************************************
+**  claim_cell - claims the next free cell of a ring for a sender.  Returns
+**               NULL if the ring is full.
+*****************************************************************************/
+static msgq_cell_t *
+    claim_cell( msgq_t *queue, msgq_ring_t *ring )
+{
+    msgq_cell_t *cell;
+    uint64_t pos;
+    int64_t dif;
+
+    pos = __atomic_load_n( &ring->enq, __ATOMIC_RELAXED );
+    for (;;)
+    {
+        cell = cell_at( queue, ring, pos );
+        dif = (int64_t)(__atomic_load_n( &cell->seq, __ATOMIC_ACQUIRE ) -
+                        2 * pos);
+        if ( dif == 0 )
+        {
+            if ( __atomic_compare_exchange_n( &ring->enq, &pos, pos + 1, 1,
+                                              __ATOMIC_RELAXED,
+                                              __ATOMIC_RELAXED ) )
+                return( cell );
+        }
+        else if ( dif < 0 )
+            return( (msgq_cell_t *)NULL );
+        else
+            pos = __atomic_load_n( &ring->enq, __ATOMIC_RELAXED );
+    }
+}
+
+/*****************************************************************************
+**  claim_ready - claims up to max committed messages from the head of a
+**                ring for a receiver.  Returns the number claimed, with the
+**                ring position of the first in *first.
+*****************************************************************************/
+static int
+    claim_ready( msgq_t *queue, msgq_ring_t *ring, int max, uint64_t *first )
+{
+    msgq_cell_t *cell;
+    uint64_t pos;
+    int64_t dif;
+    int count;
+
+    pos = __atomic_load_n( &ring->deq, __ATOMIC_RELAXED );
+    for (;;)
+    {
+        cell = cell_at( queue, ring, pos );
+        dif = (int64_t)(__atomic_load_n( &cell->seq, __ATOMIC_ACQUIRE ) -
+                        (2 * pos + 1));
+        if ( dif < 0 )
+            return( 0 );
+        if ( dif > 0 )
+        {
+            pos = __atomic_load_n( &ring->deq, __ATOMIC_RELAXED );
+            continue;
+        }
+
+        /*
+        **  Take every committed message after it too, all in one claim
+        */
+        for ( count = 1; count < max; count++ )
+        {
+            cell = cell_at( queue, ring, pos + count );
+            if ( __atomic_load_n( &cell->seq, __ATOMIC_ACQUIRE ) !=
+                 2 * (pos + count) + 1 )
+                break;
+        }
+        if ( __atomic_compare_exchange_n( &ring->deq, &pos, pos + count, 1,
+                                          __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED ) )
+        {
+            *first = pos;
+            return( count );
+        }
+    }
+}
+
+/*****************************************************************************
+**  head_ready - TRUE if the message at the head of a ring is committed,
+**               ready for the next receiver
+*****************************************************************************/
+static int
+    head_ready( msgq_t *queue, msgq_ring_t *ring )
+{
+    uint64_t pos = __atomic_load_n( &ring->deq, __ATOMIC_RELAXED );
+
+    return( __atomic_load_n( &cell_at( queue, ring, pos )->seq,
+                             __ATOMIC_ACQUIRE ) == 2 * pos + 1 );
+}
+
+/*****************************************************************************
+**  take_msgs - copies up to maxmsgs messages out of a queue, urgent ones
+**              first.  Message i goes to msgbuf + i * buflen, truncated to
+**              buflen, and its length to msglens[i] when msglens isn't NULL.
+**              Returns the number of messages taken.
+*****************************************************************************/
+static int
+    take_msgs( msgq_t *queue, char *msgbuf, uint buflen, int maxmsgs,
+               uint *msglens )
+{
+    msgq_ring_t *ring;
+    msgq_cell_t *cell;
+    uint64_t first;
+    uint len;
+    int taken = 0;
+    int count;
+    int ring_num;
+    int i;
+
+    for ( ring_num = MSGQ_URGENT; ring_num >= MSGQ_NORMAL && taken < maxmsgs;
+          ring_num-- )
+    {
+        ring = &queue->ring[ring_num];
+        count = claim_ready( queue, ring, maxmsgs - taken, &first );
+        for ( i = 0; i < count; i++, taken++ )
+        {
+            cell = cell_at( queue, ring, first + i );
+            len = cell->len < buflen ? cell->len : buflen;
+            memcpy( msgbuf + (size_t)taken * buflen, cell->data, len );
+            if ( msglens != (uint *)NULL )
+                msglens[taken] = len;
+
+            /*
+            **  Free the cell for the sender one lap on
+            */
+            __atomic_store_n( &cell->seq, 2 * (first + i + queue->depth),
+                              __ATOMIC_RELEASE );
+        }
+        if ( count > 0 )
+            wake_pend( &ring->send_pend, count );
+    }
+
+    /*
+    **  A commit behind a cell still on loan wakes a receiver that finds
+    **  nothing, and the commit of that cell wakes just one.  Whoever
+    **  takes messages and leaves some ready wakes the next receiver, as
+    **  semLib's grant keeps handing a semaphore on.
+    */
+    if ( (taken > 0) && (head_ready( queue, &queue->ring[MSGQ_URGENT] ) ||
+                         head_ready( queue, &queue->ring[MSGQ_NORMAL] )) )
+        wake_pend( &queue->recv_pend, 1 );
+    return( taken );
+}
+
+/*****************************************************************************
+**  free_rings - frees a queue's rings
+*****************************************************************************/
+static void
+    free_rings( msgq_t *queue )
+{
+    int ring_num;
+
+    for ( ring_num = 0; ring_num < MSGQ_RINGS; ring_num++ )
+    {
+        free( queue->ring[ring_num].cells );
+        queue->ring[ring_num].cells = (char *)NULL;
+    }
+}
+
+/*****************************************************************************
+**  msgQCreate - creates a queue of max_msgs messages of up to msglen bytes.
+**               Tasks waiting on the queue are woken in the order they
+**               started waiting, or highest priority first if opt has
+**               MSG_Q_PRIORITY.
+*****************************************************************************/
+MSG_Q_ID
+    msgQCreate( int max_msgs, int msglen, int opt )
+{
+    msgq_t *queue;
+    msgq_cell_t *cell;
+    int ring_num;
+    int id;
+    uint32_t i;
+
+    if ( (max_msgs <= 0) || (msglen < 0) )
+    {
+        errno = S_msgQLib_INVALID_MSG_LENGTH;
+        return( (MSG_Q_ID)NULL );
+    }
+
+    queue = v2lin_handle_open( &queue_table, &id );
+    if ( id == ERROR )
+        return( (MSG_Q_ID)NULL );
+    if ( queue == (msgq_t *)NULL )
+    {
+        queue = aligned_alloc( MSGQ_ALIGN, sizeof( msgq_t ) );
+        if ( queue == (msgq_t *)NULL )
+        {
+            v2lin_handle_close( &queue_table, id, NULL );
+            errno = S_memLib_NOT_ENOUGH_MEMORY;
+            return( (MSG_Q_ID)NULL );
+        }
+        memset( queue, 0, sizeof( msgq_t ) );
+        v2lin_pendq_init( &queue->recv_pend, FALSE );
+        for ( ring_num = 0; ring_num < MSGQ_RINGS; ring_num++ )
+            v2lin_pendq_init( &queue->ring[ring_num].send_pend, FALSE );
+    }
+
+    /*
+    **  A stale queue_enter may still be counting itself in and out of users
+    **  of a reused header, which is otherwise started afresh
+    */
+    queue->deleted = FALSE;
+    queue->recv_pend.by_priority = (opt & MSG_Q_PRIORITY) != 0;
+    queue->depth = max_msgs;
+    queue->msglen = msglen;
+    queue->stride = (sizeof( msgq_cell_t ) + msglen + MSGQ_ALIGN - 1) &
+                    ~(MSGQ_ALIGN - 1);
+
+    for ( ring_num = 0; ring_num < MSGQ_RINGS; ring_num++ )
+    {
+        queue->ring[ring_num].enq = 0;
+        queue->ring[ring_num].deq = 0;
+        queue->ring[ring_num].send_pend.by_priority =
+            (opt & MSG_Q_PRIORITY) != 0;
+        queue->ring[ring_num].cells = aligned_alloc( MSGQ_ALIGN,
+                                      (size_t)queue->stride * max_msgs );
+        if ( queue->ring[ring_num].cells == (char *)NULL )
+        {
+            free_rings( queue );
+            v2lin_handle_close( &queue_table, id, queue );
+            errno = S_memLib_NOT_ENOUGH_MEMORY;
+            return( (MSG_Q_ID)NULL );
+        }
+        for ( i = 0; i < queue->depth; i++ )
+        {
+            cell = cell_at( queue, &queue->ring[ring_num], i );
+            cell->seq = 2 * i;
+            cell->len = 0;
+        }
+    }
+
+    __atomic_store_n( &queue->handle, id, __ATOMIC_RELEASE );
+    v2lin_handle_publish( &queue_table, id, queue );
+    return( (MSG_Q_ID)(intptr_t)id );
+}
+
+/*****************************************************************************
+**  msgQDelete - wakes every task waiting on a queue, which return ERROR with
+**               errno S_objLib_OBJ_DELETED, then frees its rings once the
+**               last of them has left.  Outstanding loans must be committed
+**               first.
+*****************************************************************************/
+STATUS
+    msgQDelete( MSG_Q_ID queue_id )
+{
+    msgq_t *queue = queue_enter( queue_id );
+    v2lin_pendq_t *pend;
+    int ring_num;
+
+    if ( queue == (msgq_t *)NULL )
+    {
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+    if ( __atomic_exchange_n( &queue->deleted, TRUE, __ATOMIC_SEQ_CST ) )
+    {
+        queue_leave( queue );
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+
+    pthread_mutex_lock( &queue->recv_pend.lock );
+    v2lin_pend_wake( &queue->recv_pend, INT_MAX, V2LIN_PEND_DELETED );
+    pthread_mutex_unlock( &queue->recv_pend.lock );
+    for ( ring_num = 0; ring_num < MSGQ_RINGS; ring_num++ )
+    {
+        pend = &queue->ring[ring_num].send_pend;
+        pthread_mutex_lock( &pend->lock );
+        v2lin_pend_wake( pend, INT_MAX, V2LIN_PEND_DELETED );
+        pthread_mutex_unlock( &pend->lock );
+    }
+    __atomic_store_n( &queue->handle, 0, __ATOMIC_SEQ_CST );
+    queue_leave( queue );
+    v2lin_drain( &queue->users );
+
+    free_rings( queue );
+    v2lin_handle_close( &queue_table, (int)(intptr_t)queue_id, queue );
+    return( OK );
+}
+
+/*****************************************************************************
+**  msgQLoan - reserves space for one message and returns its buffer, of the
+**             queue's msglen bytes, for the caller to write the message into
+**             in place.  Waits up to wait ticks for space.  The message is
+**             only sent by msgQCommit, which must follow promptly: receivers
+**             can't get past a loaned cell.  Returns NULL, with errno set,
+**             on error or timeout.
+*****************************************************************************/
+char *
+    msgQLoan( MSG_Q_ID queue_id, int wait, int pri )
+{
+    msgq_t *queue;
+    msgq_ring_t *ring;
+    msgq_cell_t *cell;
+    struct timespec deadline;
+    struct timespec *until;
+    msgq_wait_t pending;
+    int state;
+
+    queue = queue_enter( queue_id );
+    if ( queue == (msgq_t *)NULL )
+        return( (char *)NULL );
+    ring = &queue->ring[pri == MSG_PRI_URGENT ? MSGQ_URGENT : MSGQ_NORMAL];
+
+    /*
+    **  Fast path, no waiting and no system calls
+    */
+    cell = claim_cell( queue, ring );
+    if ( (cell == (msgq_cell_t *)NULL) && (wait != NO_WAIT) )
+    {
+        until = v2lin_deadline( wait, &deadline );
+        pending.queue = queue;
+        pending.pend = &ring->send_pend;
+        pthread_cleanup_push( wait_cancelled, &pending );
+        for (;;)
+        {
+            pend_on( &pending );
+            cell = claim_cell( queue, ring );
+            if ( (cell != (msgq_cell_t *)NULL) ||
+                 __atomic_load_n( &queue->deleted, __ATOMIC_SEQ_CST ) )
+            {
+                pend_off( &pending, TRUE );
+                break;
+            }
+
+            /*
+            **  Timed out, unless woken on the way off the queue
+            */
+            state = v2lin_pend_wait( &pending.pender, until );
+            if ( state == V2LIN_PEND_WAITING )
+                state = pend_off( &pending, FALSE );
+            if ( state != V2LIN_PEND_READY )
+                break;
+            cell = claim_cell( queue, ring );
+            if ( cell != (msgq_cell_t *)NULL )
+                break;
+        }
+        pthread_cleanup_pop( 0 );
+    }
+
+    if ( cell == (msgq_cell_t *)NULL )
+    {
+        if ( __atomic_load_n( &queue->deleted, __ATOMIC_SEQ_CST ) )
+            errno = S_objLib_OBJ_DELETED;
+        else if ( wait == NO_WAIT )
+            errno = S_objLib_OBJ_UNAVAILABLE;
+        else
+            errno = S_objLib_OBJ_TIMEOUT;
+        queue_leave( queue );
+        return( (char *)NULL );
+    }
+
+    /*
+    **  The loan keeps its use of the queue until it is committed
+    */
+    return( cell->data );
+}
+
+/*****************************************************************************
+**  msgQCommit - sends a message written into a buffer from msgQLoan
+*****************************************************************************/
+STATUS
+    msgQCommit( MSG_Q_ID queue_id, char *msg, uint msglen )
+{
+    msgq_t *queue = v2lin_handle_get( &queue_table, (int)(intptr_t)queue_id );
+    msgq_cell_t *cell;
+
+    /*
+    **  The loan's use of the queue keeps its ID open
+    */
+    if ( (queue == (msgq_t *)NULL) || (msg == (char *)NULL) )
+    {
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+    cell = (msgq_cell_t *)(msg - offsetof( msgq_cell_t, data ));
+
+    /*
+    **  Commit what fits, the cell has to be published either way or every
+    **  message behind it would be stuck
+    */
+    cell->len = msglen < queue->msglen ? msglen : queue->msglen;
+    __atomic_store_n( &cell->seq, cell->seq + 1, __ATOMIC_RELEASE );
+    wake_pend( &queue->recv_pend, 1 );
+    queue_leave( queue );
+
+    if ( msglen > queue->msglen )
+    {
+        errno = S_msgQLib_INVALID_MSG_LENGTH;
+        return( ERROR );
+    }
+    return( OK );
+}
+
+/*****************************************************************************
+**  msgQSend - sends a copy of a message, waiting up to wait ticks for space
+*****************************************************************************/
+STATUS
+    msgQSend( MSG_Q_ID queue_id, char *msg, uint msglen, int wait, int pri )
+{
+    msgq_t *queue = v2lin_handle_get( &queue_table, (int)(intptr_t)queue_id );
+    char *buffer;
+
+    if ( (queue != (msgq_t *)NULL) && (msglen > queue->msglen) )
+    {
+        errno = S_msgQLib_INVALID_MSG_LENGTH;
+        return( ERROR );
+    }
+
+    buffer = msgQLoan( queue_id, wait, pri );
+    if ( buffer == (char *)NULL )
+        return( ERROR );
+    memcpy( buffer, msg, msglen );
+    return( msgQCommit( queue_id, buffer, msglen ) );
+}
+
+/*****************************************************************************
+**  msgQReceiveBatch - receives up to maxmsgs messages in one call, waiting up
+**                     to max_wait ticks for the first.  Message i is copied
+**                     to msgbuf + i * buflen, truncated to buflen bytes, and
+**                     its length stored in msglens[i] (msglens may be NULL).
+**                     Returns the number of messages received, or ERROR.
+*****************************************************************************/
+int
+    msgQReceiveBatch( MSG_Q_ID queue_id, char *msgbuf, uint buflen,
+                      int maxmsgs, uint *msglens, int max_wait )
+{
+    msgq_t *queue;
+    struct timespec deadline;
+    struct timespec *until;
+    msgq_wait_t pending;
+    int state;
+    int taken;
+
+    if ( maxmsgs <= 0 )
+    {
+        errno = S_msgQLib_INVALID_MSG_LENGTH;
+        return( ERROR );
+    }
+    queue = queue_enter( queue_id );
+    if ( queue == (msgq_t *)NULL )
+        return( ERROR );
+
+    taken = take_msgs( queue, msgbuf, buflen, maxmsgs, msglens );
+    if ( (taken == 0) && (max_wait != NO_WAIT) )
+    {
+        until = v2lin_deadline( max_wait, &deadline );
+        pending.queue = queue;
+        pending.pend = &queue->recv_pend;
+        pthread_cleanup_push( wait_cancelled, &pending );
+        for (;;)
+        {
+            pend_on( &pending );
+            taken = take_msgs( queue, msgbuf, buflen, maxmsgs, msglens );
+            if ( (taken > 0) ||
+                 __atomic_load_n( &queue->deleted, __ATOMIC_SEQ_CST ) )
+            {
+                pend_off( &pending, TRUE );
+                break;
+            }
+
+            /*
+            **  Timed out, unless woken on the way off the queue.  A wake
+            **  whose message another receiver got first just means waiting
+            **  again.
+            */
+            state = v2lin_pend_wait( &pending.pender, until );
+            if ( state == V2LIN_PEND_WAITING )
+                state = pend_off( &pending, FALSE );
+            if ( state != V2LIN_PEND_READY )
+                break;
+            taken = take_msgs( queue, msgbuf, buflen, maxmsgs, msglens );
+            if ( taken > 0 )
+                break;
+        }
+        pthread_cleanup_pop( 0 );
+    }
+
+    if ( taken == 0 )
+    {
+        if ( __atomic_load_n( &queue->deleted, __ATOMIC_SEQ_CST ) )
+            errno = S_objLib_OBJ_DELETED;
+        else if ( max_wait == NO_WAIT )
+            errno = S_objLib_OBJ_UNAVAILABLE;
+        else
+            errno = S_objLib_OBJ_TIMEOUT;
+        taken = ERROR;
+    }
+    queue_leave( queue );
+    return( taken );
+}
+
+/*****************************************************************************
+**  msgQReceive - receives one message, waiting up to max_wait ticks.
+**                Returns the number of bytes copied, or ERROR.
+*****************************************************************************/
+int
+    msgQReceive( MSG_Q_ID queue_id, char *msgbuf, uint buflen, int max_wait )
+{
+    uint len;
+
+    if ( msgQReceiveBatch( queue_id, msgbuf, buflen, 1, &len, max_wait ) != 1 )
+        return( ERROR );
+    return( (int)len );
+}
+
+/*****************************************************************************
+**  msgQNumMsgs - number of messages sent but not yet received, a snapshot
+**                that may be out of date as soon as it is returned
+*****************************************************************************/
+int
+    msgQNumMsgs( MSG_Q_ID queue_id )
+{
+    msgq_t *queue;
+    int64_t count = 0;
+    int ring_num;
+
+    queue = queue_enter( queue_id );
+    if ( queue == (msgq_t *)NULL )
+        return( ERROR );
+    for ( ring_num = 0; ring_num < MSGQ_RINGS; ring_num++ )
+        count += (int64_t)(__atomic_load_n( &queue->ring[ring_num].enq,
+                                            __ATOMIC_ACQUIRE ) -
+                           __atomic_load_n( &queue->ring[ring_num].deq,
+                                            __ATOMIC_ACQUIRE ));
+    queue_leave( queue );
+    return( count < 0 ? 0 : (int)count );
+}
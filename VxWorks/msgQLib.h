@@ -46,6 +46,23 @@ extern int       msgQReceive( MSG_Q_ID queue, char *msgbuf, uint buflen,
                               int max_wait );
 extern int       msgQNumMsgs( MSG_Q_ID queue );
 
+/*
+**  Unlike VxWorks, MSG_PRI_URGENT messages go to a second ring of max_msgs
+**  cells of their own, received before any normal message.  A queue can
+**  hold up to max_msgs of each, 2 * max_msgs in all, and urgent messages
+**  come out in the order they were sent rather than last sent first.
+*/
+
+/*
+**  Zero-copy extensions, see msgQLib.c.  msgQLoan returns a buffer of the
+**  queue's msglen bytes to write a message into, msgQCommit sends it.
+**  msgQReceiveBatch receives up to maxmsgs messages, buflen bytes apart.
+*/
+extern char     *msgQLoan( MSG_Q_ID queue, int wait, int pri );
+extern STATUS    msgQCommit( MSG_Q_ID queue, char *msg, uint msglen );
+extern int       msgQReceiveBatch( MSG_Q_ID queue, char *msgbuf, uint buflen,
+                                   int maxmsgs, uint *msglens, int max_wait );
+
 #if __cplusplus
 }
 #endif
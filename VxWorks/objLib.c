@@ -0,0 +1,155 @@
+/*****************************************************************************
+ * objLib.c - object IDs of the v2lin VxWorks (R) compatibility layer.
+ *
+ *            Task, semaphore, message queue and watchdog IDs are handles
+ *            into a table per object type: a slot index in the low bits and
+ *            the slot's generation above them.  v2lin_handle_get, in
+ *            v2lin.h, resolves an ID with an array index and no lock, and
+ *            an ID whose object has been deleted stops resolving even when
+ *            its slot has been reused, because the generation has moved on.
+ *
+ *            A closed slot keeps the memory of its last object, which the
+ *            next object to open the slot reuses.  Control blocks are never
+ *            returned to the heap, so a call that looked an ID up just as
+ *            its object was deleted only ever touches a control block of
+ *            the same type, and finds the ID no longer resolves to it.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "vxWorks.h"
+#include "v2lin.h"
+
+/*****************************************************************************
+**  slot_at - a table entry by index, the page having been added
+*****************************************************************************/
+static v2lin_slot_t *
+    slot_at( v2lin_table_t *table, int index )
+{
+    return( &table->page[index >> V2LIN_PAGE_BITS][index & (V2LIN_PAGE_SLOTS - 1)] );
+}
+
+/*****************************************************************************
+**  v2lin_handle_open - reserves a slot and its next handle, which doesn't
+**                      resolve until v2lin_handle_publish.  Returns the
+**                      memory kept from the slot's last object, NULL if
+**                      there is none, or NULL with *handle set to ERROR if
+**                      the table is full.
+*****************************************************************************/
+void *
+    v2lin_handle_open( v2lin_table_t *table, int *handle )
+{
+    v2lin_slot_t *page;
+    v2lin_slot_t *slot;
+    int index;
+
+    pthread_mutex_lock( &table->lock );
+    if ( table->free_head != 0 )
+    {
+        index = table->free_head - 1;
+        slot = slot_at( table, index );
+        table->free_head = slot->next_free;
+    }
+    else
+    {
+        if ( table->used > V2LIN_INDEX_MASK )
+        {
+            pthread_mutex_unlock( &table->lock );
+            *handle = ERROR;
+            errno = S_memLib_NOT_ENOUGH_MEMORY;
+            return( NULL );
+        }
+        index = table->used;
+        if ( table->page[index >> V2LIN_PAGE_BITS] == (v2lin_slot_t *)NULL )
+        {
+            page = calloc( V2LIN_PAGE_SLOTS, sizeof( v2lin_slot_t ) );
+            if ( page == (v2lin_slot_t *)NULL )
+            {
+                pthread_mutex_unlock( &table->lock );
+                *handle = ERROR;
+                errno = S_memLib_NOT_ENOUGH_MEMORY;
+                return( NULL );
+            }
+            __atomic_store_n( &table->page[index >> V2LIN_PAGE_BITS], page,
+                              __ATOMIC_RELEASE );
+        }
+        slot = slot_at( table, index );
+        __atomic_store_n( &table->used, index + 1, __ATOMIC_RELEASE );
+    }
+
+    /*
+    **  Generation 0 is skipped so no handle is 0
+    */
+    slot->gen = (slot->gen >= V2LIN_GEN_MAX) ? 1 : slot->gen + 1;
+    *handle = (slot->gen << V2LIN_INDEX_BITS) | index;
+    pthread_mutex_unlock( &table->lock );
+    return( slot->object );
+}
+
+/*****************************************************************************
+**  v2lin_handle_publish - makes an opened handle resolve to its object
+*****************************************************************************/
+void
+    v2lin_handle_publish( v2lin_table_t *table, int handle, void *object )
+{
+    v2lin_slot_t *slot = slot_at( table, handle & V2LIN_INDEX_MASK );
+
+    __atomic_store_n( &slot->object, object, __ATOMIC_RELEASE );
+    __atomic_store_n( &slot->handle, handle, __ATOMIC_RELEASE );
+}
+
+/*****************************************************************************
+**  v2lin_handle_close - stops a handle resolving and frees its slot,
+**                       keeping retain, if not NULL, for the slot's next
+**                       object.  Also undoes a v2lin_handle_open that
+**                       wasn't published.
+*****************************************************************************/
+void
+    v2lin_handle_close( v2lin_table_t *table, int handle, void *retain )
+{
+    int index = handle & V2LIN_INDEX_MASK;
+    v2lin_slot_t *slot = slot_at( table, index );
+
+    pthread_mutex_lock( &table->lock );
+    __atomic_store_n( &slot->handle, 0, __ATOMIC_RELEASE );
+    __atomic_store_n( &slot->object, retain, __ATOMIC_RELEASE );
+    slot->next_free = table->free_head;
+    table->free_head = index + 1;
+    pthread_mutex_unlock( &table->lock );
+}
+
+/*****************************************************************************
+**  v2lin_handle_next - the first open handle at or after slot *index,
+**                      moving *index past it, 0 once there are no more.
+**                      Handles opened or closed meanwhile may or may not
+**                      be found.
+*****************************************************************************/
+int
+    v2lin_handle_next( v2lin_table_t *table, int *index )
+{
+    int used = __atomic_load_n( &table->used, __ATOMIC_ACQUIRE );
+    int handle;
+
+    while ( *index < used )
+    {
+        handle = __atomic_load_n( &slot_at( table, (*index)++ )->handle,
+                                  __ATOMIC_ACQUIRE );
+        if ( handle != 0 )
+            return( handle );
+    }
+    return( 0 );
+}
@@ -0,0 +1,138 @@
+/*****************************************************************************
+ * qLib.c - pend queues of the v2lin VxWorks (R) compatibility layer.
+ *
+ *          A task that has to wait for a semaphore or message queue puts
+ *          itself on the object's pend queue and sleeps on a futex word of
+ *          its own.  Whoever makes the object available wakes exactly the
+ *          task at the head of the queue, the highest priority one or the
+ *          one that has waited longest, and tells it why through that word.
+ *          Only semFlush and deleting the object wake every task.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+
+#include <pthread.h>
+
+#include "vxWorks.h"
+#include "v2lin.h"
+
+/*****************************************************************************
+**  v2lin_pendq_init - sets up an empty pend queue.  Only called once for
+**                     the memory of a queue, a reused one has no waiters
+**                     left and just needs by_priority setting.
+*****************************************************************************/
+void
+    v2lin_pendq_init( v2lin_pendq_t *queue, int by_priority )
+{
+    pthread_mutex_init( &queue->lock, NULL );
+    queue->head = (v2lin_pender_t *)NULL;
+    queue->count = 0;
+    queue->by_priority = by_priority;
+}
+
+/*****************************************************************************
+**  v2lin_pend_insert - puts the calling task on a pend queue, behind every
+**                      task of the same or higher priority when the queue
+**                      is in priority order.  Caller holds the queue's lock.
+*****************************************************************************/
+void
+    v2lin_pend_insert( v2lin_pendq_t *queue, v2lin_pender_t *pender )
+{
+    v2pthread_cb_t *tcb = my_tcb();
+    v2lin_pender_t **link = &queue->head;
+
+    /*
+    **  Threads that aren't tasks wait behind every task
+    */
+    pender->priority = (tcb == (v2pthread_cb_t *)NULL) ?
+                       MIN_V2PT_PRIORITY + 1 : tcb->vxw_priority;
+    pender->state = V2LIN_PEND_WAITING;
+    while ( (*link != (v2lin_pender_t *)NULL) &&
+            (!queue->by_priority || ((*link)->priority <= pender->priority)) )
+        link = &(*link)->next;
+    pender->next = *link;
+    *link = pender;
+
+    /*
+    **  Ordered with the caller's next look at the object, against whoever
+    **  makes it available and then looks at count
+    */
+    __atomic_add_fetch( &queue->count, 1, __ATOMIC_SEQ_CST );
+}
+
+/*****************************************************************************
+**  v2lin_pend_remove - takes a task that gave up waiting off a pend queue.
+**                      Returns the state it was woken with instead if it
+**                      was woken first.  Caller holds the queue's lock.
+*****************************************************************************/
+int
+    v2lin_pend_remove( v2lin_pendq_t *queue, v2lin_pender_t *pender )
+{
+    v2lin_pender_t **link = &queue->head;
+
+    if ( pender->state != V2LIN_PEND_WAITING )
+        return( pender->state );
+    while ( *link != pender )
+        link = &(*link)->next;
+    *link = pender->next;
+    __atomic_sub_fetch( &queue->count, 1, __ATOMIC_SEQ_CST );
+    return( V2LIN_PEND_WAITING );
+}
+
+/*****************************************************************************
+**  v2lin_pend_wake - wakes up to count tasks from the head of a pend queue,
+**                    telling them state.  Returns how many were woken.
+**                    Caller holds the queue's lock.
+*****************************************************************************/
+int
+    v2lin_pend_wake( v2lin_pendq_t *queue, int count, int state )
+{
+    v2lin_pender_t *pender;
+    int woken = 0;
+
+    while ( (woken < count) && (queue->head != (v2lin_pender_t *)NULL) )
+    {
+        pender = queue->head;
+        queue->head = pender->next;
+        __atomic_sub_fetch( &queue->count, 1, __ATOMIC_SEQ_CST );
+
+        /*
+        **  The pender is on the woken task's stack, which may be gone as
+        **  soon as state is set.  Waking an address no longer waited on
+        **  is harmless.
+        */
+        __atomic_store_n( &pender->state, state, __ATOMIC_RELEASE );
+        v2lin_wake( &pender->state, 1 );
+        woken++;
+    }
+    return( woken );
+}
+
+/*****************************************************************************
+**  v2lin_pend_wait - sleeps until the task is woken off its pend queue or
+**                    the absolute CLOCK_MONOTONIC deadline passes (NULL for
+**                    never).  Returns the state it was woken with, or
+**                    V2LIN_PEND_WAITING on timeout, when the caller has to
+**                    take itself off the queue.
+*****************************************************************************/
+int
+    v2lin_pend_wait( v2lin_pender_t *pender, const struct timespec *until )
+{
+    int state;
+
+    while ( (state = __atomic_load_n( &pender->state, __ATOMIC_ACQUIRE )) ==
+            V2LIN_PEND_WAITING )
+        if ( v2lin_wait( &pender->state, V2LIN_PEND_WAITING, until ) == ERROR )
+            return( __atomic_load_n( &pender->state, __ATOMIC_ACQUIRE ) );
+    return( state );
+}
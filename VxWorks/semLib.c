@@ -0,0 +1,993 @@
+/*****************************************************************************
+ * semLib.c - semaphores of the v2lin VxWorks (R) compatibility layer.
+ *
+ *            Binary and counting semaphores keep their count in one word
+ *            taken and given with compare-and-swap, mutexes a word that is
+ *            0 when free and 1 when held.  Either way a take or give that
+ *            doesn't have to wait, or wake anyone, makes no system call.
+ *            Tasks that do have to wait go on the semaphore's pend queue,
+ *            see qLib.c, in priority order for SEM_Q_PRIORITY and in the
+ *            order they came for SEM_Q_FIFO, and a give hands the semaphore
+ *            straight to the task at its head.
+ *
+ *            SEM_INVERSION_SAFE mutexes are kernel priority inheritance
+ *            futexes instead, the word holding the owner's thread ID, and
+ *            semMCreateCeiling mutexes raise their owner to a priority
+ *            ceiling.  Every wait for a mutex held by a lower priority task
+ *            is timed, for semInversionGet.
+ *
+ *            semFlush releases every task waiting at the time it is called
+ *            without changing the count, the only give that wakes them all.
+ *
+ *            A SEM_ID is a handle into sem_table, see objLib.c.  A deleted
+ *            semaphore's control block is kept for the next one created.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "vxWorks.h"
+#include "semLib.h"
+#include "taskLib.h"
+#include "v2lin.h"
+
+#define SEM_BINARY      0
+#define SEM_COUNTING    1
+#define SEM_MUTEX       2
+
+/*
+**  Mutex futex word
+*/
+#define MUTEX_FREE      0
+#define MUTEX_HELD      1
+#define MUTEX_DELETED   2
+
+/*
+**  owner_priority of a free mutex, which no wait counts as an inversion,
+**  and the priority of threads that aren't tasks, below every task's
+*/
+#define NO_OWNER        (MAX_V2PT_PRIORITY - 1)
+#define NOT_A_TASK      (MIN_V2PT_PRIORITY + 1)
+
+#ifndef FUTEX_LOCK_PI2
+#define FUTEX_LOCK_PI2  13
+#endif
+
+/*****************************************************************************
+**  Control block for a v2pthread semaphore
+*****************************************************************************/
+typedef struct v2lin_sem
+{
+        /*
+        ** The semaphore's ID, 0 once it is being deleted
+        */
+    int
+        handle;
+
+        /*
+        ** Binary, counting or mutex, and the options it was created with
+        */
+    int
+        type;
+    int
+        options;
+
+        /*
+        ** Count of a binary or counting semaphore, state of a mutex or the
+        ** futex word of a priority inheritance mutex
+        */
+    int
+        count;
+
+        /*
+        ** Tasks waiting, except for priority inheritance mutexes, which
+        ** the kernel queues
+        */
+    v2lin_pendq_t
+        pend;
+
+        /*
+        ** Mutex owner and how many times it has taken the mutex
+        */
+    pthread_t
+        owner;
+    int
+        recursion;
+
+        /*
+        ** Priority of the task holding the mutex, and the waits of higher
+        ** priority tasks on lower priority owners: how many, for how long
+        ** in all and the longest
+        */
+    int
+        owner_priority;
+    unsigned int
+        inversions;
+    long long
+        inversion_ns;
+    long long
+        inversion_max_ns;
+
+        /*
+        ** Priority a ceiling mutex raises its owner to, MIN_V2PT_PRIORITY
+        ** for other mutexes, and the owner's ceiling before it took it
+        ** (NOT_A_TASK when there is nothing to put back)
+        */
+    int
+        ceiling;
+    int
+        prev_ceiling;
+
+        /*
+        ** Set by semDelete, users counts calls still inside the semaphore
+        ** so the control block isn't reused under them
+        */
+    int
+        deleted;
+    int
+        users;
+} v2lin_sem_t;
+
+/*
+**  Every semaphore, by SEM_ID
+*/
+static v2lin_table_t sem_table = V2LIN_TABLE_INITIALIZER;
+
+/*
+**  Futex operation for priority inheritance waits, FUTEX_LOCK_PI2 (with a
+**  CLOCK_MONOTONIC timeout) until the kernel turns out not to have it
+*/
+static int lock_pi_op = FUTEX_LOCK_PI2;
+
+/*****************************************************************************
+**  sem_enter - validates a semaphore and counts the caller as one of its
+**              users.  Returns NULL, with errno set, if it isn't usable.
+*****************************************************************************/
+static v2lin_sem_t *
+    sem_enter( SEM_ID semaphore )
+{
+    int id = (int)(intptr_t)semaphore;
+    v2lin_sem_t *sem = v2lin_handle_get( &sem_table, id );
+
+    if ( sem == (v2lin_sem_t *)NULL )
+    {
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( (v2lin_sem_t *)NULL );
+    }
+
+    /*
+    **  semDelete clears the handle before waiting for users to leave, so
+    **  once counted a semaphore still with its ID can't be reused
+    */
+    __atomic_add_fetch( &sem->users, 1, __ATOMIC_SEQ_CST );
+    if ( __atomic_load_n( &sem->handle, __ATOMIC_SEQ_CST ) != id )
+    {
+        __atomic_sub_fetch( &sem->users, 1, __ATOMIC_RELEASE );
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( (v2lin_sem_t *)NULL );
+    }
+    if ( __atomic_load_n( &sem->deleted, __ATOMIC_SEQ_CST ) )
+    {
+        __atomic_sub_fetch( &sem->users, 1, __ATOMIC_RELEASE );
+        errno = S_objLib_OBJ_DELETED;
+        return( (v2lin_sem_t *)NULL );
+    }
+    return( sem );
+}
+
+/*****************************************************************************
+**  sem_leave - drops a use taken by sem_enter
+*****************************************************************************/
+static void
+    sem_leave( v2lin_sem_t *sem )
+{
+    __atomic_sub_fetch( &sem->users, 1, __ATOMIC_RELEASE );
+}
+
+/*****************************************************************************
+**  A task in semTake waiting on a semaphore's pend queue
+*****************************************************************************/
+typedef struct sem_wait
+{
+    v2lin_sem_t *
+        sem;
+    v2lin_pender_t
+        pender;
+} sem_wait_t;
+
+/*****************************************************************************
+**  try_take - takes one from a binary or counting semaphore, or a free
+**             mutex, without waiting.  TRUE if there was one to take.
+*****************************************************************************/
+static int
+    try_take( v2lin_sem_t *sem )
+{
+    int count;
+
+    if ( sem->type == SEM_MUTEX )
+    {
+        count = MUTEX_FREE;
+        return( __atomic_compare_exchange_n( &sem->count, &count, MUTEX_HELD,
+                                             FALSE, __ATOMIC_SEQ_CST,
+                                             __ATOMIC_RELAXED ) );
+    }
+    count = __atomic_load_n( &sem->count, __ATOMIC_RELAXED );
+    while ( count > 0 )
+        if ( __atomic_compare_exchange_n( &sem->count, &count, count - 1, TRUE,
+                                          __ATOMIC_SEQ_CST,
+                                          __ATOMIC_RELAXED ) )
+            return( TRUE );
+    return( FALSE );
+}
+
+/*****************************************************************************
+**  grant - takes what is free of a semaphore for the tasks at the head of
+**          its pend queue and wakes them with it.  Caller holds the pend
+**          queue lock.
+*****************************************************************************/
+static void
+    grant( v2lin_sem_t *sem )
+{
+    while ( (sem->pend.head != (v2lin_pender_t *)NULL) && try_take( sem ) )
+        v2lin_pend_wake( &sem->pend, 1, V2LIN_PEND_READY );
+}
+
+/*****************************************************************************
+**  take_cancelled - takes a blocked task off the pend queue when taskDelete
+**                   ends it, handing on anything it had just been given
+*****************************************************************************/
+static void
+    take_cancelled( void *arg )
+{
+    sem_wait_t *wait = (sem_wait_t *)arg;
+    v2lin_sem_t *sem = wait->sem;
+    int state;
+
+    pthread_mutex_lock( &sem->pend.lock );
+    if ( v2lin_pend_remove( &sem->pend, &wait->pender ) == V2LIN_PEND_READY )
+    {
+        if ( sem->type == SEM_BINARY )
+            __atomic_store_n( &sem->count, 1, __ATOMIC_SEQ_CST );
+        else if ( sem->type == SEM_COUNTING )
+            __atomic_add_fetch( &sem->count, 1, __ATOMIC_SEQ_CST );
+        else
+        {
+            state = MUTEX_HELD;
+            __atomic_compare_exchange_n( &sem->count, &state, MUTEX_FREE,
+                                         FALSE, __ATOMIC_SEQ_CST,
+                                         __ATOMIC_RELAXED );
+        }
+        grant( sem );
+    }
+    pthread_mutex_unlock( &sem->pend.lock );
+    sem_leave( sem );
+}
+
+/*****************************************************************************
+**  pi_cancelled - drops a blocked task's use of a priority inheritance
+**                 mutex when taskDelete ends it.  The kernel queues its
+**                 waiters, so there's nothing else to undo.
+*****************************************************************************/
+static void
+    pi_cancelled( void *arg )
+{
+    sem_leave( (v2lin_sem_t *)arg );
+}
+
+/*****************************************************************************
+**  wait_sem - the waiting part of semTake of anything but a priority
+**             inheritance mutex.  A give hands the semaphore, or mutex, to
+**             the task at the head of the pend queue, which is the only
+**             one woken.
+*****************************************************************************/
+static STATUS
+    wait_sem( v2lin_sem_t *sem, int max_wait )
+{
+    v2pthread_cb_t *tcb;
+    struct timespec deadline;
+    struct timespec *until;
+    sem_wait_t wait;
+    int state = V2LIN_PEND_WAITING;
+
+    until = v2lin_deadline( max_wait, &deadline );
+    wait.sem = sem;
+
+    /*
+    **  Queued before the last look, a give either sees the queue or leaves
+    **  something to take
+    */
+    pthread_mutex_lock( &sem->pend.lock );
+    v2lin_pend_insert( &sem->pend, &wait.pender );
+    if ( try_take( sem ) )
+        state = V2LIN_PEND_READY;
+    else if ( __atomic_load_n( &sem->deleted, __ATOMIC_SEQ_CST ) )
+        state = V2LIN_PEND_DELETED;
+    if ( state != V2LIN_PEND_WAITING )
+        v2lin_pend_remove( &sem->pend, &wait.pender );
+    pthread_mutex_unlock( &sem->pend.lock );
+
+    if ( state == V2LIN_PEND_WAITING )
+    {
+        tcb = v2lin_pend( PEND );
+        pthread_cleanup_push( take_cancelled, &wait );
+        state = v2lin_pend_wait( &wait.pender, until );
+        pthread_cleanup_pop( 0 );
+        v2lin_ready( tcb, PEND );
+
+        /*
+        **  Timed out, unless woken on the way off the queue
+        */
+        if ( state == V2LIN_PEND_WAITING )
+        {
+            pthread_mutex_lock( &sem->pend.lock );
+            state = v2lin_pend_remove( &sem->pend, &wait.pender );
+            pthread_mutex_unlock( &sem->pend.lock );
+        }
+    }
+
+    if ( (state == V2LIN_PEND_READY) || (state == V2LIN_PEND_FLUSHED) )
+        return( OK );
+    errno = (state == V2LIN_PEND_DELETED) ? S_objLib_OBJ_DELETED :
+                                            S_objLib_OBJ_TIMEOUT;
+    return( ERROR );
+}
+
+/*****************************************************************************
+**  take_counted - semTake of a binary or counting semaphore
+*****************************************************************************/
+static STATUS
+    take_counted( v2lin_sem_t *sem, int max_wait )
+{
+    /*
+    **  Fast path, no waiting and no system calls
+    */
+    if ( try_take( sem ) )
+        return( OK );
+    if ( max_wait == NO_WAIT )
+    {
+        errno = S_objLib_OBJ_UNAVAILABLE;
+        return( ERROR );
+    }
+    return( wait_sem( sem, max_wait ) );
+}
+
+/*****************************************************************************
+**  now_ns - CLOCK_MONOTONIC in nanoseconds
+*****************************************************************************/
+static long long
+    now_ns( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return( (long long)now.tv_sec * V2LIN_NS_PER_SEC + now.tv_nsec );
+}
+
+/*****************************************************************************
+**  record_inversion - adds a wait on a lower priority owner to a mutex's
+**                     inversion figures
+*****************************************************************************/
+static void
+    record_inversion( v2lin_sem_t *sem, long long waited )
+{
+    long long max = __atomic_load_n( &sem->inversion_max_ns,
+                                     __ATOMIC_RELAXED );
+
+    __atomic_add_fetch( &sem->inversions, 1, __ATOMIC_RELAXED );
+    __atomic_add_fetch( &sem->inversion_ns, waited, __ATOMIC_RELAXED );
+    while ( (waited > max) &&
+            !__atomic_compare_exchange_n( &sem->inversion_max_ns, &max,
+                                          waited, TRUE, __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED ) )
+        ;
+}
+
+/*****************************************************************************
+**  self_tid - the calling thread's kernel ID, the owner value of a priority
+**             inheritance futex word
+*****************************************************************************/
+static __thread pid_t thread_tid = 0;
+
+static pid_t
+    self_tid( void )
+{
+    if ( thread_tid == 0 )
+        thread_tid = (pid_t)syscall( SYS_gettid );
+    return( thread_tid );
+}
+
+/*****************************************************************************
+**  lock_pi - waits in the kernel for a priority inheritance mutex, boosting
+**            its owner meanwhile, until an absolute CLOCK_MONOTONIC time.
+**            Returns 0 once the caller owns the mutex, an errno otherwise.
+*****************************************************************************/
+static int
+    lock_pi( v2lin_sem_t *sem, const struct timespec *until )
+{
+    struct timespec mono;
+    struct timespec real;
+    long long ns;
+    int op = __atomic_load_n( &lock_pi_op, __ATOMIC_RELAXED );
+
+    /*
+    **  FUTEX_LOCK_PI, all kernels before 5.14 have, times out against
+    **  CLOCK_REALTIME
+    */
+    if ( op == FUTEX_LOCK_PI )
+    {
+        clock_gettime( CLOCK_MONOTONIC, &mono );
+        clock_gettime( CLOCK_REALTIME, &real );
+        ns = (long long)(until->tv_sec - mono.tv_sec) * V2LIN_NS_PER_SEC +
+             (until->tv_nsec - mono.tv_nsec) + real.tv_nsec;
+        real.tv_sec += ns / V2LIN_NS_PER_SEC;
+        real.tv_nsec = ns % V2LIN_NS_PER_SEC;
+        if ( real.tv_nsec < 0 )
+        {
+            real.tv_sec--;
+            real.tv_nsec += V2LIN_NS_PER_SEC;
+        }
+        until = &real;
+    }
+    if ( syscall( SYS_futex, &sem->count, op | FUTEX_PRIVATE_FLAG, 0, until,
+                  NULL, 0 ) == 0 )
+        return( 0 );
+    if ( (errno == ENOSYS) && (op == FUTEX_LOCK_PI2) )
+    {
+        __atomic_store_n( &lock_pi_op, FUTEX_LOCK_PI, __ATOMIC_RELAXED );
+        return( lock_pi( sem, until ) );
+    }
+    return( errno );
+}
+
+/*****************************************************************************
+**  unlock_pi - releases a priority inheritance mutex the caller owns,
+**              handing it to the highest priority waiter if there is one
+*****************************************************************************/
+static void
+    unlock_pi( v2lin_sem_t *sem )
+{
+    int owner = self_tid();
+
+    if ( !__atomic_compare_exchange_n( &sem->count, &owner, 0, FALSE,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED ) )
+        syscall( SYS_futex, &sem->count, FUTEX_UNLOCK_PI_PRIVATE, 0, NULL,
+                 NULL, 0 );
+}
+
+/*****************************************************************************
+**  wait_pi - the waiting part of semTake of a priority inheritance mutex.
+**            A task waiting in the kernel for one isn't interrupted by
+**            signals, so it comes out every tick to look for semDelete and
+**            taskDelete.
+*****************************************************************************/
+static STATUS
+    wait_pi( v2lin_sem_t *sem, int max_wait )
+{
+    v2pthread_cb_t *tcb;
+    struct timespec deadline;
+    struct timespec *until;
+    struct timespec slice;
+    int last;
+    int error;
+    STATUS result = ERROR;
+
+    until = v2lin_deadline( max_wait, &deadline );
+    tcb = v2lin_pend( PEND );
+    pthread_cleanup_push( pi_cancelled, sem );
+    for (;;)
+    {
+        if ( __atomic_load_n( &sem->deleted, __ATOMIC_SEQ_CST ) )
+        {
+            errno = S_objLib_OBJ_DELETED;
+            break;
+        }
+
+        clock_gettime( CLOCK_MONOTONIC, &slice );
+        v2lin_add_ticks( &slice, 1 );
+        last = (until != (struct timespec *)NULL) &&
+               ((until->tv_sec < slice.tv_sec) ||
+                ((until->tv_sec == slice.tv_sec) &&
+                 (until->tv_nsec <= slice.tv_nsec)));
+        if ( last )
+            slice = *until;
+
+        error = lock_pi( sem, &slice );
+        if ( error == 0 )
+        {
+            result = OK;
+            break;
+        }
+
+        /*
+        **  The owner's thread is gone, a task deleted while holding the
+        **  mutex keeps it, so just wait out the slice
+        */
+        if ( error == ESRCH )
+            while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &slice,
+                                     NULL ) == EINTR )
+                pthread_testcancel();
+        else if ( error != ETIMEDOUT )
+        {
+            errno = S_semLib_INVALID_OPERATION;
+            break;
+        }
+        if ( last )
+        {
+            errno = S_objLib_OBJ_TIMEOUT;
+            break;
+        }
+        pthread_testcancel();
+    }
+    pthread_cleanup_pop( 0 );
+    v2lin_ready( tcb, PEND );
+
+    /*
+    **  Deleted while the kernel was handing the mutex over
+    */
+    if ( (result == OK) && __atomic_load_n( &sem->deleted, __ATOMIC_SEQ_CST ) )
+    {
+        unlock_pi( sem );
+        errno = S_objLib_OBJ_DELETED;
+        result = ERROR;
+    }
+    return( result );
+}
+
+/*****************************************************************************
+**  take_mutex - semTake of a mutex.  The owner may take it again, each take
+**               needing a give.  Waits on an owner of lower priority are
+**               timed as priority inversions.
+*****************************************************************************/
+static STATUS
+    take_mutex( v2lin_sem_t *sem, int max_wait )
+{
+    v2pthread_cb_t *tcb = my_tcb();
+    int priority = (tcb == (v2pthread_cb_t *)NULL) ? NOT_A_TASK :
+                                                     tcb->vxw_priority;
+    int ceiling = (tcb != (v2pthread_cb_t *)NULL) &&
+                  (sem->ceiling < MIN_V2PT_PRIORITY);
+    int inversion_safe = sem->options & SEM_INVERSION_SAFE;
+    int state = MUTEX_FREE;
+    long long started = 0;
+    STATUS result;
+
+    if ( (__atomic_load_n( &sem->count, __ATOMIC_RELAXED ) != MUTEX_FREE) &&
+         pthread_equal( sem->owner, pthread_self() ) )
+    {
+        sem->recursion++;
+        return( OK );
+    }
+
+    /*
+    **  The ceiling has to be at least the priority of every task taking
+    **  the mutex for the protocol to hold
+    */
+    if ( ceiling && (priority < sem->ceiling) )
+    {
+        errno = S_semLib_INVALID_OPERATION;
+        return( ERROR );
+    }
+
+    /*
+    **  Fast path, free to held with no system calls
+    */
+    if ( !__atomic_compare_exchange_n( &sem->count, &state,
+                                       inversion_safe ? self_tid() :
+                                                        MUTEX_HELD,
+                                       FALSE, __ATOMIC_ACQUIRE,
+                                       __ATOMIC_RELAXED ) )
+    {
+        if ( max_wait == NO_WAIT )
+        {
+            errno = (!inversion_safe && (state == MUTEX_DELETED)) ?
+                    S_objLib_OBJ_DELETED : S_objLib_OBJ_UNAVAILABLE;
+            return( ERROR );
+        }
+
+        if ( (tcb != (v2pthread_cb_t *)NULL) &&
+             (priority < __atomic_load_n( &sem->owner_priority,
+                                          __ATOMIC_RELAXED )) )
+            started = now_ns();
+        if ( inversion_safe )
+            result = wait_pi( sem, max_wait );
+        else
+            result = wait_sem( sem, max_wait );
+        if ( started != 0 )
+            record_inversion( sem, now_ns() - started );
+        if ( result == ERROR )
+            return( ERROR );
+    }
+
+    sem->owner = pthread_self();
+    __atomic_store_n( &sem->owner_priority, priority, __ATOMIC_RELAXED );
+    sem->recursion = 1;
+    if ( ceiling )
+        sem->prev_ceiling = v2lin_ceiling( (sem->ceiling < tcb->ceiling) ?
+                                           sem->ceiling : tcb->ceiling );
+    else
+        sem->prev_ceiling = NOT_A_TASK;
+    if ( sem->options & SEM_DELETE_SAFE )
+        taskSafe();
+    return( OK );
+}
+
+/*****************************************************************************
+**  give_mutex - releases a mutex, handing it to the first waiting task if
+**               there is one.  The kernel hands a priority inheritance
+**               mutex on, so forcing one that has waiters is left to its
+**               owner.
+*****************************************************************************/
+static STATUS
+    give_mutex( v2lin_sem_t *sem, int force )
+{
+    int inversion_safe = sem->options & SEM_INVERSION_SAFE;
+    int owned;
+    int ceiling;
+    int state;
+
+    state = __atomic_load_n( &sem->count, __ATOMIC_RELAXED );
+    owned = pthread_equal( sem->owner, pthread_self() );
+    if ( (state == MUTEX_FREE) ||
+         (!inversion_safe && (state == MUTEX_DELETED)) ||
+         (!force && !owned) ||
+         (inversion_safe && !owned && (state & FUTEX_WAITERS)) )
+    {
+        errno = S_semLib_INVALID_OPERATION;
+        return( ERROR );
+    }
+    if ( !force && (--sem->recursion > 0) )
+        return( OK );
+
+    /*
+    **  Nothing can be handed on until the owner's thread has gone or it
+    **  gives the mutex back itself
+    */
+    if ( inversion_safe && !owned &&
+         !__atomic_compare_exchange_n( &sem->count, &state, 0, FALSE,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED ) )
+    {
+        errno = S_semLib_INVALID_OPERATION;
+        return( ERROR );
+    }
+
+    sem->recursion = 0;
+    sem->owner = (pthread_t)0;
+    __atomic_store_n( &sem->owner_priority, NO_OWNER, __ATOMIC_RELAXED );
+    ceiling = owned ? sem->prev_ceiling : NOT_A_TASK;
+    if ( (sem->options & SEM_DELETE_SAFE) && !force )
+        taskUnsafe();
+
+    if ( inversion_safe )
+    {
+        if ( owned )
+            unlock_pi( sem );
+    }
+    else
+    {
+        /*
+        **  Never overwrite MUTEX_DELETED, semDelete may have got in first
+        */
+        if ( __atomic_compare_exchange_n( &sem->count, &state, MUTEX_FREE,
+                                          FALSE, __ATOMIC_SEQ_CST,
+                                          __ATOMIC_RELAXED ) &&
+             (__atomic_load_n( &sem->pend.count, __ATOMIC_SEQ_CST ) != 0) )
+        {
+            pthread_mutex_lock( &sem->pend.lock );
+            grant( sem );
+            pthread_mutex_unlock( &sem->pend.lock );
+        }
+    }
+
+    /*
+    **  Only drop from the ceiling once the mutex is free, tasks between
+    **  the two priorities could otherwise preempt the owner still holding it
+    */
+    if ( ceiling != NOT_A_TASK )
+        v2lin_ceiling( ceiling );
+    return( OK );
+}
+
+/*****************************************************************************
+**  new_sem - fills in a semaphore control block, reusing a deleted one's
+**            when there is one, and returns its ID
+*****************************************************************************/
+static SEM_ID
+    new_sem( int type, int options, int count, int ceiling )
+{
+    v2lin_sem_t *sem;
+    int id;
+
+    v2lin_init_once();
+    sem = v2lin_handle_open( &sem_table, &id );
+    if ( id == ERROR )
+        return( (SEM_ID)NULL );
+    if ( sem == (v2lin_sem_t *)NULL )
+    {
+        sem = calloc( 1, sizeof( v2lin_sem_t ) );
+        if ( sem == (v2lin_sem_t *)NULL )
+        {
+            v2lin_handle_close( &sem_table, id, NULL );
+            errno = S_memLib_NOT_ENOUGH_MEMORY;
+            return( (SEM_ID)NULL );
+        }
+        v2lin_pendq_init( &sem->pend, FALSE );
+    }
+
+    /*
+    **  A stale sem_enter may still be counting itself in and out of users
+    */
+    sem->type = type;
+    sem->options = options;
+    sem->count = count;
+    sem->pend.by_priority = (options & SEM_Q_PRIORITY) != 0;
+    sem->owner = (pthread_t)0;
+    sem->recursion = 0;
+    sem->owner_priority = NO_OWNER;
+    sem->inversions = 0;
+    sem->inversion_ns = 0;
+    sem->inversion_max_ns = 0;
+    sem->ceiling = ceiling;
+    sem->prev_ceiling = NOT_A_TASK;
+    sem->deleted = FALSE;
+    __atomic_store_n( &sem->handle, id, __ATOMIC_RELEASE );
+    v2lin_handle_publish( &sem_table, id, sem );
+    return( (SEM_ID)(intptr_t)id );
+}
+
+/*****************************************************************************
+**  semBCreate - creates a binary semaphore, SEM_EMPTY or SEM_FULL
+*****************************************************************************/
+SEM_ID
+    semBCreate( int opt, SEM_B_STATE initial_state )
+{
+    return( new_sem( SEM_BINARY, opt, (initial_state == SEM_EMPTY) ? 0 : 1,
+                     MIN_V2PT_PRIORITY ) );
+}
+
+/*****************************************************************************
+**  semCCreate - creates a counting semaphore
+*****************************************************************************/
+SEM_ID
+    semCCreate( int opt, int initial_count )
+{
+    return( new_sem( SEM_COUNTING, opt,
+                     (initial_count < 0) ? 0 : initial_count,
+                     MIN_V2PT_PRIORITY ) );
+}
+
+/*****************************************************************************
+**  semMCreate - creates a mutex.  SEM_DELETE_SAFE makes the owner safe from
+**               taskDelete while it holds the mutex.  SEM_INVERSION_SAFE,
+**               which needs SEM_Q_PRIORITY, makes it a kernel priority
+**               inheritance mutex: a task waiting for it raises the owner
+**               to its own priority until the owner gives it.
+*****************************************************************************/
+SEM_ID
+    semMCreate( int opt )
+{
+    if ( (opt & SEM_INVERSION_SAFE) && !(opt & SEM_Q_PRIORITY) )
+    {
+        errno = S_semLib_INVALID_OPTION;
+        return( (SEM_ID)NULL );
+    }
+    return( new_sem( SEM_MUTEX, opt, MUTEX_FREE, MIN_V2PT_PRIORITY ) );
+}
+
+/*****************************************************************************
+**  semMCreateCeiling - creates a priority ceiling mutex.  Its owner runs at
+**                      the ceiling, or its own priority if higher, until it
+**                      gives the mutex, so no task that takes the mutex can
+**                      preempt it meanwhile.  Tasks above the ceiling may
+**                      not take it.  Ceiling mutexes taken in turn should be
+**                      given in the reverse order.
+*****************************************************************************/
+SEM_ID
+    semMCreateCeiling( int opt, int ceiling )
+{
+    if ( (ceiling < MAX_V2PT_PRIORITY) || (ceiling > MIN_V2PT_PRIORITY) )
+    {
+        errno = S_taskLib_ILLEGAL_PRIORITY;
+        return( (SEM_ID)NULL );
+    }
+    if ( opt & SEM_INVERSION_SAFE )
+    {
+        errno = S_semLib_INVALID_OPTION;
+        return( (SEM_ID)NULL );
+    }
+    return( new_sem( SEM_MUTEX, opt, MUTEX_FREE, ceiling ) );
+}
+
+/*****************************************************************************
+**  semInversionGet - reads how many times tasks have waited for a mutex
+**                    held by a lower priority task, or a thread that isn't
+**                    a task, and how long for in all and at most.  The
+**                    figures are cleared after reading when reset is TRUE.
+*****************************************************************************/
+STATUS
+    semInversionGet( SEM_ID semaphore, SEM_INVERSION *inversion, BOOL reset )
+{
+    v2lin_sem_t *sem = sem_enter( semaphore );
+
+    if ( sem == (v2lin_sem_t *)NULL )
+        return( ERROR );
+    if ( (sem->type != SEM_MUTEX) || (inversion == (SEM_INVERSION *)NULL) )
+    {
+        sem_leave( sem );
+        errno = S_semLib_INVALID_OPERATION;
+        return( ERROR );
+    }
+
+    if ( reset )
+    {
+        inversion->count = __atomic_exchange_n( &sem->inversions, 0,
+                                                __ATOMIC_RELAXED );
+        inversion->total_ns = __atomic_exchange_n( &sem->inversion_ns, 0,
+                                                   __ATOMIC_RELAXED );
+        inversion->max_ns = __atomic_exchange_n( &sem->inversion_max_ns, 0,
+                                                 __ATOMIC_RELAXED );
+    }
+    else
+    {
+        inversion->count = __atomic_load_n( &sem->inversions,
+                                            __ATOMIC_RELAXED );
+        inversion->total_ns = __atomic_load_n( &sem->inversion_ns,
+                                               __ATOMIC_RELAXED );
+        inversion->max_ns = __atomic_load_n( &sem->inversion_max_ns,
+                                             __ATOMIC_RELAXED );
+    }
+    sem_leave( sem );
+    return( OK );
+}
+
+/*****************************************************************************
+**  semTake - takes a semaphore, waiting up to max_wait ticks
+*****************************************************************************/
+STATUS
+    semTake( SEM_ID semaphore, int max_wait )
+{
+    v2lin_sem_t *sem = sem_enter( semaphore );
+    STATUS result;
+
+    if ( sem == (v2lin_sem_t *)NULL )
+        return( ERROR );
+    if ( sem->type == SEM_MUTEX )
+        result = take_mutex( sem, max_wait );
+    else
+        result = take_counted( sem, max_wait );
+    sem_leave( sem );
+    return( result );
+}
+
+/*****************************************************************************
+**  semGive - gives a semaphore, handing it to the first waiting task if
+**            there is one.  Only the owner of a mutex may give it.
+*****************************************************************************/
+STATUS
+    semGive( SEM_ID semaphore )
+{
+    v2lin_sem_t *sem = sem_enter( semaphore );
+    STATUS result = OK;
+
+    if ( sem == (v2lin_sem_t *)NULL )
+        return( ERROR );
+
+    if ( sem->type == SEM_MUTEX )
+        result = give_mutex( sem, FALSE );
+    else
+    {
+        if ( sem->type == SEM_BINARY )
+            __atomic_store_n( &sem->count, 1, __ATOMIC_SEQ_CST );
+        else
+            __atomic_add_fetch( &sem->count, 1, __ATOMIC_SEQ_CST );
+        if ( __atomic_load_n( &sem->pend.count, __ATOMIC_SEQ_CST ) != 0 )
+        {
+            pthread_mutex_lock( &sem->pend.lock );
+            grant( sem );
+            pthread_mutex_unlock( &sem->pend.lock );
+        }
+    }
+    sem_leave( sem );
+    return( result );
+}
+
+/*****************************************************************************
+**  semMGiveForce - releases a mutex whoever holds it
+*****************************************************************************/
+STATUS
+    semMGiveForce( SEM_ID semaphore )
+{
+    v2lin_sem_t *sem = sem_enter( semaphore );
+    STATUS result;
+
+    if ( sem == (v2lin_sem_t *)NULL )
+        return( ERROR );
+    if ( sem->type != SEM_MUTEX )
+    {
+        errno = S_semLib_INVALID_OPERATION;
+        result = ERROR;
+    }
+    else
+        result = give_mutex( sem, TRUE );
+    sem_leave( sem );
+    return( result );
+}
+
+/*****************************************************************************
+**  semFlush - releases every task waiting on a binary or counting semaphore
+*****************************************************************************/
+STATUS
+    semFlush( SEM_ID semaphore )
+{
+    v2lin_sem_t *sem = sem_enter( semaphore );
+
+    if ( sem == (v2lin_sem_t *)NULL )
+        return( ERROR );
+    if ( sem->type == SEM_MUTEX )
+    {
+        sem_leave( sem );
+        errno = S_semLib_INVALID_OPERATION;
+        return( ERROR );
+    }
+
+    pthread_mutex_lock( &sem->pend.lock );
+    v2lin_pend_wake( &sem->pend, INT_MAX, V2LIN_PEND_FLUSHED );
+    pthread_mutex_unlock( &sem->pend.lock );
+    sem_leave( sem );
+    return( OK );
+}
+
+/*****************************************************************************
+**  semDelete - deletes a semaphore, waiting tasks return ERROR with errno
+**              S_objLib_OBJ_DELETED
+*****************************************************************************/
+STATUS
+    semDelete( SEM_ID semaphore )
+{
+    v2lin_sem_t *sem = sem_enter( semaphore );
+
+    if ( sem == (v2lin_sem_t *)NULL )
+    {
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+    if ( __atomic_exchange_n( &sem->deleted, TRUE, __ATOMIC_SEQ_CST ) )
+    {
+        sem_leave( sem );
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+
+    /*
+    **  The kernel owns a priority inheritance mutex's word, its waiters
+    **  notice deleted within a tick
+    */
+    if ( (sem->type == SEM_MUTEX) && !(sem->options & SEM_INVERSION_SAFE) )
+        __atomic_store_n( &sem->count, MUTEX_DELETED, __ATOMIC_SEQ_CST );
+    pthread_mutex_lock( &sem->pend.lock );
+    v2lin_pend_wake( &sem->pend, INT_MAX, V2LIN_PEND_DELETED );
+    pthread_mutex_unlock( &sem->pend.lock );
+
+    /*
+    **  Let the woken tasks get out before the control block is reused
+    */
+    __atomic_store_n( &sem->handle, 0, __ATOMIC_SEQ_CST );
+    sem_leave( sem );
+    v2lin_drain( &sem->users );
+    v2lin_handle_close( &sem_table, (int)(intptr_t)semaphore, sem );
+    return( OK );
+}
@@ -46,6 +46,25 @@ extern SEM_ID    semCCreate( int opt, int initial_count );
 extern SEM_ID    semMCreate( int opt );
 extern STATUS    semMGiveForce( SEM_ID semaphore );
 
+/*
+**  Mutex extensions, see semLib.c.  semMCreateCeiling makes a mutex that
+**  raises its owner to a priority ceiling, semInversionGet reads how long
+**  tasks have waited for a mutex held by a lower priority task.
+*/
+typedef struct sem_inversion
+{
+    unsigned int
+        count;
+    long long
+        total_ns;
+    long long
+        max_ns;
+} SEM_INVERSION;
+
+extern SEM_ID    semMCreateCeiling( int opt, int ceiling );
+extern STATUS    semInversionGet( SEM_ID semaphore, SEM_INVERSION *inversion,
+                                  BOOL reset );
+
 #if __cplusplus
 }
 #endif
@@ -0,0 +1,330 @@
+/*****************************************************************************
+ * sysLib.c - system clock of the v2lin VxWorks (R) compatibility layer.
+ *
+ *            The shim is tickless: taskDelay, wdStart and the semaphore and
+ *            message queue timeouts turn ticks into absolute deadlines at
+ *            the rate current when they are called, so changing the rate
+ *            with sysClkRateSet takes effect straight away without a clock
+ *            interrupt to reprogram.  tickGet is worked out from the
+ *            monotonic clock and stays monotonic across rate changes.
+ *
+ *            A clock task only runs while tick hooks are connected, calling
+ *            them every tick.  Its ticks are counted from a fixed start, so
+ *            a late wakeup doesn't push the rest back.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "vxWorks.h"
+#include "sysLib.h"
+#include "taskLib.h"
+#include "v2lin.h"
+
+/*****************************************************************************
+**  A routine called every tick
+*****************************************************************************/
+typedef struct sys_clk_hook
+{
+    FUNCPTR
+        routine;
+    int
+        arg;
+} sys_clk_hook_t;
+
+/*
+**  Tick rate, and the tick count and time it last changed at.  Written
+**  under clock_lock, read under the clock_seq sequence count, odd while a
+**  write is under way, so tickGet and sysClkRateGet never block.
+*/
+static int clk_rate = SYS_CLK_RATE_DEFAULT;
+static unsigned long base_ticks = 0;
+static long long base_ns = 0;
+static unsigned int clock_seq = 0;
+
+/*
+**  Tick hooks, slot 0 being the sysClkConnect routine, and the futex word
+**  the clock task sleeps on while there are none or the clock is disabled
+*/
+static sys_clk_hook_t hooks[SYS_CLK_HOOKS + 1];
+static int hook_count = 0;
+static int clk_enabled = TRUE;
+static int clk_running = FALSE;
+static int clock_task_id = 0;
+
+static pthread_mutex_t clock_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*****************************************************************************
+**  now_ns - CLOCK_MONOTONIC in nanoseconds
+*****************************************************************************/
+static long long
+    now_ns( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return( (long long)now.tv_sec * V2LIN_NS_PER_SEC + now.tv_nsec );
+}
+
+/*****************************************************************************
+**  ticks_at - ticks at a time, from a consistent base and rate
+*****************************************************************************/
+static unsigned long
+    ticks_at( long long ns, unsigned long ticks, long long since, int rate )
+{
+    return( ticks + (unsigned long)((ns - since) / (V2LIN_NS_PER_SEC / rate)) );
+}
+
+/*****************************************************************************
+**  clock_task - calls the tick hooks every tick while there are any
+*****************************************************************************/
+static int
+    clock_task( void )
+{
+    sys_clk_hook_t called[SYS_CLK_HOOKS + 1];
+    struct timespec next;
+    struct timespec now;
+    int count;
+    int i;
+
+    clock_gettime( CLOCK_MONOTONIC, &next );
+    for (;;)
+    {
+        if ( !__atomic_load_n( &clk_running, __ATOMIC_ACQUIRE ) )
+        {
+            v2lin_wait( &clk_running, FALSE, NULL );
+            clock_gettime( CLOCK_MONOTONIC, &next );
+            continue;
+        }
+
+        /*
+        **  The rate in force now sets the length of this tick
+        */
+        v2lin_add_ticks( &next, 1 );
+        while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+                                 NULL ) == EINTR )
+            ;
+
+        /*
+        **  More than a tick behind, start counting again from now
+        */
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        if ( ((long long)(now.tv_sec - next.tv_sec) * V2LIN_NS_PER_SEC +
+              (now.tv_nsec - next.tv_nsec)) > v2lin_tick_ns() )
+            next = now;
+
+        /*
+        **  Called unlocked so hooks can connect and remove hooks
+        */
+        count = 0;
+        pthread_mutex_lock( &clock_lock );
+        for ( i = 0; i <= SYS_CLK_HOOKS; i++ )
+            if ( hooks[i].routine != (FUNCPTR)NULL )
+                called[count++] = hooks[i];
+        pthread_mutex_unlock( &clock_lock );
+
+        for ( i = 0; i < count; i++ )
+            ((void (*)( int ))called[i].routine)( called[i].arg );
+    }
+    return( OK );
+}
+
+/*****************************************************************************
+**  update_running - starts or stops the clock task to match the hooks and
+**                   sysClkEnable.  Caller holds clock_lock.
+*****************************************************************************/
+static STATUS
+    update_running( void )
+{
+    int running = clk_enabled && (hook_count > 0);
+
+    if ( running && (clock_task_id == 0) )
+    {
+        clock_task_id = taskSpawn( "tSysClk", MAX_V2PT_PRIORITY, 0, 0,
+                                   (FUNCPTR)clock_task, 0, 0, 0, 0, 0, 0, 0,
+                                   0, 0, 0 );
+        if ( clock_task_id == ERROR )
+        {
+            clock_task_id = 0;
+            return( ERROR );
+        }
+    }
+    __atomic_store_n( &clk_running, running, __ATOMIC_RELEASE );
+    if ( running )
+        v2lin_wake( &clk_running, INT_MAX );
+    return( OK );
+}
+
+/*****************************************************************************
+**  sysClkRateGet - ticks per second
+*****************************************************************************/
+int
+    sysClkRateGet( void )
+{
+    return( __atomic_load_n( &clk_rate, __ATOMIC_RELAXED ) );
+}
+
+/*****************************************************************************
+**  sysClkRateSet - changes the ticks per second.  Delays and timeouts
+**                  already started keep the deadline they were given.
+**                  A rate outside SYS_CLK_RATE_MIN to SYS_CLK_RATE_MAX
+**                  fails with errno S_sysLib_INVALID_CLK_RATE.
+*****************************************************************************/
+STATUS
+    sysClkRateSet( int ticks_per_second )
+{
+    long long now;
+    unsigned long ticks;
+
+    if ( (ticks_per_second < SYS_CLK_RATE_MIN) ||
+         (ticks_per_second > SYS_CLK_RATE_MAX) )
+    {
+        errno = S_sysLib_INVALID_CLK_RATE;
+        return( ERROR );
+    }
+
+    pthread_mutex_lock( &clock_lock );
+    now = now_ns();
+    ticks = ticks_at( now, base_ticks, base_ns, clk_rate );
+
+    __atomic_add_fetch( &clock_seq, 1, __ATOMIC_ACQ_REL );
+    __atomic_store_n( &base_ticks, ticks, __ATOMIC_RELAXED );
+    __atomic_store_n( &base_ns, now, __ATOMIC_RELAXED );
+    __atomic_store_n( &clk_rate, ticks_per_second, __ATOMIC_RELAXED );
+    __atomic_add_fetch( &clock_seq, 1, __ATOMIC_RELEASE );
+    pthread_mutex_unlock( &clock_lock );
+    return( OK );
+}
+
+/*****************************************************************************
+**  tickGet - ticks since the monotonic clock started, counted at each rate
+**            for as long as it was in force
+*****************************************************************************/
+unsigned long
+    tickGet( void )
+{
+    unsigned long ticks;
+    long long since;
+    unsigned int seq;
+    int rate;
+
+    do
+    {
+        seq = __atomic_load_n( &clock_seq, __ATOMIC_ACQUIRE );
+        ticks = __atomic_load_n( &base_ticks, __ATOMIC_RELAXED );
+        since = __atomic_load_n( &base_ns, __ATOMIC_RELAXED );
+        rate = __atomic_load_n( &clk_rate, __ATOMIC_RELAXED );
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    } while ( (seq & 1) ||
+              (seq != __atomic_load_n( &clock_seq, __ATOMIC_RELAXED )) );
+
+    return( ticks_at( now_ns(), ticks, since, rate ) );
+}
+
+/*****************************************************************************
+**  sysClkConnect - sets the routine called every tick, NULL for none
+*****************************************************************************/
+STATUS
+    sysClkConnect( FUNCPTR routine, int arg )
+{
+    STATUS result;
+
+    pthread_mutex_lock( &clock_lock );
+    if ( hooks[0].routine != (FUNCPTR)NULL )
+        hook_count--;
+    hooks[0].routine = routine;
+    hooks[0].arg = arg;
+    if ( routine != (FUNCPTR)NULL )
+        hook_count++;
+    result = update_running();
+    pthread_mutex_unlock( &clock_lock );
+    return( result );
+}
+
+/*****************************************************************************
+**  sysClkHookAdd - adds a routine to be called every tick, ERROR if there
+**                  are already SYS_CLK_HOOKS
+*****************************************************************************/
+STATUS
+    sysClkHookAdd( FUNCPTR routine, int arg )
+{
+    STATUS result = ERROR;
+    int i;
+
+    if ( routine == (FUNCPTR)NULL )
+        return( ERROR );
+
+    pthread_mutex_lock( &clock_lock );
+    for ( i = 1; i <= SYS_CLK_HOOKS; i++ )
+        if ( hooks[i].routine == (FUNCPTR)NULL )
+        {
+            hooks[i].routine = routine;
+            hooks[i].arg = arg;
+            hook_count++;
+            result = update_running();
+            break;
+        }
+    pthread_mutex_unlock( &clock_lock );
+    return( result );
+}
+
+/*****************************************************************************
+**  sysClkHookDelete - removes a routine added by sysClkHookAdd.  It may
+**                     still be called once if the clock task is running it.
+*****************************************************************************/
+STATUS
+    sysClkHookDelete( FUNCPTR routine, int arg )
+{
+    STATUS result = ERROR;
+    int i;
+
+    pthread_mutex_lock( &clock_lock );
+    for ( i = 1; i <= SYS_CLK_HOOKS; i++ )
+        if ( (hooks[i].routine == routine) && (hooks[i].arg == arg) )
+        {
+            hooks[i].routine = (FUNCPTR)NULL;
+            hook_count--;
+            result = update_running();
+            break;
+        }
+    pthread_mutex_unlock( &clock_lock );
+    return( result );
+}
+
+/*****************************************************************************
+**  sysClkEnable, sysClkDisable - start and stop calling the tick hooks.
+**                                Delays and timeouts aren't affected.
+*****************************************************************************/
+void
+    sysClkEnable( void )
+{
+    pthread_mutex_lock( &clock_lock );
+    clk_enabled = TRUE;
+    if ( update_running() == ERROR )
+        perror( "sysClkEnable: clock task" );
+    pthread_mutex_unlock( &clock_lock );
+}
+
+void
+    sysClkDisable( void )
+{
+    pthread_mutex_lock( &clock_lock );
+    clk_enabled = FALSE;
+    update_running();
+    pthread_mutex_unlock( &clock_lock );
+}
@@ -0,0 +1,63 @@
+/* vxWorks sysLib functions */
+
+/*****************************************************************************
+ * sysLib.h - system clock of the v2lin VxWorks (R) compatibility layer.
+ *            The tick rate can be changed at run time, taskDelay, wdStart
+ *            and every other timeout in ticks use the rate at the time
+ *            they are called.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+#ifndef __VXW_SYSLIB_H
+#define __VXW_SYSLIB_H
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "vxWorks.h"
+
+/*
+**  Tick rates sysClkRateSet accepts, and the rate until it is called
+*/
+#define SYS_CLK_RATE_MIN        1
+#define SYS_CLK_RATE_MAX        10000
+#define SYS_CLK_RATE_DEFAULT    200
+
+/*
+**  Most routines that can be called every tick at once
+*/
+#define SYS_CLK_HOOKS           8
+
+/*
+**  sysLib Function Prototypes
+*/
+extern int       sysClkRateGet( void );
+extern STATUS    sysClkRateSet( int ticks_per_second );
+extern STATUS    sysClkConnect( FUNCPTR routine, int arg );
+extern void      sysClkEnable( void );
+extern void      sysClkDisable( void );
+extern unsigned long tickGet( void );
+
+/*
+**  Tick hook extension, see sysLib.c.  Any number of routines, up to
+**  SYS_CLK_HOOKS, can be called every tick alongside the sysClkConnect one.
+*/
+extern STATUS    sysClkHookAdd( FUNCPTR routine, int arg );
+extern STATUS    sysClkHookDelete( FUNCPTR routine, int arg );
+
+#if __cplusplus
+}
+#endif
+
+#endif // __VXW_SYSLIB_H
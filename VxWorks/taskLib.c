@@ -0,0 +1,963 @@
+/*****************************************************************************
+ * taskLib.c - tasks of the v2lin VxWorks (R) compatibility layer.
+ *
+ *             Each task is a detached pthread with a control block in
+ *             task_table.  VxWorks priorities map onto SCHED_FIFO (or
+ *             SCHED_RR) priorities when the process may use them, 0 being
+ *             the highest.  Other tasks are reached through signals:
+ *             taskSuspend holds the task in a signal handler, taskDelete
+ *             cancels its thread and interrupts whatever it is blocked in
+ *             until it has gone.
+ *
+ *             There is no process-wide lock on the way through a blocking
+ *             call.  A task finds its own control block through a thread
+ *             local pointer and other tasks' through the task table, see
+ *             objLib.c, without a lock.  Each control block has its own
+ *             lock for the hand over between an exiting task and one
+ *             deleting it.  Independent tasks never contend.
+ *
+ *             Control blocks belong to the task table and are reused by
+ *             later tasks, never freed.  taskInit only writes the new
+ *             task's ID into the memory it is given.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vxWorks.h"
+#include "taskLib.h"
+#include "v2lin.h"
+
+#define V2LIN_MIN_STACK (64 * 1024)
+
+/*
+**  Every task's control block, by task ID
+*/
+static v2lin_table_t task_table = V2LIN_TABLE_INITIALIZER;
+
+/*
+**  Control block of the calling task, NULL in threads the shim didn't start
+*/
+static __thread v2pthread_cb_t *self_tcb = (v2pthread_cb_t *)NULL;
+
+static int default_taskid = 0;
+
+/*****************************************************************************
+**  tcb_lookup - control block of a task ID, NULL if there is no such task
+**               or it has ended
+*****************************************************************************/
+static v2pthread_cb_t *
+    tcb_lookup( int taskid )
+{
+    v2pthread_cb_t *tcb = v2lin_handle_get( &task_table, taskid );
+
+    if ( (tcb != (v2pthread_cb_t *)NULL) &&
+         (__atomic_load_n( &tcb->state, __ATOMIC_RELAXED ) & DEAD) )
+        tcb = (v2pthread_cb_t *)NULL;
+    return( tcb );
+}
+
+/*****************************************************************************
+**  tcb_for - control block of a task ID, 0 for the calling task
+*****************************************************************************/
+v2pthread_cb_t *
+    tcb_for( int taskid )
+{
+    v2pthread_cb_t *tcb = (taskid == 0) ? self_tcb : tcb_lookup( taskid );
+
+    if ( tcb == (v2pthread_cb_t *)NULL )
+        errno = S_objLib_OBJ_ID_ERROR;
+    return( tcb );
+}
+
+/*****************************************************************************
+**  my_tcb - control block of the calling task, NULL for threads the shim
+**           didn't start
+*****************************************************************************/
+v2pthread_cb_t *
+    my_tcb( void )
+{
+    return( self_tcb );
+}
+
+/*****************************************************************************
+**  v2lin_pend - marks the calling task as blocked, see v2lin_ready
+*****************************************************************************/
+v2pthread_cb_t *
+    v2lin_pend( int state )
+{
+    v2pthread_cb_t *tcb = self_tcb;
+
+    if ( tcb != (v2pthread_cb_t *)NULL )
+        __atomic_or_fetch( &tcb->state, state, __ATOMIC_RELAXED );
+    return( tcb );
+}
+
+/*****************************************************************************
+**  v2lin_ready - clears a state set by v2lin_pend
+*****************************************************************************/
+void
+    v2lin_ready( v2pthread_cb_t *tcb, int state )
+{
+    if ( tcb != (v2pthread_cb_t *)NULL )
+        __atomic_and_fetch( &tcb->state, ~state, __ATOMIC_RELAXED );
+}
+
+/*****************************************************************************
+**  release_tcb - closes a task's ID, keeping its control block in the task
+**                table for the next task.  Caller holds the tcb_lock.
+*****************************************************************************/
+static void
+    release_tcb( v2pthread_cb_t *tcb )
+{
+    free( tcb->taskname );
+    tcb->taskname = (char *)NULL;
+    __atomic_or_fetch( &tcb->state, DEAD, __ATOMIC_RELAXED );
+    v2lin_handle_close( &task_table, tcb->taskid, tcb );
+}
+
+/*****************************************************************************
+**  task_exit - cleanup for a task's thread, however it ends.  A task being
+**              deleted or restarted leaves its control block for the task
+**              doing it, which waits on exited.
+*****************************************************************************/
+static void
+    task_exit( void *arg )
+{
+    v2pthread_cb_t *tcb = (v2pthread_cb_t *)arg;
+    int keep;
+
+    /*
+    **  A new task can't reuse the control block until the lock is free
+    */
+    pthread_mutex_lock( &tcb->tcb_lock );
+    keep = tcb->deleting || tcb->restarting;
+    if ( !keep )
+        release_tcb( tcb );
+    __atomic_store_n( &tcb->exited, TRUE, __ATOMIC_RELEASE );
+    v2lin_wake( &tcb->exited, INT_MAX );
+    pthread_mutex_unlock( &tcb->tcb_lock );
+}
+
+/*****************************************************************************
+**  task_wrapper - thread entry of every task
+*****************************************************************************/
+static void *
+    task_wrapper( void *arg )
+{
+    v2pthread_cb_t *tcb = (v2pthread_cb_t *)arg;
+
+    /*
+    **  Wait for start_thread to finish filling in pthrid
+    */
+    pthread_mutex_lock( &tcb->tcb_lock );
+    pthread_mutex_unlock( &tcb->tcb_lock );
+    self_tcb = tcb;
+
+    pthread_cleanup_push( task_exit, tcb );
+    pthread_setcanceltype( PTHREAD_CANCEL_DEFERRED, NULL );
+    tcb->entry_point( tcb->parms[0], tcb->parms[1], tcb->parms[2],
+                      tcb->parms[3], tcb->parms[4], tcb->parms[5],
+                      tcb->parms[6], tcb->parms[7], tcb->parms[8],
+                      tcb->parms[9] );
+    pthread_cleanup_pop( 1 );
+    return( NULL );
+}
+
+/*****************************************************************************
+**  apply_priority - sets a task's thread to the top priority inside
+**                   taskLock, otherwise to its own priority or the ceiling
+**                   of the mutexes it holds, whichever is higher
+*****************************************************************************/
+static void
+    apply_priority( v2pthread_cb_t *tcb )
+{
+    struct sched_param param;
+    int policy;
+
+    if ( (pthread_getschedparam( tcb->pthrid, &policy, &param ) != 0) ||
+         (policy == SCHED_OTHER) )
+        return;
+    if ( __atomic_load_n( &tcb->lock_count, __ATOMIC_RELAXED ) > 0 )
+        param.sched_priority = sched_get_priority_max( policy );
+    else
+        param.sched_priority = v2lin_posix_priority( policy,
+                                   (tcb->vxw_priority < tcb->ceiling) ?
+                                   tcb->vxw_priority : tcb->ceiling );
+    pthread_setschedparam( tcb->pthrid, policy, &param );
+}
+
+/*****************************************************************************
+**  v2lin_ceiling - sets the calling task's priority ceiling, returning the
+**                  one it replaces
+*****************************************************************************/
+int
+    v2lin_ceiling( int ceiling )
+{
+    v2pthread_cb_t *tcb = self_tcb;
+    int previous;
+
+    if ( tcb == (v2pthread_cb_t *)NULL )
+        return( MIN_V2PT_PRIORITY );
+    previous = tcb->ceiling;
+    tcb->ceiling = ceiling;
+    if ( ceiling != previous )
+        apply_priority( tcb );
+    return( previous );
+}
+
+/*****************************************************************************
+**  start_thread - creates the thread of an initialised task, falling back
+**                 to an ordinary thread if real-time scheduling is refused
+*****************************************************************************/
+static STATUS
+    start_thread( v2pthread_cb_t *tcb )
+{
+    pthread_attr_t attr;
+    struct sched_param param;
+    int policy = v2lin_policy();
+    int result;
+
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    pthread_attr_setstacksize( &attr, tcb->stksize > V2LIN_MIN_STACK ?
+                                      tcb->stksize : V2LIN_MIN_STACK );
+    if ( policy != SCHED_OTHER )
+    {
+        param.sched_priority = v2lin_posix_priority( policy,
+                                                     tcb->vxw_priority );
+        pthread_attr_setinheritsched( &attr, PTHREAD_EXPLICIT_SCHED );
+        pthread_attr_setschedpolicy( &attr, policy );
+        pthread_attr_setschedparam( &attr, &param );
+    }
+
+    /*
+    **  The thread can start and even finish before pthread_create returns,
+    **  so pthrid is set under the lock that task_wrapper and task_exit take
+    */
+    pthread_mutex_lock( &tcb->tcb_lock );
+    __atomic_and_fetch( &tcb->state, ~SUSPEND, __ATOMIC_RELAXED );
+    result = pthread_create( &tcb->pthrid, &attr, task_wrapper, tcb );
+    if ( result == EPERM )
+    {
+        pthread_attr_setinheritsched( &attr, PTHREAD_INHERIT_SCHED );
+        result = pthread_create( &tcb->pthrid, &attr, task_wrapper, tcb );
+    }
+    pthread_mutex_unlock( &tcb->tcb_lock );
+    pthread_attr_destroy( &attr );
+
+    if ( result != 0 )
+    {
+        errno = S_memLib_NOT_ENOUGH_MEMORY;
+        return( ERROR );
+    }
+    return( OK );
+}
+
+/*****************************************************************************
+**  new_tcb - takes a control block and ID from the task table and fills it
+**            in, the task stays suspended until start_thread
+*****************************************************************************/
+static v2pthread_cb_t *
+    new_tcb( int static_tcb, char *name, int pri, int opts, int stksize,
+             FUNCPTR entry, int *parms )
+{
+    v2pthread_cb_t *tcb;
+    int taskid;
+
+    if ( (pri < MAX_V2PT_PRIORITY) || (pri > MIN_V2PT_PRIORITY) )
+    {
+        errno = S_taskLib_ILLEGAL_PRIORITY;
+        return( (v2pthread_cb_t *)NULL );
+    }
+    if ( entry == (FUNCPTR)NULL )
+    {
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( (v2pthread_cb_t *)NULL );
+    }
+    v2lin_init_once();
+
+    tcb = v2lin_handle_open( &task_table, &taskid );
+    if ( taskid == ERROR )
+        return( (v2pthread_cb_t *)NULL );
+    if ( tcb == (v2pthread_cb_t *)NULL )
+    {
+        tcb = calloc( 1, sizeof( v2pthread_cb_t ) );
+        if ( tcb == (v2pthread_cb_t *)NULL )
+        {
+            v2lin_handle_close( &task_table, taskid, NULL );
+            errno = S_memLib_NOT_ENOUGH_MEMORY;
+            return( (v2pthread_cb_t *)NULL );
+        }
+        pthread_mutex_init( &tcb->tcb_lock, NULL );
+    }
+
+    /*
+    **  A reused control block may still be locked by a call that looked up
+    **  its last task's ID, the lock itself is left alone
+    */
+    pthread_mutex_lock( &tcb->tcb_lock );
+    tcb->taskid = taskid;
+    tcb->stksize = stksize;
+    tcb->entry_point = (int (*)( int, int, int, int, int, int, int, int, int,
+                                 int ))entry;
+    memcpy( tcb->parms, parms, sizeof( tcb->parms ) );
+    tcb->static_tcb = static_tcb;
+    tcb->flags = opts;
+    tcb->state = SUSPEND;
+    tcb->vxw_priority = pri;
+    tcb->delete_safe_count = 0;
+    tcb->suspended = FALSE;
+    tcb->exited = FALSE;
+    tcb->deleting = FALSE;
+    tcb->restarting = FALSE;
+    tcb->lock_count = 0;
+    tcb->ceiling = MIN_V2PT_PRIORITY;
+    if ( name == (char *)NULL )
+    {
+        tcb->taskname = malloc( 16 );
+        if ( tcb->taskname != (char *)NULL )
+            sprintf( tcb->taskname, "t%d", taskid );
+    }
+    else
+        tcb->taskname = strdup( name );
+    pthread_mutex_unlock( &tcb->tcb_lock );
+
+    v2lin_handle_publish( &task_table, taskid, tcb );
+    return( tcb );
+}
+
+/*****************************************************************************
+**  taskInit - initialises a task without starting it.  The control block
+**             comes from the task table, the memory given only receives
+**             the task's ID, as the taskid of a v2pthread_cb_t, for
+**             taskActivate.  pstack is not used, pthreads allocate their
+**             own stacks.
+*****************************************************************************/
+STATUS
+    taskInit( WIND_TCB *tcb, char *name, int pri, int opts, char *pstack,
+              int stksize, FUNCPTR entry, int arg1, int arg2, int arg3,
+              int arg4, int arg5, int arg6, int arg7, int arg8, int arg9,
+              int arg10 )
+{
+    int parms[10] = {arg1, arg2, arg3, arg4, arg5, arg6, arg7, arg8, arg9,
+                     arg10};
+    v2pthread_cb_t *task;
+
+    if ( tcb == (WIND_TCB *)NULL )
+    {
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+    task = new_tcb( TRUE, name, pri, opts, stksize, entry, parms );
+    if ( task == (v2pthread_cb_t *)NULL )
+        return( ERROR );
+    memset( tcb, 0, sizeof( v2pthread_cb_t ) );
+    ((v2pthread_cb_t *)tcb)->taskid = task->taskid;
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskActivate - starts a task made by taskInit
+*****************************************************************************/
+STATUS
+    taskActivate( int taskId )
+{
+    v2pthread_cb_t *tcb = tcb_for( taskId );
+
+    if ( tcb == (v2pthread_cb_t *)NULL )
+        return( ERROR );
+    return( start_thread( tcb ) );
+}
+
+/*****************************************************************************
+**  taskSpawn - creates and starts a task, returns its ID or ERROR
+*****************************************************************************/
+int
+    taskSpawn( char *name, int pri, int opts, int stksize, FUNCPTR entry,
+               int arg1, int arg2, int arg3, int arg4, int arg5, int arg6,
+               int arg7, int arg8, int arg9, int arg10 )
+{
+    int parms[10] = {arg1, arg2, arg3, arg4, arg5, arg6, arg7, arg8, arg9,
+                     arg10};
+    v2pthread_cb_t *tcb;
+
+    tcb = new_tcb( FALSE, name, pri, opts, stksize, entry, parms );
+    if ( tcb == (v2pthread_cb_t *)NULL )
+        return( ERROR );
+    if ( start_thread( tcb ) == ERROR )
+    {
+        pthread_mutex_lock( &tcb->tcb_lock );
+        release_tcb( tcb );
+        pthread_mutex_unlock( &tcb->tcb_lock );
+        return( ERROR );
+    }
+    return( tcb->taskid );
+}
+
+/*****************************************************************************
+**  stop_task - ends another task's thread and waits until it has gone.
+**              Unless forced, waits first for the task to leave any
+**              taskSafe sections.  The control block is left to the caller
+**              when restarting, released otherwise.
+*****************************************************************************/
+static STATUS
+    stop_task( int taskId, int force, int restart )
+{
+    v2pthread_cb_t *tcb;
+    struct timespec retry;
+    int count;
+    int started;
+
+    tcb = tcb_for( taskId );
+    if ( tcb == (v2pthread_cb_t *)NULL )
+        return( ERROR );
+
+    /*
+    **  task_exit looks at deleting and restarting under the same lock, and
+    **  the control block may have gone to a new task since the lookup
+    */
+    pthread_mutex_lock( &tcb->tcb_lock );
+    if ( (tcb->taskid != taskId) || tcb->exited ||
+         (tcb->state & DEAD) || tcb->deleting || tcb->restarting )
+    {
+        pthread_mutex_unlock( &tcb->tcb_lock );
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+    if ( restart )
+        tcb->restarting = TRUE;
+    else
+        tcb->deleting = TRUE;
+    started = (tcb->state & SUSPEND) == 0 || tcb->suspended;
+
+    /*
+    **  Never activated, there is no thread to stop
+    */
+    if ( !started )
+    {
+        if ( restart )
+            tcb->restarting = FALSE;
+        else
+            release_tcb( tcb );
+        pthread_mutex_unlock( &tcb->tcb_lock );
+        return( OK );
+    }
+    pthread_mutex_unlock( &tcb->tcb_lock );
+
+    while ( !force &&
+            (count = __atomic_load_n( &tcb->delete_safe_count,
+                                      __ATOMIC_ACQUIRE )) > 0 )
+        v2lin_wait( &tcb->delete_safe_count, count, NULL );
+
+    /*
+    **  A suspended task has to run to be cancelled.  The wake signal is
+    **  repeated as it may land just before the task blocks.
+    */
+    pthread_cancel( tcb->pthrid );
+    __atomic_store_n( &tcb->suspended, FALSE, __ATOMIC_RELEASE );
+    v2lin_wake( &tcb->suspended, INT_MAX );
+    while ( !__atomic_load_n( &tcb->exited, __ATOMIC_ACQUIRE ) )
+    {
+        /*
+        **  task_exit needs the lock to set exited, so the thread is still
+        **  there to signal
+        */
+        pthread_mutex_lock( &tcb->tcb_lock );
+        if ( !tcb->exited )
+            pthread_kill( tcb->pthrid, V2LIN_SIG_WAKE );
+        pthread_mutex_unlock( &tcb->tcb_lock );
+        clock_gettime( CLOCK_MONOTONIC, &retry );
+        v2lin_add_ticks( &retry, 1 );
+        v2lin_wait( &tcb->exited, FALSE, &retry );
+    }
+
+    if ( !restart )
+    {
+        pthread_mutex_lock( &tcb->tcb_lock );
+        release_tcb( tcb );
+        pthread_mutex_unlock( &tcb->tcb_lock );
+    }
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskDelete - deletes a task, 0 or its own ID for the calling task.
+**               Waits for the task to leave any taskSafe sections.
+*****************************************************************************/
+STATUS
+    taskDelete( int taskId )
+{
+    v2pthread_cb_t *self = my_tcb();
+
+    if ( (taskId == 0) ||
+         ((self != (v2pthread_cb_t *)NULL) && (taskId == self->taskid)) )
+    {
+        if ( self == (v2pthread_cb_t *)NULL )
+        {
+            errno = S_objLib_OBJ_ID_ERROR;
+            return( ERROR );
+        }
+        pthread_exit( NULL );
+    }
+    return( stop_task( taskId, FALSE, FALSE ) );
+}
+
+/*****************************************************************************
+**  taskDeleteForce - deletes a task even inside taskSafe sections
+*****************************************************************************/
+STATUS
+    taskDeleteForce( int taskId )
+{
+    if ( taskId == 0 )
+        return( taskDelete( 0 ) );
+    return( stop_task( taskId, TRUE, FALSE ) );
+}
+
+/*****************************************************************************
+**  restart_helper - restarts a task that asked to restart itself
+*****************************************************************************/
+static void *
+    restart_helper( void *arg )
+{
+    taskRestart( (int)(intptr_t)arg );
+    return( NULL );
+}
+
+/*****************************************************************************
+**  taskRestart - stops a task and starts it again from its entry point,
+**                keeping its ID, name, priority and arguments
+*****************************************************************************/
+STATUS
+    taskRestart( int taskId )
+{
+    v2pthread_cb_t *self = my_tcb();
+    v2pthread_cb_t *tcb;
+    pthread_t helper;
+    pthread_attr_t attr;
+
+    if ( (taskId == 0) ||
+         ((self != (v2pthread_cb_t *)NULL) && (taskId == self->taskid)) )
+    {
+        /*
+        **  A task can't wait for its own thread to end, another does it
+        */
+        if ( self == (v2pthread_cb_t *)NULL )
+        {
+            errno = S_objLib_OBJ_ID_ERROR;
+            return( ERROR );
+        }
+        pthread_attr_init( &attr );
+        pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+        pthread_create( &helper, &attr, restart_helper,
+                        (void *)(intptr_t)self->taskid );
+        pthread_attr_destroy( &attr );
+        for (;;)
+            pause();
+    }
+
+    if ( stop_task( taskId, TRUE, TRUE ) == ERROR )
+        return( ERROR );
+
+    tcb = tcb_for( taskId );
+    if ( tcb == (v2pthread_cb_t *)NULL )
+        return( ERROR );
+    tcb->state = READY;
+    tcb->suspended = FALSE;
+    tcb->exited = FALSE;
+    tcb->delete_safe_count = 0;
+    tcb->lock_count = 0;
+    tcb->ceiling = MIN_V2PT_PRIORITY;
+    tcb->restarting = FALSE;
+    return( start_thread( tcb ) );
+}
+
+/*****************************************************************************
+**  taskSuspend - stops a task, 0 for the calling task, until taskResume
+*****************************************************************************/
+STATUS
+    taskSuspend( int taskId )
+{
+    v2pthread_cb_t *tcb = tcb_for( taskId );
+    union sigval value;
+
+    if ( tcb == (v2pthread_cb_t *)NULL )
+        return( ERROR );
+
+    __atomic_or_fetch( &tcb->state, SUSPEND, __ATOMIC_RELAXED );
+    __atomic_store_n( &tcb->suspended, TRUE, __ATOMIC_RELEASE );
+    if ( tcb == self_tcb )
+    {
+        while ( __atomic_load_n( &tcb->suspended, __ATOMIC_ACQUIRE ) )
+            v2lin_wait( &tcb->suspended, TRUE, NULL );
+    }
+    else
+    {
+        value.sival_ptr = tcb;
+        pthread_sigqueue( tcb->pthrid, V2LIN_SIG_SUSPEND, value );
+    }
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskResume - lets a suspended task carry on
+*****************************************************************************/
+STATUS
+    taskResume( int taskId )
+{
+    v2pthread_cb_t *tcb = tcb_for( taskId );
+
+    if ( tcb == (v2pthread_cb_t *)NULL )
+        return( ERROR );
+
+    __atomic_and_fetch( &tcb->state, ~SUSPEND, __ATOMIC_RELAXED );
+    __atomic_store_n( &tcb->suspended, FALSE, __ATOMIC_RELEASE );
+    v2lin_wake( &tcb->suspended, INT_MAX );
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskPrioritySet - changes a task's priority, 0 for the calling task
+*****************************************************************************/
+STATUS
+    taskPrioritySet( int taskId, int priority )
+{
+    v2pthread_cb_t *tcb;
+
+    if ( (priority < MAX_V2PT_PRIORITY) || (priority > MIN_V2PT_PRIORITY) )
+    {
+        errno = S_taskLib_ILLEGAL_PRIORITY;
+        return( ERROR );
+    }
+    tcb = tcb_for( taskId );
+    if ( tcb == (v2pthread_cb_t *)NULL )
+        return( ERROR );
+
+    /*
+    **  A task inside taskLock takes its new priority at taskUnlock
+    */
+    tcb->vxw_priority = priority;
+    if ( __atomic_load_n( &tcb->lock_count, __ATOMIC_RELAXED ) == 0 )
+        apply_priority( tcb );
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskPriorityGet - reads a task's priority, 0 for the calling task
+*****************************************************************************/
+STATUS
+    taskPriorityGet( int taskId, int *priority )
+{
+    v2pthread_cb_t *tcb = tcb_for( taskId );
+
+    if ( tcb == (v2pthread_cb_t *)NULL )
+        return( ERROR );
+    *priority = tcb->vxw_priority;
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskLock - stops other tasks preempting the caller until taskUnlock, by
+**             raising it to the top priority of its policy.  Tasks on other
+**             CPUs carry on, as with taskLock on a multiprocessor VxWorks.
+**             Calls nest, and only real-time tasks are affected.
+*****************************************************************************/
+STATUS
+    taskLock( void )
+{
+    v2pthread_cb_t *tcb = self_tcb;
+
+    if ( (tcb != (v2pthread_cb_t *)NULL) && (tcb->lock_count++ == 0) )
+        apply_priority( tcb );
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskUnlock - ends the outermost taskLock, putting the caller back at its
+**               own priority, or its mutexes' ceiling
+*****************************************************************************/
+STATUS
+    taskUnlock( void )
+{
+    v2pthread_cb_t *tcb = self_tcb;
+
+    if ( (tcb == (v2pthread_cb_t *)NULL) || (tcb->lock_count == 0) )
+        return( OK );
+    if ( --tcb->lock_count == 0 )
+        apply_priority( tcb );
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskSafe - protects the calling task from taskDelete until taskUnsafe
+*****************************************************************************/
+STATUS
+    taskSafe( void )
+{
+    v2pthread_cb_t *tcb = self_tcb;
+
+    if ( tcb != (v2pthread_cb_t *)NULL )
+        __atomic_add_fetch( &tcb->delete_safe_count, 1, __ATOMIC_ACQ_REL );
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskUnsafe - ends a taskSafe section, waking any task waiting to delete
+**               this one once the last is left
+*****************************************************************************/
+STATUS
+    taskUnsafe( void )
+{
+    v2pthread_cb_t *tcb = self_tcb;
+
+    if ( (tcb != (v2pthread_cb_t *)NULL) &&
+         (__atomic_sub_fetch( &tcb->delete_safe_count, 1,
+                              __ATOMIC_ACQ_REL ) == 0) )
+        v2lin_wake( &tcb->delete_safe_count, INT_MAX );
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskDelay - sleeps for a number of ticks, 0 just gives way to other
+**              tasks of the same priority
+*****************************************************************************/
+STATUS
+    taskDelay( int ticks_to_wait )
+{
+    v2pthread_cb_t *tcb;
+    struct timespec until;
+
+    if ( ticks_to_wait <= 0 )
+    {
+        sched_yield();
+        return( OK );
+    }
+
+    tcb = v2lin_pend( DELAY );
+    v2lin_deadline( ticks_to_wait, &until );
+    while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &until,
+                             NULL ) == EINTR )
+        ;
+    v2lin_ready( tcb, DELAY );
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskPeriodInit - starts a period of ticks, the first release due a
+**                   period from now
+*****************************************************************************/
+STATUS
+    taskPeriodInit( TASK_PERIOD *period, int ticks )
+{
+    struct timespec now;
+
+    if ( (period == (TASK_PERIOD *)NULL) || (ticks <= 0) )
+    {
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    period->ticks = ticks;
+    period->next_ns = (long long)now.tv_sec * V2LIN_NS_PER_SEC + now.tv_nsec +
+                      (long long)ticks * v2lin_tick_ns();
+    period->releases = 0;
+    period->late = 0;
+    period->missed = 0;
+    return( OK );
+}
+
+/*****************************************************************************
+**  taskPeriodWait - sleeps until the next release of a period.  A task that
+**                   gets here after its release is due isn't held back: it
+**                   carries on at once and counts the release as late, and
+**                   any releases a whole period or more overdue are skipped
+**                   and counted as missed, keeping later releases in phase.
+**                   Returns the number of releases missed by this call.
+*****************************************************************************/
+int
+    taskPeriodWait( TASK_PERIOD *period )
+{
+    v2pthread_cb_t *tcb;
+    struct timespec until;
+    long long period_ns;
+    long long now;
+    int missed = 0;
+
+    if ( (period == (TASK_PERIOD *)NULL) || (period->ticks <= 0) )
+    {
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+    period_ns = (long long)period->ticks * v2lin_tick_ns();
+
+    clock_gettime( CLOCK_MONOTONIC, &until );
+    now = (long long)until.tv_sec * V2LIN_NS_PER_SEC + until.tv_nsec;
+    if ( now >= period->next_ns )
+    {
+        missed = (int)((now - period->next_ns) / period_ns);
+        period->next_ns += (long long)missed * period_ns;
+        period->late++;
+        period->missed += missed;
+    }
+    else
+    {
+        until.tv_sec = period->next_ns / V2LIN_NS_PER_SEC;
+        until.tv_nsec = period->next_ns % V2LIN_NS_PER_SEC;
+        tcb = v2lin_pend( DELAY );
+        while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &until,
+                                 NULL ) == EINTR )
+            ;
+        v2lin_ready( tcb, DELAY );
+    }
+    period->next_ns += period_ns;
+    period->releases++;
+    return( missed );
+}
+
+/*****************************************************************************
+**  taskName - name of a task, 0 for the calling task
+*****************************************************************************/
+char *
+    taskName( int taskId )
+{
+    v2pthread_cb_t *tcb = tcb_for( taskId );
+
+    if ( tcb == (v2pthread_cb_t *)NULL )
+        return( (char *)NULL );
+    return( tcb->taskname );
+}
+
+/*****************************************************************************
+**  taskNameToId - ID of the task with a name, ERROR if there is none
+*****************************************************************************/
+int
+    taskNameToId( char *task_name )
+{
+    v2pthread_cb_t *tcb;
+    int taskid = ERROR;
+    int handle;
+    int index = 0;
+
+    /*
+    **  Names are compared under the tcb_lock, which release_tcb frees them
+    **  under
+    */
+    while ( (taskid == ERROR) &&
+            ((handle = v2lin_handle_next( &task_table, &index )) != 0) )
+    {
+        tcb = tcb_lookup( handle );
+        if ( tcb == (v2pthread_cb_t *)NULL )
+            continue;
+        pthread_mutex_lock( &tcb->tcb_lock );
+        if ( (tcb->taskid == handle) && !(tcb->state & DEAD) &&
+             (tcb->taskname != (char *)NULL) &&
+             (strcmp( tcb->taskname, task_name ) == 0) )
+            taskid = handle;
+        pthread_mutex_unlock( &tcb->tcb_lock );
+    }
+    if ( taskid == ERROR )
+        errno = S_objLib_OBJ_ID_ERROR;
+    return( taskid );
+}
+
+/*****************************************************************************
+**  taskIdVerify - OK if a task exists
+*****************************************************************************/
+STATUS
+    taskIdVerify( int taskId )
+{
+    return( tcb_for( taskId ) == (v2pthread_cb_t *)NULL ? ERROR : OK );
+}
+
+/*****************************************************************************
+**  taskIdSelf - ID of the calling task, 0 for threads that aren't tasks
+*****************************************************************************/
+int
+    taskIdSelf( void )
+{
+    v2pthread_cb_t *tcb = self_tcb;
+
+    return( tcb == (v2pthread_cb_t *)NULL ? 0 : tcb->taskid );
+}
+
+/*****************************************************************************
+**  taskIdDefault - sets the default task ID when given one, returns it
+*****************************************************************************/
+int
+    taskIdDefault( int taskId )
+{
+    if ( taskId != 0 )
+        default_taskid = taskId;
+    return( default_taskid );
+}
+
+/*****************************************************************************
+**  taskIsReady - TRUE if a task is neither blocked, delayed nor suspended
+*****************************************************************************/
+BOOL
+    taskIsReady( int taskId )
+{
+    v2pthread_cb_t *tcb = tcb_for( taskId );
+
+    return( (tcb != (v2pthread_cb_t *)NULL) &&
+            ((__atomic_load_n( &tcb->state, __ATOMIC_RELAXED ) & RDY_MSK) ==
+             READY) );
+}
+
+/*****************************************************************************
+**  taskIsSuspended - TRUE if a task is suspended
+*****************************************************************************/
+BOOL
+    taskIsSuspended( int taskId )
+{
+    v2pthread_cb_t *tcb = tcb_for( taskId );
+
+    return( (tcb != (v2pthread_cb_t *)NULL) &&
+            (__atomic_load_n( &tcb->state, __ATOMIC_RELAXED ) & SUSPEND) );
+}
+
+/*****************************************************************************
+**  taskTcb - control block of a task
+*****************************************************************************/
+WIND_TCB *
+    taskTcb( int taskId )
+{
+    return( (WIND_TCB *)tcb_for( taskId ) );
+}
+
+/*****************************************************************************
+**  taskIdListGet - fills list with up to maxIds task IDs, returns how many
+*****************************************************************************/
+int
+    taskIdListGet( int list[], int maxIds )
+{
+    int count = 0;
+    int handle;
+    int index = 0;
+
+    while ( (count < maxIds) &&
+            ((handle = v2lin_handle_next( &task_table, &index )) != 0) )
+        if ( tcb_lookup( handle ) != (v2pthread_cb_t *)NULL )
+            list[count++] = handle;
+    return( count );
+}
@@ -33,6 +33,8 @@
 extern "C" {
 #endif
 
+#include <sched.h>
+
 #include "vxWorks.h"
 
 /*
@@ -72,6 +74,56 @@ extern BOOL      taskIsSuspended( int taskId );
 extern WIND_TCB  *taskTcb( int taskId );
 extern int       taskIdListGet( int list[], int maxIds );
 
+/*
+**  Periodic extension, see taskLib.c.  taskPeriodInit starts a period of
+**  ticks from now, each taskPeriodWait sleeps until the next release so
+**  the time spent between waits doesn't push later releases back.
+*/
+typedef struct task_period
+{
+    long long
+        next_ns;
+    int
+        ticks;
+    unsigned int
+        releases;
+    unsigned int
+        late;
+    unsigned int
+        missed;
+} TASK_PERIOD;
+
+extern STATUS    taskPeriodInit( TASK_PERIOD *period, int ticks );
+extern int       taskPeriodWait( TASK_PERIOD *period );
+
+/*
+**  Priority mapping extension.  The POSIX priority a task runs at under a
+**  real-time policy, 0 under SCHED_OTHER.  VxWorks priorities keep a level
+**  each down from the top of the policy's range for its top three
+**  quarters.  The rest of 0 - 255 is spread over the bottom quarter, so a
+**  lower VxWorks priority never runs above a higher one but some of the
+**  lowest share a level.  Anything moving a task's thread to another
+**  policy should use this so the task keeps its place among the others.
+*/
+static inline int
+    v2lin_posix_priority( int policy, int vxw_priority )
+{
+    int max;
+    int min;
+    int split;
+
+    if ( policy == SCHED_OTHER )
+        return( 0 );
+    max = sched_get_priority_max( policy );
+    min = sched_get_priority_min( policy );
+    split = ((max - min) * 3) / 4;
+    if ( vxw_priority <= split )
+        return( max - vxw_priority );
+    return( max - split - 1 -
+            ((vxw_priority - split - 1) * (max - split - 1 - min)) /
+            (MIN_V2PT_PRIORITY - split - 1) );
+}
+
 #if __cplusplus
 }
 #endif
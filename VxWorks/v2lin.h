@@ -0,0 +1,280 @@
+/*****************************************************************************
+ * v2lin.h - internals shared by the v2lin shim sources (kernelLib.c,
+ *           taskLib.c, semLib.c, wdLib.c and msgQLib.c).  Not part of the
+ *           VxWorks (R) API, applications should not include it.
+ *
+ *           Every blocking call in the shim sleeps on a futex: a 32 bit
+ *           word that the kernel only gets involved with when a task has
+ *           to wait, so uncontended takes, gives, sends and receives never
+ *           make a system call.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+#ifndef __V2LIN_H
+#define __V2LIN_H
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vxWorks.h"
+#include "sysLib.h"
+
+/*
+**  Signals sent to task threads.  V2LIN_SIG_WAKE interrupts whatever the
+**  task is blocked in so it notices it is being deleted, V2LIN_SIG_SUSPEND
+**  holds it in its handler until taskResume.
+*/
+#define V2LIN_SIG_WAKE      (SIGRTMIN + 4)
+#define V2LIN_SIG_SUSPEND   (SIGRTMIN + 5)
+
+#define V2LIN_NS_PER_SEC    1000000000L
+
+/*****************************************************************************
+**  v2lin_wait - sleeps while *word still holds seen, until the absolute
+**               CLOCK_MONOTONIC deadline (NULL for ever).  Being interrupted
+**               is a cancellation point, which is how taskDelete reaches a
+**               blocked task.  Returns ERROR only once the deadline passed.
+*****************************************************************************/
+static inline int
+    v2lin_wait( void *word, int seen, const struct timespec *deadline )
+{
+    if ( syscall( SYS_futex, word, FUTEX_WAIT_BITSET_PRIVATE, seen, deadline,
+                  NULL, FUTEX_BITSET_MATCH_ANY ) != 0 )
+    {
+        if ( errno == ETIMEDOUT )
+            return( ERROR );
+        if ( errno == EINTR )
+            pthread_testcancel();
+    }
+    return( OK );
+}
+
+/*****************************************************************************
+**  v2lin_wake - wakes up to count tasks sleeping on word
+*****************************************************************************/
+static inline void
+    v2lin_wake( void *word, int count )
+{
+    syscall( SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0 );
+}
+
+/*****************************************************************************
+**  v2lin_tick_ns - length of a system clock tick
+*****************************************************************************/
+static inline long
+    v2lin_tick_ns( void )
+{
+    return( V2LIN_NS_PER_SEC / sysClkRateGet() );
+}
+
+/*****************************************************************************
+**  v2lin_add_ticks - moves a CLOCK_MONOTONIC time on by a number of ticks
+*****************************************************************************/
+static inline void
+    v2lin_add_ticks( struct timespec *time, long ticks )
+{
+    long long ns = (long long)ticks * v2lin_tick_ns() + time->tv_nsec;
+
+    time->tv_sec += ns / V2LIN_NS_PER_SEC;
+    time->tv_nsec = ns % V2LIN_NS_PER_SEC;
+}
+
+/*****************************************************************************
+**  v2lin_deadline - converts a timeout in ticks to an absolute
+**                   CLOCK_MONOTONIC time, NULL for WAIT_FOREVER
+*****************************************************************************/
+static inline struct timespec *
+    v2lin_deadline( int ticks, struct timespec *deadline )
+{
+    if ( ticks == WAIT_FOREVER )
+        return( (struct timespec *)NULL );
+    clock_gettime( CLOCK_MONOTONIC, deadline );
+    v2lin_add_ticks( deadline, ticks );
+    return( deadline );
+}
+
+/*****************************************************************************
+**  v2lin_drain - waits for the calls still inside a deleted object to get
+**                out.  Sleeps rather than yields, they may be lower priority.
+*****************************************************************************/
+static inline void
+    v2lin_drain( int *users )
+{
+    struct timespec pause = { 0, 100000 };
+
+    while ( __atomic_load_n( users, __ATOMIC_ACQUIRE ) != 0 )
+        nanosleep( &pause, NULL );
+}
+
+/*
+**  Handle tables, see objLib.c.  An ID is a slot index in its low bits
+**  and the slot's generation above them, so an ID kept after its object
+**  was deleted no longer matches once the slot is reused.
+*/
+#define V2LIN_INDEX_BITS    16
+#define V2LIN_INDEX_MASK    ((1 << V2LIN_INDEX_BITS) - 1)
+#define V2LIN_PAGE_BITS     8
+#define V2LIN_PAGE_SLOTS    (1 << V2LIN_PAGE_BITS)
+#define V2LIN_PAGES         (1 << (V2LIN_INDEX_BITS - V2LIN_PAGE_BITS))
+#define V2LIN_GEN_MAX       0x7fff
+
+/*****************************************************************************
+**  A table entry.  object is kept when the handle is closed, so a slot's
+**  memory can be reused by the next object to take the slot.
+*****************************************************************************/
+typedef struct v2lin_slot
+{
+    int
+        handle;
+    int
+        gen;
+    void *
+        object;
+    int
+        next_free;
+} v2lin_slot_t;
+
+/*****************************************************************************
+**  A table of handles.  Pages are added as it grows and never removed, so
+**  lookups need no lock, only opening and closing handles take it.
+*****************************************************************************/
+typedef struct v2lin_table
+{
+    v2lin_slot_t *
+        page[V2LIN_PAGES];
+    int
+        used;
+    int
+        free_head;
+    pthread_mutex_t
+        lock;
+} v2lin_table_t;
+
+#define V2LIN_TABLE_INITIALIZER { { NULL }, 0, 0, PTHREAD_MUTEX_INITIALIZER }
+
+/*****************************************************************************
+**  v2lin_handle_get - object of an open handle, NULL for a handle that was
+**                     never opened or has been closed
+*****************************************************************************/
+static inline void *
+    v2lin_handle_get( v2lin_table_t *table, int handle )
+{
+    v2lin_slot_t *page;
+    v2lin_slot_t *slot;
+    void *object;
+
+    if ( handle <= 0 )
+        return( NULL );
+    page = __atomic_load_n( &table->page[(handle & V2LIN_INDEX_MASK) >>
+                                         V2LIN_PAGE_BITS], __ATOMIC_ACQUIRE );
+    if ( page == (v2lin_slot_t *)NULL )
+        return( NULL );
+    slot = &page[handle & (V2LIN_PAGE_SLOTS - 1)];
+    if ( __atomic_load_n( &slot->handle, __ATOMIC_ACQUIRE ) != handle )
+        return( NULL );
+    object = __atomic_load_n( &slot->object, __ATOMIC_ACQUIRE );
+
+    /*
+    **  Closed and reopened in between, the object may be someone else's
+    */
+    if ( __atomic_load_n( &slot->handle, __ATOMIC_ACQUIRE ) != handle )
+        return( NULL );
+    return( object );
+}
+
+/*
+**  Pend queues, see qLib.c.  What a waiting task is told when it is woken.
+*/
+#define V2LIN_PEND_WAITING  0
+#define V2LIN_PEND_READY    1
+#define V2LIN_PEND_FLUSHED  2
+#define V2LIN_PEND_DELETED  3
+
+/*****************************************************************************
+**  A task waiting on a pend queue, on its own stack.  state is the futex
+**  word it sleeps on.
+*****************************************************************************/
+typedef struct v2lin_pender
+{
+    struct v2lin_pender *
+        next;
+    int
+        priority;
+    int
+        state;
+} v2lin_pender_t;
+
+/*****************************************************************************
+**  Tasks waiting on an object, in priority order or, when by_priority is
+**  FALSE, the order they started waiting.  count can be read without the
+**  lock to see whether there is anyone to wake.
+*****************************************************************************/
+typedef struct v2lin_pendq
+{
+    pthread_mutex_t
+        lock;
+    v2lin_pender_t *
+        head;
+    int
+        count;
+    int
+        by_priority;
+} v2lin_pendq_t;
+
+/*
+**  qLib
+*/
+extern void             v2lin_pendq_init( v2lin_pendq_t *queue,
+                                          int by_priority );
+extern void             v2lin_pend_insert( v2lin_pendq_t *queue,
+                                           v2lin_pender_t *pender );
+extern int              v2lin_pend_remove( v2lin_pendq_t *queue,
+                                           v2lin_pender_t *pender );
+extern int              v2lin_pend_wake( v2lin_pendq_t *queue, int count,
+                                         int state );
+extern int              v2lin_pend_wait( v2lin_pender_t *pender,
+                                         const struct timespec *until );
+
+/*
+**  objLib
+*/
+extern void            *v2lin_handle_open( v2lin_table_t *table, int *handle );
+extern void             v2lin_handle_publish( v2lin_table_t *table, int handle,
+                                              void *object );
+extern void             v2lin_handle_close( v2lin_table_t *table, int handle,
+                                            void *retain );
+extern int              v2lin_handle_next( v2lin_table_t *table, int *index );
+
+/*
+**  kernelLib
+*/
+extern void             v2lin_init_once( void );
+extern int              v2lin_policy( void );
+
+/*
+**  taskLib
+*/
+extern v2pthread_cb_t  *my_tcb( void );
+extern v2pthread_cb_t  *tcb_for( int taskid );
+extern v2pthread_cb_t  *v2lin_pend( int state );
+extern void             v2lin_ready( v2pthread_cb_t *tcb, int state );
+extern int              v2lin_ceiling( int ceiling );
+
+#endif
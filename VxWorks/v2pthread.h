@@ -34,8 +34,6 @@ extern "C" {
 #define TRUE  !FALSE
 #endif
 
-#define V2PT_TICK 10 /* milliseconds per v2pthread scheduler tick */
-
 /*
 **  Task Scheduling Priorities in v2pthread are higher as numbers decrease...
 **  define the largest and smallest possible priority numbers.
@@ -84,16 +82,10 @@ typedef struct v2pt_pthread_ctl_blk
     pthread_t pthrid;
 
         /*
-        ** Thread attributes for task
+        ** Stack size requested for task
         */
-    pthread_attr_t
-        attr;
-
-        /*
-        ** Previous scheduler priority for task
-        */
-    struct sched_param
-        prv_priority;
+    int
+        stksize;
 
         /*
         ** Execution entry point address for task
@@ -107,8 +99,8 @@ typedef struct v2pt_pthread_ctl_blk
         parms[10];
 
         /*
-        ** Flag indicating if task control block allocated dynamically ( == 0 )
-        ** or statically ( == 1 )
+        ** Flag indicating if the task was spawned ( == 0 ) or made by
+        ** taskInit ( == 1 )
         */
     int
         static_tcb;
@@ -120,7 +112,7 @@ typedef struct v2pt_pthread_ctl_blk
         flags;
 
         /*
-        ** Task state
+        ** Task state, bits from the masks above
         */
     int
         state;
@@ -132,51 +124,49 @@ typedef struct v2pt_pthread_ctl_blk
         vxw_priority;
 
         /*
-        ** Pointer to suspended task list for object task is waiting on
+        ** Nesting level for number of taskSafe calls, futex word that
+        ** deleting tasks wait on for it to reach zero
         */
-    struct v2pt_pthread_ctl_blk **
-        suspend_list;
-
-        /*
-        ** Next task control block in list of tasks waiting on object
-        */
-    struct v2pt_pthread_ctl_blk *
-        nxt_susp;
+    int
+        delete_safe_count;
 
         /*
-        ** Nesting level for number of taskSafe calls
+        ** Futex word, non-zero while the task is held by taskSuspend
         */
     int
-        delete_safe_count;
+        suspended;
 
         /*
-        ** Mutex and Condition variable for task delete 'pend'
+        ** Futex word set once the task's thread has finished, and set when
+        ** another task is deleting or restarting it (so the exiting thread
+        ** leaves the control block for that task)
         */
-    pthread_mutex_t
-        tdelete_lock;
-    pthread_cond_t
-        t_deletable;
+    int
+        exited;
+    int
+        deleting;
+    int
+        restarting;
 
         /*
-        ** Mutex and Condition variable for task delete 'broadcast'
+        ** Nesting level of taskLock calls
         */
-    pthread_mutex_t
-        dbcst_lock;
-    pthread_cond_t
-        delete_bcplt;
+    int
+        lock_count;
 
         /*
-        ** First task control block in list of tasks waiting on this task
-        ** (for deletion purposes)
+        ** Priority ceiling of the mutexes the task holds, see semLib.c,
+        ** MIN_V2PT_PRIORITY when it holds none
         */
-    struct v2pt_pthread_ctl_blk *
-        first_susp;
+    int
+        ceiling;
 
         /*
-        ** Next task control block in list
+        ** Protects the hand over of the control block between the task's
+        ** exiting thread and a task deleting or restarting it
         */
-    struct v2pt_pthread_ctl_blk *
-        nxt_task;
+    pthread_mutex_t
+        tcb_lock;
 } v2pthread_cb_t;
 
 #if __cplusplus
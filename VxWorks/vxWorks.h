@@ -81,12 +81,6 @@ extern BOOL      roundRobinIsEnabled( void );
 extern STATUS    kernelTimeSlice( int ticks_per_quantum );
 
 
-
-/* Adjust the return value here to get the correct delays */
-int sysClkRateGet() {
-    return 200;
-}
-
 #if __cplusplus
 }
 #endif
@@ -44,6 +44,7 @@ extern "C" {
 #define OBJ_ERRS                        0x003d0000
 #define SEM_ERRS                        0x00160000
 #define SM_OBJ_ERRS                     0x00580000
+#define SYS_ERRS                        0x00590000
 
 #define S_memLib_NOT_ENOUGH_MEMORY      (MEM_ERRS + 1)
 
@@ -54,10 +55,13 @@ extern "C" {
 #define S_objLib_OBJ_TIMEOUT            (OBJ_ERRS + 4)
 #define S_objLib_OBJ_UNAVAILABLE        (OBJ_ERRS + 2)
 
+#define S_semLib_INVALID_OPTION         (SEM_ERRS + 0x00000066)
 #define S_semLib_INVALID_OPERATION      (SEM_ERRS + 0x00000068)
 
 #define S_smObjLib_NOT_INITIALIZED      (SM_OBJ_ERRS + 1)
 
+#define S_sysLib_INVALID_CLK_RATE       (SYS_ERRS + 1)
+
 #define S_taskLib_ILLEGAL_PRIORITY      (TASK_ERRS + 0x00000065)
 
 /*
@@ -0,0 +1,488 @@
+/*****************************************************************************
+ * wdLib.c - watchdog timers of the v2lin VxWorks (R) compatibility layer.
+ *
+ *           Watchdogs are tickless.  wdStart turns its delay into an
+ *           absolute CLOCK_MONOTONIC deadline, delay ticks from the moment
+ *           it is called rather than from the next tick boundary, and puts
+ *           the watchdog on a heap ordered by deadline.  One timer task
+ *           sleeps on a timerfd set to the earliest deadline, so nothing
+ *           runs between expiries and no armed watchdog is ever scanned.
+ *
+ *           Expired watchdogs are taken off the heap under the lock and
+ *           their functions called after it is released, so a watchdog
+ *           function may start, cancel or delete watchdogs, including its
+ *           own.
+ *
+ *           A WDOG_ID is a handle into wdog_table, see objLib.c.  A deleted
+ *           watchdog's control block is kept for the next one created.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/prctl.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vxWorks.h"
+#include "taskLib.h"
+#include "wdLib.h"
+#include "v2lin.h"
+
+/*
+**  Initial heap size, it doubles as needed
+*/
+#define WDOG_HEAP_SIZE  32
+
+/*****************************************************************************
+**  Control block for a v2pthread watchdog timer
+*****************************************************************************/
+typedef struct v2lin_wdog
+{
+        /*
+        ** The watchdog's ID
+        */
+    int
+        handle;
+
+        /*
+        ** Absolute CLOCK_MONOTONIC expiry time in nanoseconds, and the
+        ** watchdog's place on the heap, -1 while it is disarmed
+        */
+    int64_t
+        deadline;
+    int
+        heap_index;
+
+        /*
+        ** Function to call on expiry and its argument
+        */
+    FUNCPTR
+        timeout_func;
+    int
+        timeout_parm;
+
+        /*
+        ** Set while the timer task is calling the watchdog's function, and
+        ** set by wdDelete meanwhile so the timer task closes its ID after
+        */
+    int
+        firing;
+    int
+        deleted;
+
+        /*
+        ** Next watchdog in the list of those firing
+        */
+    struct v2lin_wdog *
+        nxt_fire;
+} v2lin_wdog_t;
+
+/*
+**  Armed watchdogs, a binary min-heap on deadline, and the timerfd always
+**  set to the deadline at its root.  All three are protected by wdog_lock.
+*/
+static v2lin_wdog_t **wdog_heap = (v2lin_wdog_t **)NULL;
+static int wdog_count = 0;
+static int wdog_size = 0;
+static int wdog_timer = -1;
+static pthread_mutex_t wdog_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+**  Every watchdog, by WDOG_ID
+*/
+static v2lin_table_t wdog_table = V2LIN_TABLE_INITIALIZER;
+
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+
+/*****************************************************************************
+**  now_ns - CLOCK_MONOTONIC in nanoseconds
+*****************************************************************************/
+static int64_t
+    now_ns( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return( (int64_t)now.tv_sec * V2LIN_NS_PER_SEC + now.tv_nsec );
+}
+
+/*****************************************************************************
+**  heap_set - puts a watchdog at a heap position
+*****************************************************************************/
+static void
+    heap_set( int index, v2lin_wdog_t *wdog )
+{
+    wdog_heap[index] = wdog;
+    wdog->heap_index = index;
+}
+
+/*****************************************************************************
+**  heap_up - moves the watchdog at index towards the root until its parent
+**            is due no later than it
+*****************************************************************************/
+static void
+    heap_up( int index )
+{
+    v2lin_wdog_t *wdog = wdog_heap[index];
+    int parent;
+
+    while ( index > 0 )
+    {
+        parent = (index - 1) / 2;
+        if ( wdog_heap[parent]->deadline <= wdog->deadline )
+            break;
+        heap_set( index, wdog_heap[parent] );
+        index = parent;
+    }
+    heap_set( index, wdog );
+}
+
+/*****************************************************************************
+**  heap_down - moves the watchdog at index away from the root until both
+**              its children are due no earlier than it
+*****************************************************************************/
+static void
+    heap_down( int index )
+{
+    v2lin_wdog_t *wdog = wdog_heap[index];
+    int child;
+
+    for (;;)
+    {
+        child = 2 * index + 1;
+        if ( child >= wdog_count )
+            break;
+        if ( (child + 1 < wdog_count) &&
+             (wdog_heap[child + 1]->deadline < wdog_heap[child]->deadline) )
+            child++;
+        if ( wdog->deadline <= wdog_heap[child]->deadline )
+            break;
+        heap_set( index, wdog_heap[child] );
+        index = child;
+    }
+    heap_set( index, wdog );
+}
+
+/*****************************************************************************
+**  heap_remove - takes an armed watchdog off the heap
+*****************************************************************************/
+static void
+    heap_remove( v2lin_wdog_t *wdog )
+{
+    int index = wdog->heap_index;
+    v2lin_wdog_t *last;
+
+    wdog->heap_index = -1;
+    last = wdog_heap[--wdog_count];
+    if ( last == wdog )
+        return;
+    heap_set( index, last );
+    heap_up( index );
+    heap_down( last->heap_index );
+}
+
+/*****************************************************************************
+**  heap_insert - puts a disarmed watchdog on the heap, ERROR if the heap
+**                can't grow
+*****************************************************************************/
+static STATUS
+    heap_insert( v2lin_wdog_t *wdog )
+{
+    v2lin_wdog_t **grown;
+    int size;
+
+    if ( wdog_count == wdog_size )
+    {
+        size = (wdog_size == 0) ? WDOG_HEAP_SIZE : 2 * wdog_size;
+        grown = realloc( wdog_heap, size * sizeof( v2lin_wdog_t * ) );
+        if ( grown == (v2lin_wdog_t **)NULL )
+            return( ERROR );
+        wdog_heap = grown;
+        wdog_size = size;
+    }
+    heap_set( wdog_count, wdog );
+    heap_up( wdog_count++ );
+    return( OK );
+}
+
+/*****************************************************************************
+**  arm_timer - sets the timerfd to the earliest deadline, or disarms it
+**              when no watchdog is armed.  Caller holds wdog_lock.
+*****************************************************************************/
+static void
+    arm_timer( void )
+{
+    struct itimerspec expiry = { { 0, 0 }, { 0, 0 } };
+    int64_t deadline;
+
+    if ( wdog_count > 0 )
+    {
+        /*
+        **  A zero it_value would disarm the timer, an overdue deadline
+        **  fires at once either way
+        */
+        deadline = wdog_heap[0]->deadline;
+        if ( deadline <= 0 )
+            deadline = 1;
+        expiry.it_value.tv_sec = deadline / V2LIN_NS_PER_SEC;
+        expiry.it_value.tv_nsec = deadline % V2LIN_NS_PER_SEC;
+    }
+    timerfd_settime( wdog_timer, TFD_TIMER_ABSTIME, &expiry, NULL );
+}
+
+/*****************************************************************************
+**  timer_task - waits for the earliest deadline and calls the functions of
+**               every watchdog due by then
+*****************************************************************************/
+static int
+    timer_task( void )
+{
+    v2lin_wdog_t *wdog;
+    v2lin_wdog_t *fire;
+    v2lin_wdog_t **last;
+    uint64_t expirations;
+    int64_t now;
+    FUNCPTR func;
+    int parm;
+
+    /*
+    **  Ordinary threads have their wakeups batched by up to 50 us
+    */
+    prctl( PR_SET_TIMERSLACK, 1UL, 0, 0, 0 );
+
+    for (;;)
+    {
+        if ( (read( wdog_timer, &expirations, sizeof( expirations ) ) < 0) &&
+             (errno == EINTR) )
+            pthread_testcancel();
+
+        fire = (v2lin_wdog_t *)NULL;
+        last = &fire;
+        now = now_ns();
+        pthread_mutex_lock( &wdog_lock );
+        while ( (wdog_count > 0) && (wdog_heap[0]->deadline <= now) )
+        {
+            wdog = wdog_heap[0];
+            heap_remove( wdog );
+            wdog->firing = TRUE;
+            wdog->nxt_fire = (v2lin_wdog_t *)NULL;
+            *last = wdog;
+            last = &wdog->nxt_fire;
+        }
+        arm_timer();
+        pthread_mutex_unlock( &wdog_lock );
+
+        while ( fire != (v2lin_wdog_t *)NULL )
+        {
+            wdog = fire;
+
+            /*
+            **  A wdStart, wdCancel or wdDelete since it expired wins
+            */
+            pthread_mutex_lock( &wdog_lock );
+            fire = wdog->nxt_fire;
+            func = (wdog->deleted || (wdog->heap_index >= 0)) ?
+                   (FUNCPTR)NULL : wdog->timeout_func;
+            parm = wdog->timeout_parm;
+            pthread_mutex_unlock( &wdog_lock );
+
+            if ( func != (FUNCPTR)NULL )
+                ((void (*)( int ))func)( parm );
+
+            pthread_mutex_lock( &wdog_lock );
+            wdog->firing = FALSE;
+            if ( wdog->deleted )
+                v2lin_handle_close( &wdog_table, wdog->handle, wdog );
+            pthread_mutex_unlock( &wdog_lock );
+        }
+    }
+    return( OK );
+}
+
+/*****************************************************************************
+**  start_timer - creates the timerfd and the task waiting on it
+*****************************************************************************/
+static void
+    start_timer( void )
+{
+    wdog_timer = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC );
+    if ( wdog_timer < 0 )
+    {
+        perror( "wdLib: timerfd" );
+        return;
+    }
+    if ( taskSpawn( "tWdTimer", MAX_V2PT_PRIORITY, 0, 0, (FUNCPTR)timer_task,
+                    0, 0, 0, 0, 0, 0, 0, 0, 0, 0 ) == ERROR )
+        perror( "wdLib: timer task" );
+}
+
+/*****************************************************************************
+**  valid_wdog - the watchdog with an ID, NULL if there is none.  Caller
+**               holds wdog_lock.
+*****************************************************************************/
+static v2lin_wdog_t *
+    valid_wdog( WDOG_ID wdId )
+{
+    v2lin_wdog_t *wdog = v2lin_handle_get( &wdog_table, (int)(intptr_t)wdId );
+
+    if ( (wdog == (v2lin_wdog_t *)NULL) || wdog->deleted )
+        return( (v2lin_wdog_t *)NULL );
+    return( wdog );
+}
+
+/*****************************************************************************
+**  disarm - takes a watchdog off the heap if it is on it, moving the timer
+**           if it was the earliest.  Caller holds wdog_lock.
+*****************************************************************************/
+static void
+    disarm( v2lin_wdog_t *wdog )
+{
+    if ( wdog->heap_index < 0 )
+        return;
+    if ( wdog->heap_index == 0 )
+    {
+        heap_remove( wdog );
+        arm_timer();
+    }
+    else
+        heap_remove( wdog );
+}
+
+/*****************************************************************************
+**  wdCreate - creates a disarmed watchdog timer
+*****************************************************************************/
+WDOG_ID
+    wdCreate( void )
+{
+    v2lin_wdog_t *wdog;
+    int id;
+
+    v2lin_init_once();
+    pthread_once( &timer_once, start_timer );
+    if ( wdog_timer < 0 )
+    {
+        errno = S_memLib_NOT_ENOUGH_MEMORY;
+        return( (WDOG_ID)NULL );
+    }
+
+    wdog = v2lin_handle_open( &wdog_table, &id );
+    if ( id == ERROR )
+        return( (WDOG_ID)NULL );
+    if ( wdog == (v2lin_wdog_t *)NULL )
+    {
+        wdog = calloc( 1, sizeof( v2lin_wdog_t ) );
+        if ( wdog == (v2lin_wdog_t *)NULL )
+        {
+            v2lin_handle_close( &wdog_table, id, NULL );
+            errno = S_memLib_NOT_ENOUGH_MEMORY;
+            return( (WDOG_ID)NULL );
+        }
+    }
+
+    pthread_mutex_lock( &wdog_lock );
+    wdog->handle = id;
+    wdog->heap_index = -1;
+    wdog->timeout_func = (FUNCPTR)NULL;
+    wdog->firing = FALSE;
+    wdog->deleted = FALSE;
+    pthread_mutex_unlock( &wdog_lock );
+    v2lin_handle_publish( &wdog_table, id, wdog );
+    return( (WDOG_ID)(intptr_t)id );
+}
+
+/*****************************************************************************
+**  wdStart - arms a watchdog to call funcptr( parm ) delay ticks from now,
+**            restarting it if it is already armed
+*****************************************************************************/
+STATUS
+    wdStart( WDOG_ID wdId, int delay, FUNCPTR funcptr, int parm )
+{
+    v2lin_wdog_t *wdog;
+    int64_t deadline;
+    STATUS result;
+
+    deadline = now_ns() + (int64_t)((delay > 0) ? delay : 0) *
+                          v2lin_tick_ns();
+
+    pthread_mutex_lock( &wdog_lock );
+    wdog = valid_wdog( wdId );
+    if ( (wdog == (v2lin_wdog_t *)NULL) || (funcptr == (FUNCPTR)NULL) )
+    {
+        pthread_mutex_unlock( &wdog_lock );
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+    disarm( wdog );
+    wdog->timeout_func = funcptr;
+    wdog->timeout_parm = parm;
+    wdog->deadline = deadline;
+    result = heap_insert( wdog );
+    if ( result == ERROR )
+        errno = S_memLib_NOT_ENOUGH_MEMORY;
+    else if ( wdog->heap_index == 0 )
+        arm_timer();
+    pthread_mutex_unlock( &wdog_lock );
+    return( result );
+}
+
+/*****************************************************************************
+**  wdCancel - disarms a watchdog
+*****************************************************************************/
+STATUS
+    wdCancel( WDOG_ID wdId )
+{
+    v2lin_wdog_t *wdog;
+
+    pthread_mutex_lock( &wdog_lock );
+    wdog = valid_wdog( wdId );
+    if ( wdog == (v2lin_wdog_t *)NULL )
+    {
+        pthread_mutex_unlock( &wdog_lock );
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+    disarm( wdog );
+    pthread_mutex_unlock( &wdog_lock );
+    return( OK );
+}
+
+/*****************************************************************************
+**  wdDelete - disarms and deletes a watchdog.  One that is firing keeps its
+**             control block until the timer task is done with it.
+*****************************************************************************/
+STATUS
+    wdDelete( WDOG_ID wdId )
+{
+    v2lin_wdog_t *wdog;
+
+    pthread_mutex_lock( &wdog_lock );
+    wdog = valid_wdog( wdId );
+    if ( wdog == (v2lin_wdog_t *)NULL )
+    {
+        pthread_mutex_unlock( &wdog_lock );
+        errno = S_objLib_OBJ_ID_ERROR;
+        return( ERROR );
+    }
+    disarm( wdog );
+    wdog->deleted = TRUE;
+    if ( !wdog->firing )
+        v2lin_handle_close( &wdog_table, wdog->handle, wdog );
+    pthread_mutex_unlock( &wdog_lock );
+    return( OK );
+}
@@ -0,0 +1,91 @@
+/*
+ * ****************************************************************************
+ * File           : blockring.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Single producer, single consumer ring of block records.
+ *                  Carries each block from the task that detected it to the
+ *                  next stage, without locks: the producer only writes the
+ *                  tail, the consumer only writes the head, each on its own
+ *                  cache line.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef BLOCKRING_H
+#define BLOCKRING_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+/* One block on its way along a lane */
+typedef struct
+{
+  uint32_t id;       /* order the block was detected in on its lane */
+  uint16_t lane;
+  uint8_t  size;     /* SIZE_SMALL or SIZE_BIG */
+  uint8_t  reserved;
+  uint64_t detected; /* system clock tick its size was known */
+} block_t;
+
+typedef struct
+{
+  unsigned head __attribute__((aligned(CACHE_LINE))); /* next to pop */
+  unsigned tail __attribute__((aligned(CACHE_LINE))); /* next to push */
+  block_t  slot[BLOCK_RING] __attribute__((aligned(CACHE_LINE)));
+} block_ring_t;
+
+/**
+ * @brief Adds a block, only called by the ring's producer
+ *
+ * @param ring  - ring to add to
+ * @param block - record to copy in
+ * @return int - 0 on success, -1 if the ring is full
+ */
+static inline int blockRingPush(block_ring_t *ring, const block_t *block)
+{
+  unsigned tail = ring->tail;
+
+  if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == BLOCK_RING)
+  {
+    return -1;
+  }
+  ring->slot[tail % BLOCK_RING] = *block;
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/**
+ * @brief Takes back the block just added, only called by the ring's
+ *        producer and only while the consumer can't reach that block, such
+ *        as before it has been told the block is there
+ *
+ * @param ring - ring to take the newest block from
+ */
+static inline void blockRingUnpush(block_ring_t *ring)
+{
+  __atomic_store_n(&ring->tail, ring->tail - 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Takes the oldest block, only called by the ring's consumer
+ *
+ * @param ring  - ring to take from
+ * @param block - filled with the record
+ * @return int - 0 on success, -1 if the ring is empty
+ */
+static inline int blockRingPop(block_ring_t *ring, block_t *block)
+{
+  unsigned head = ring->head;
+
+  if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))
+  {
+    return -1;
+  }
+  *block = ring->slot[head % BLOCK_RING];
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+#endif
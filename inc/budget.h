@@ -0,0 +1,90 @@
+/*
+ * ****************************************************************************
+ * File           : budget.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Execution budgets for task iterations. A task brackets
+ *                  each iteration of its loop with budgetStart and
+ *                  budgetStop, which measure the thread's CPU time so time
+ *                  spent blocked or preempted isn't charged to it. Iterations
+ *                  over budget are counted and can trigger a degrade action.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "config.h"
+
+typedef struct budget task_budget_t;
+
+/* Called by the overrunning task itself, after the overrun is recorded */
+typedef void (*budget_fn_t)(task_budget_t *budget);
+
+struct budget
+{
+  char        name[TASK_NAME_LENGTH];
+  uint64_t    budgetNs;  /* CPU time allowed per iteration */
+  budget_fn_t overrun;   /* degrade action, NULL for none */
+  uint64_t    startNs;   /* thread CPU time the iteration started at */
+
+  /* Written by the task only, read by anyone */
+  uint64_t    runs;
+  uint64_t    overruns;
+  uint64_t    worstNs;   /* longest iteration */
+  uint64_t    excessNs;  /* total time over budget */
+} __attribute__((aligned(CACHE_LINE)));
+
+void budgetInit(task_budget_t *budget, const char *name, double seconds, budget_fn_t overrun);
+void budgetOverrun(task_budget_t *budget, uint64_t used);
+void budgetPrint(FILE *out, const task_budget_t *budget, int count);
+
+/**
+ * @brief CPU time used by the calling thread
+ *
+ * @return uint64_t - nanoseconds
+ */
+static inline uint64_t budgetThreadNs(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * @brief Starts timing an iteration of the calling task
+ */
+static inline void budgetStart(task_budget_t *budget)
+{
+  budget->startNs = budgetThreadNs();
+}
+
+/**
+ * @brief Ends an iteration started with budgetStart, charging it to the
+ *        budget and running the degrade action if it overran
+ *
+ * @return uint64_t - CPU time the iteration used, nanoseconds
+ */
+static inline uint64_t budgetStop(task_budget_t *budget)
+{
+  uint64_t used = budgetThreadNs() - budget->startNs;
+
+  __atomic_store_n(&budget->runs, budget->runs + 1, __ATOMIC_RELAXED);
+  if (used > budget->worstNs)
+  {
+    __atomic_store_n(&budget->worstNs, used, __ATOMIC_RELAXED);
+  }
+  if (used > budget->budgetNs)
+  {
+    budgetOverrun(budget, used);
+  }
+  return used;
+}
+
+#endif
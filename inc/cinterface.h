@@ -14,7 +14,11 @@
 #ifndef _CINTERFACE_H_
 #define _CINTERFACE_H_
 
-/* Sensor reading functions */
+#include <stdint.h>
+
+#include "workload.h"
+
+/* Sensor reading functions, conveyor is the lane number (0 to MAX_LANES-1) */
 char readSizeSensors(char conveyor);
 char readCountSensor(char conveyor);
 
@@ -23,10 +27,64 @@ void resetCountSensor(char conveyor);
 
 /* Gate & motor control functions */
 void setGates(char state);
+void setGate(char conveyor, char state);
 void startMotor(void);
 void stopMotor(void);
 
+/* Size sensor edge events (simulated interface only) */
+#define CIF_WAIT_FOREVER -1
+
+typedef struct
+{
+  char     size;   /* size sensor reading after the edge */
+  uint64_t timeUs; /* CLOCK_MONOTONIC time of the edge, microseconds */
+} cEvent_t;
+
+int cWaitSensor(char conveyor, cEvent_t *event, int timeoutMs);
+
+/* Locking, lanes are independent, see cLaneLock */
+void cLaneLock(char conveyor);
+void cLaneUnlock(char conveyor);
+void cDeviceLock(void);
+void cDeviceUnlock(void);
+
+/* Waits for a lock held by another task */
+#define CIF_DEVICE_LOCK -1
+
+typedef struct
+{
+  unsigned count;   /* waits */
+  uint64_t totalNs; /* time spent waiting */
+  uint64_t maxNs;   /* longest wait */
+} cLockWait_t;
+
+void cLockWaitGet(char conveyor, cLockWait_t *wait);
+
 /* Library version */
 void cVersion(void);
 
+/* Random readings and batch reads (simulated interface only) */
+typedef struct
+{
+  char size;
+  char count;
+} cSample_t;
+
+void cSeed(uint64_t seed);
+int  cReadSamples(char conveyor, cSample_t *samples, int n);
+
+/* Trace replay and recording (simulated interface only) */
+#define CIF_NO_BLOCK UINT64_MAX
+
+int      cReplayStart(const char *path);
+void     cReplayStop(void);
+uint64_t cReplayNextBlock(char conveyor);
+int      cRecordStart(int lanes, uint64_t (*clock)(void));
+int      cRecordSave(const char *path);
+
+/* Generated blocks (simulated interface only) */
+void cPlaceBlock(char conveyor, char size);
+void cWorkloadStart(const workload_t *wl, uint64_t seed);
+void cWorkloadStop(void);
+
 #endif
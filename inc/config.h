@@ -19,8 +19,52 @@
 #define GATE_CLOSE 1.7
 #define COUNT_DELAY 4
 
-#define GATE_TIM_NUM 20
-#define COUNT_TIM_NUM 20
+/* SIMULATOR */
+#define SIM_ARRIVAL_GAP 1.0 /* seconds between blocks on each lane */
+#define SIM_RUN_TIME    5.0 /* virtual seconds simulated per UI cycle */
+#define TRACE_TICK_US   100 /* resolution of recorded sensor traces */
+#define DEFAULT_SEED    1   /* random sensor seed unless one is given */
+#define SWEEP_DURATION  3600.0 /* virtual seconds each swept plant runs */
+#define HEADLESS_STEP   1.0 /* virtual seconds between block limit checks */
+
+/* WORKLOAD GENERATOR */
+#define WL_SMALL_RATIO    0.5  /* fraction of generated blocks that are small */
+#define WL_BURST          8    /* mean blocks per burst */
+#define WL_BURST_GAP      0.2  /* seconds between blocks in a burst */
+#define BLOCK_SENSOR_TIME 0.1  /* seconds a block takes to pass a sensor */
+
+/* Count timers of blocks in flight, across all lanes */
+#define BLOCK_TIMERS 4096
+
+/* Close windows queued at each gate, merged windows count once */
+#define GATE_WINDOWS 64
+
+/* Block records queued between tasks on a lane, power of 2 */
+#define BLOCK_RING 64
+
+/* SCHEDULING, estimated worst case execution times in seconds for the
+   analysis in rma.c, the timer task runs every tick and the size task every
+   poll. The controller checks again with measured times at shutdown */
+#define TIMER_WCET    0.0002
+#define SIZE_WCET     0.0005
+#define COUNT_WCET    0.0005
+#define GATE_WCET     0.0003
+#define LOCK_WCET     0.00005 /* longest hold of a lane lock */
+#define BLOCK_MIN_GAP 0.5     /* shortest time between blocks on a lane */
+#define BASE_PRIORITY 0       /* taskSpawn priority of rma level 0 */
+#define BUDGET_DEGRADE_UI 10  /* overruns of one task before the UI is lowered */
+
+/* PLACEMENT, see placement.h */
+#define PLACE_MAX_CPUS 64 /* CPUs one role can be given */
+#define MAX_TASK_IDS   (16 + 3 * MAX_LANES) /* tasks listed when placing the rest */
+
+/* LANES */
+#define MAX_LANES        64
+#define DEFAULT_LANES    2
+#define LANE_NAME_LENGTH 16
+#define CACHE_LINE       64
+
+#define TASK_NAME_LENGTH 24
 
 #ifndef FALSE
   #define FALSE 0
@@ -40,6 +84,9 @@
 #define GATE_CLOSED_R     2
 #define GATE_CLOSED_BOTH  3
 
+/* State of a single lane's gate, used with setGate */
+#define GATE_CLOSED       1
+
 #define SIZE_NONE  0
 #define SIZE_SMALL 1
 #define SIZE_BIG   3
@@ -50,14 +97,6 @@
 
 extern const char sideString[2][6];
 
-typedef struct
-{
-  int big[2];
-  int small[2];
-  int collected[2];
-}counter_t;
-
-extern counter_t counter;
 
 
 
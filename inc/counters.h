@@ -0,0 +1,78 @@
+/*
+ * ****************************************************************************
+ * File           : counters.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Block counters for every lane. Each task that counts
+ *                  (a writer) has its own cache line of counters per lane,
+ *                  so counting never locks, waits or shares a line. Readers
+ *                  add the writers up and get a consistent snapshot of every
+ *                  lane at once; resets move a reader side baseline and
+ *                  never touch the writers' lines.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+/* Counters kept for each lane */
+enum CounterId
+{
+  CTR_SMALL,
+  CTR_BIG,
+  CTR_COLLECTED,
+  NUM_COUNTERS
+};
+
+/* Tasks that count, each writes only its own slot */
+enum CounterWriter
+{
+  CTR_SIZE_WRITER,  /* size task: small and big blocks */
+  CTR_COUNT_WRITER, /* count task: collected blocks */
+  NUM_CTR_WRITERS
+};
+
+/* Mask of every counter, for countersReadReset */
+#define CTR_ALL ((1u << NUM_COUNTERS) - 1)
+
+/* One writer's counters on one lane */
+typedef struct
+{
+  uint64_t value[NUM_COUNTERS];
+} __attribute__((aligned(CACHE_LINE))) counter_slot_t;
+
+/* Counters of one lane, raw totals less the baseline set by resets */
+typedef struct
+{
+  counter_slot_t slot[NUM_CTR_WRITERS];
+  uint64_t base[NUM_COUNTERS] __attribute__((aligned(CACHE_LINE)));
+} counters_t;
+
+/* One lane's counters as read */
+typedef struct
+{
+  uint64_t value[NUM_COUNTERS];
+} counter_snap_t;
+
+/**
+ * @brief Counts one event, only ever called by the slot's own writer
+ *
+ * @param counters - lane's counters
+ * @param writer   - CounterWriter of the calling task
+ * @param id       - counter to increment
+ * @return uint64_t - new raw value of the writer's count, for debug output
+ */
+static inline uint64_t counterInc(counters_t *counters, int writer, int id)
+{
+  return __atomic_add_fetch(&counters->slot[writer].value[id], 1, __ATOMIC_RELAXED);
+}
+
+void countersRead(counter_snap_t *snap);
+void countersReadReset(counter_snap_t *snap, int lane, unsigned mask);
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * ****************************************************************************
+ * File           : gatesched.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Per-gate deadline queue. Each small block asks for its
+ *                  gate to be closed over a window of ticks; windows that
+ *                  overlap are merged so the gate moves once for the lot.
+ *                  Each queue belongs to its gate's task alone, blocks
+ *                  reach that task through a blockring.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef GATESCHED_H
+#define GATESCHED_H
+
+#include <stdint.h>
+
+#include "config.h"
+#include "twheel.h"
+
+/* Close window, ticks on the twheel time base */
+typedef struct
+{
+  tw_tick_t close;
+  tw_tick_t open;
+} gate_window_t;
+
+typedef struct
+{
+  gate_window_t window[GATE_WINDOWS]; /* ring, oldest at head */
+  unsigned head;
+  unsigned tail;
+  uint64_t merged;  /* windows folded into the one before */
+  uint64_t dropped; /* windows lost to a full queue */
+} __attribute__((aligned(CACHE_LINE))) gate_sched_t;
+
+void gateSchedInit(gate_sched_t *gate);
+int  gateSchedAdd(gate_sched_t *gate, tw_tick_t close, tw_tick_t open);
+int  gateSchedPeek(gate_sched_t *gate, gate_window_t *window);
+tw_tick_t gateSchedRelease(gate_sched_t *gate, tw_tick_t now);
+
+#endif
@@ -0,0 +1,31 @@
+/*
+ * ****************************************************************************
+ * File           : lanes.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Per-lane state for a plant with any number of conveyor
+ *                  lanes. Each lane sits on its own cache line so tasks and
+ *                  workers driving different lanes never share one.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef LANES_H
+#define LANES_H
+
+#include "config.h"
+#include "counters.h"
+
+typedef struct
+{
+  counters_t counters;
+} __attribute__((aligned(CACHE_LINE))) lane_t;
+
+extern int numLanes;
+extern lane_t *lanes;
+
+int lanesInit(int count);
+void lanesFree(void);
+const char *laneName(int lane);
+
+#endif
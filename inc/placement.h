@@ -0,0 +1,52 @@
+/*
+ * ****************************************************************************
+ * File           : placement.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Task placement profiles. A profile gives each role of
+ *                  task the CPUs it may run on and its scheduling policy,
+ *                  and maps VxWorks priorities onto the policy's range. It
+ *                  is checked once at startup and applied to each thread
+ *                  as its task is spawned.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "config.h"
+
+typedef enum
+{
+  PLACE_TIMER,
+  PLACE_SIZE,
+  PLACE_COUNT,
+  PLACE_GATE,
+  PLACE_UI,    /* thread that started the controller */
+  PLACE_OTHER, /* every other task, libv2lin's own included */
+  NUM_PLACE_ROLES
+} place_role_t;
+
+typedef struct
+{
+  int set;                 /* role is in the profile, otherwise left alone */
+  int cpu[PLACE_MAX_CPUS]; /* CPUs in the order lanes are spread over them */
+  int cpuCount;            /* 0 for any CPU */
+  int policy;              /* SCHED_OTHER, SCHED_FIFO or SCHED_RR */
+} place_rule_t;
+
+typedef struct
+{
+  place_rule_t rule[NUM_PLACE_ROLES];
+} placement_t;
+
+int  placementParse(placement_t *place, const char *spec);
+int  placementCheck(const placement_t *place, FILE *out);
+int  placementApply(const placement_t *place, place_role_t role, int lane, int priority, pthread_t thread);
+void placementPrint(FILE *out, const placement_t *place);
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * ****************************************************************************
+ * File           : rma.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Schedulability analysis of the controller's tasks. Tasks
+ *                  get deadline monotonic priorities (rate monotonic when
+ *                  deadlines equal periods) and response time analysis
+ *                  checks every deadline is met before any task is spawned.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef RMA_H
+#define RMA_H
+
+#include <stdio.h>
+
+#include "budget.h"
+#include "config.h"
+
+/* One periodic or sporadic task, times in seconds */
+typedef struct
+{
+  char   name[TASK_NAME_LENGTH];
+  double period;   /* period, or shortest time between releases */
+  double wcet;     /* worst case execution time */
+  int    measured; /* wcet is a measured worst case, not an estimate */
+  double deadline; /* relative deadline, 0 for the period */
+  double blocking; /* longest wait on a lower priority task's lock */
+  int    level;    /* out: priority level, 0 highest */
+  double response; /* out: worst case response time, 0 if unbounded */
+} rma_task_t;
+
+/* Tasks in the controller set, the timer task then size, count and gate
+   tasks for each lane */
+#define RMA_TIMER           0
+#define RMA_SIZE            0
+#define RMA_COUNT           1
+#define RMA_GATE            2
+#define RMA_PER_LANE        3
+#define RMA_LANE(lane, kind) (1 + (lane) * RMA_PER_LANE + (kind))
+#define RMA_TASKS(lanes)    (1 + (lanes) * RMA_PER_LANE)
+
+int    rmaControllerTasks(rma_task_t *task, int lanes, double tickRate);
+int    rmaMeasured(rma_task_t *task, const task_budget_t *budget, int count);
+int    rmaAnalyse(rma_task_t *task, int count);
+double rmaUtilisation(const rma_task_t *task, int count);
+double rmaBound(int count);
+void   rmaPrint(FILE *out, const rma_task_t *task, int count);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * ****************************************************************************
+ * File           : rng.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Small, fast pseudo random number generator (xoshiro256**)
+ *                  for simulated sensors. Each generator is independent, so
+ *                  giving every lane its own needs no locking, and a seed
+ *                  always reproduces the same sequence.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+typedef struct
+{
+  uint64_t s[4];
+} rng_t;
+
+void rngSeed(rng_t *rng, uint64_t seed);
+double rngUniform(rng_t *rng);
+
+/**
+ * @brief Next 64 random bits
+ *
+ */
+static inline uint64_t rngNext(rng_t *rng)
+{
+  uint64_t *s = rng->s;
+  uint64_t x = s[1] * 5;
+  uint64_t result = ((x << 7) | (x >> 57)) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = (s[3] << 45) | (s[3] >> 19);
+
+  return result;
+}
+
+/**
+ * @brief Random number from 0 to range - 1, by multiply and shift rather
+ *        than modulo so no division is needed
+ *
+ */
+static inline uint32_t rngBelow(rng_t *rng, uint32_t range)
+{
+  return (uint32_t)(((rngNext(rng) >> 32) * range) >> 32);
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * ****************************************************************************
+ * File           : script.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Command scripts for running the simulator headless.
+ *                  A script is a list of counter reads and resets, each at
+ *                  a virtual time, applied while the plant runs unattended.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+/* Lane of a command that applies to every lane */
+#define SCRIPT_ALL_LANES -1
+
+typedef enum
+{
+  SCRIPT_READ,
+  SCRIPT_RESET
+} script_action_t;
+
+typedef struct
+{
+  double time;    /* virtual seconds from the start of the run */
+  int    action;  /* script_action_t */
+  int    ctr;     /* SMALL, BIG, COLLECTED or ALL from ui.h */
+  int    lane;    /* lane number from 0, or SCRIPT_ALL_LANES */
+} script_cmd_t;
+
+/* Commands in time order, commands at the same time keep their file order */
+typedef struct
+{
+  script_cmd_t *cmd;
+  int count;
+  int cap;
+} script_t;
+
+void scriptInit(script_t *script);
+int  scriptAdd(script_t *script, const char *line);
+int  scriptLoad(script_t *script, const char *path);
+void scriptFree(script_t *script);
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * ****************************************************************************
+ * File           : sim.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Discrete-event simulation of the conveyor belt. Blocks,
+ *                  sensor hits and gate movements are events on a time
+ *                  ordered queue, so the plant runs in virtual time as fast
+ *                  as the host allows.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+/* Virtual time, in microseconds since the start of the simulation */
+typedef uint64_t sim_time_t;
+
+#define SIM_US_PER_SEC 1000000ULL
+
+/* Returned by an arrival callback when a lane has no more blocks */
+#define SIM_NEVER UINT64_MAX
+
+/* Converts a time in seconds (as used in config.h) to virtual time */
+#define SIM_SECONDS(s) ((sim_time_t)((s) * (double)SIM_US_PER_SEC))
+
+/* Event types, listed in the order they are handled when due at the same time */
+typedef enum
+{
+  EV_GATE_OPEN,   /* controller opens a gate */
+  EV_GATE_CLOSE,  /* controller closes a gate */
+  EV_ARRIVAL,     /* block reaches the size sensors */
+  EV_GATE_REACH,  /* block reaches the gate */
+  EV_COUNT_HIT,   /* block reaches the count sensor */
+  EV_COUNT_READ,  /* controller reads the count sensor */
+  NUM_EVENTS
+} sim_event_type_t;
+
+typedef struct
+{
+  sim_time_t time;
+  uint32_t   seq;   /* insertion order, keeps equal events stable */
+  uint8_t    type;  /* sim_event_type_t */
+  uint8_t    size;  /* SIZE_SMALL or SIZE_BIG for block events */
+  uint16_t   lane;
+} sim_event_t;
+
+/* Timing of the plant and the controller, all in seconds */
+typedef struct
+{
+  double gateDelay;   /* controller: size sensor to gate closing */
+  double gateClose;   /* controller: time the gate is held closed */
+  double countDelay;  /* controller: size sensor to count sensor read */
+  double pollPeriod;  /* controller: size sensor polling period, 0 = instant */
+  double tickRate;    /* controller: timer ticks per second, 0 = exact */
+  double gateTravel;  /* belt: size sensor to gate */
+  double countTravel; /* belt: size sensor to count sensor */
+  double arrivalGap;  /* belt: time between blocks on a lane */
+  int    firstLane;   /* plant lane number of the simulation's lane 0 */
+  int    lanes;
+  int    plantLanes;  /* lanes in the whole plant, over every simulation */
+} sim_params_t;
+
+typedef struct
+{
+  uint64_t events;       /* events processed */
+  uint64_t blocks;       /* blocks placed on the belts */
+  uint64_t small;
+  uint64_t big;
+  uint64_t sorted;       /* small blocks pushed off by their gate */
+  uint64_t missedGates;  /* small blocks that passed an open gate */
+  uint64_t missorted;    /* big blocks wrongly pushed off by a gate */
+  uint64_t collected;    /* count reads that found a block */
+  uint64_t missedCounts; /* count reads that found nothing */
+} sim_stats_t;
+
+/*
+ * Controller side of the simulation. The engine models the belt, the
+ * callbacks are where the controller reacts to it. Lanes passed to the
+ * callbacks are plant lane numbers (firstLane onwards).
+ */
+typedef struct
+{
+  /* time of the next block on a lane, no earlier than now, SIM_NEVER if
+     there are no more. NULL places a block every arrivalGap */
+  sim_time_t (*arrival)(void *arg, int lane, sim_time_t now);
+  /* block at the size sensors, returns SIZE_NONE, SIZE_SMALL or SIZE_BIG */
+  int  (*detect)(void *arg, int lane);
+  /* count sensor read found a block */
+  void (*collect)(void *arg, int lane);
+  /* gate closed (closed = TRUE) or opened (closed = FALSE) */
+  void (*gate)(void *arg, int lane, int closed);
+} sim_ops_t;
+
+typedef struct
+{
+  int gateDepth;  /* number of close windows currently open */
+  int countLatch; /* blocks seen by the count sensor but not yet read */
+} sim_lane_t;
+
+typedef struct
+{
+  sim_params_t params;
+  sim_stats_t  stats;
+  sim_time_t   now;
+
+  /* Event queue, binary min-heap ordered by time, type then seq */
+  sim_event_t *queue;
+  uint32_t     queueLen;
+  uint32_t     queueCap;
+  uint32_t     seq;
+
+  sim_lane_t  *lane;
+
+  /* Pre-computed virtual time versions of params */
+  sim_time_t   gateDelay;
+  sim_time_t   gateClose;
+  sim_time_t   countDelay;
+  sim_time_t   gateTravel;
+  sim_time_t   countTravel;
+  sim_time_t   arrivalGap;
+  sim_time_t   gateToCount;
+  sim_time_t   pollPeriod;
+
+  const sim_ops_t *ops;
+  void            *arg;
+} sim_t;
+
+void simDefaultParams(sim_params_t *params);
+int  simInit(sim_t *sim, const sim_params_t *params, const sim_ops_t *ops, void *arg);
+void simFree(sim_t *sim);
+void simRunUntil(sim_t *sim, sim_time_t end);
+void simRunFor(sim_t *sim, sim_time_t duration);
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * ****************************************************************************
+ * File           : sweep.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Batch parameter sweep. Runs one simulated plant for every
+ *                  combination of timing values and seed, spread over the
+ *                  worker threads, and reports how well each one sorted.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "workload.h"
+
+/* Values start, start + step, ... up to and including stop */
+typedef struct
+{
+  double start;
+  double stop;
+  double step;
+} sweep_range_t;
+
+/* Parameters that can be swept, see sweepLoad for the spec file names */
+enum SweepParams
+{
+  SWEEP_GATE_DELAY,
+  SWEEP_GATE_CLOSE,
+  SWEEP_COUNT_DELAY,
+  SWEEP_TASK_DELAY,
+  SWEEP_CLOCK_RATE,
+  SWEEP_ARRIVAL_GAP,
+  NUM_SWEEP_PARAMS
+};
+
+typedef struct
+{
+  sweep_range_t range[NUM_SWEEP_PARAMS];
+  int      seeds;     /* plants run for each tuple, each with its own seed */
+  int      lanes;     /* lanes per plant */
+  double   duration;  /* virtual seconds each plant runs for */
+  uint64_t seed;      /* first seed */
+  int      useWorkload; /* TRUE when blocks come from workload */
+  workload_t workload;  /* arrival_gap replaces its gap */
+} sweep_spec_t;
+
+void sweepDefaults(sweep_spec_t *spec);
+int  sweepLoad(sweep_spec_t *spec, const char *path);
+int  sweepRun(const sweep_spec_t *spec, FILE *out);
+void sweepFree(sweep_spec_t *spec);
+
+#endif
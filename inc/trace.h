@@ -0,0 +1,84 @@
+/*
+ * ****************************************************************************
+ * File           : trace.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Binary sensor trace format, reader and writer. A trace
+ *                  holds timestamped size and count sensor samples for each
+ *                  lane, stored lane by lane so a reader can walk a lane's
+ *                  samples straight out of the mapped file.
+ *
+ *                  File layout (little endian):
+ *                    trace_header_t
+ *                    trace_lane_t    [header.lanes]
+ *                    trace_sample_t  samples, each lane's samples contiguous
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_MAGIC   0x52545643 /* "CVTR" */
+#define TRACE_VERSION 2 /* 2: 64 bit sample times */
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t lanes;
+  uint32_t tickUs;   /* microseconds per timestamp unit */
+  uint32_t reserved;
+} trace_header_t;
+
+typedef struct
+{
+  uint64_t offset;   /* byte offset of the lane's first sample */
+  uint64_t count;    /* number of samples for the lane */
+} trace_lane_t;
+
+/* Sensors read in a sample, a sample may hold one or both */
+#define TRACE_SIZE  0x01
+#define TRACE_COUNT 0x02
+
+typedef struct
+{
+  uint64_t time;     /* timestamp in ticks of header.tickUs */
+  uint8_t  size;     /* SIZE_NONE, SIZE_SMALL or SIZE_BIG */
+  uint8_t  count;    /* COUNT_NONE or COUNT_BLOCK */
+  uint8_t  valid;    /* TRACE_SIZE and/or TRACE_COUNT */
+  uint8_t  reserved[5];
+} trace_sample_t;
+
+/* Read only view of a mapped trace */
+typedef struct
+{
+  void                 *map;
+  size_t                length;
+  const trace_header_t *header;
+  const trace_lane_t   *lane;
+} trace_t;
+
+/* Trace being recorded, samples are buffered per lane until saved */
+typedef struct
+{
+  int             lanes;
+  uint32_t        tickUs;
+  trace_sample_t **sample;
+  uint64_t       *count;
+  uint64_t       *capacity;
+} trace_writer_t;
+
+int  traceOpen(trace_t *trace, const char *path);
+void traceClose(trace_t *trace);
+const trace_sample_t *traceSamples(const trace_t *trace, int lane, uint64_t *count);
+
+int  traceWriterInit(trace_writer_t *writer, int lanes, uint32_t tickUs);
+int  traceWriterAdd(trace_writer_t *writer, int lane, uint64_t timeUs, int valid, int size, int count);
+int  traceWriterSave(const trace_writer_t *writer, const char *path);
+void traceWriterFree(trace_writer_t *writer);
+
+#endif
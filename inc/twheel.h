@@ -0,0 +1,64 @@
+/*
+ * ****************************************************************************
+ * File           : twheel.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Hierarchical timing wheel. Holds thousands of one-shot
+ *                  timers with tick accuracy, starting and cancelling a
+ *                  timer is O(1) and a tick only touches the timers due in
+ *                  it. Time is whatever tick count the caller advances it by.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef TWHEEL_H
+#define TWHEEL_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+/* Four levels of 64 slots, deadlines up to 2^24 ticks away are placed
+   exactly, later ones are re-placed as the wheel turns */
+#define TW_BITS   6
+#define TW_SLOTS  (1 << TW_BITS)
+#define TW_LEVELS 4
+
+typedef uint64_t tw_tick_t;
+typedef void (*tw_fn_t)(int arg);
+
+typedef struct tw_timer
+{
+  struct tw_timer *next;
+  struct tw_timer *prev;
+  tw_tick_t expires;
+  tw_fn_t   fn;
+  int       arg;
+  uint32_t  gen;   /* bumped each time the timer is freed */
+} tw_timer_t;
+
+/* Refers to one start of a timer, stale once it fires or is cancelled */
+typedef struct
+{
+  tw_timer_t *timer;
+  uint32_t    gen;
+} tw_handle_t;
+
+typedef struct
+{
+  tw_timer_t  slot[TW_LEVELS][TW_SLOTS]; /* list heads */
+  tw_tick_t   now;
+  tw_timer_t *pool;
+  tw_timer_t *freeList;
+  int         timers;
+  int         active;
+  pthread_mutex_t lock;
+} twheel_t;
+
+int  twInit(twheel_t *tw, int timers, tw_tick_t now);
+void twFree(twheel_t *tw);
+tw_handle_t twStart(twheel_t *tw, tw_tick_t delay, tw_fn_t fn, int arg);
+int  twCancel(twheel_t *tw, tw_handle_t handle);
+int  twAdvance(twheel_t *tw, tw_tick_t now);
+int  twActive(twheel_t *tw);
+
+#endif
@@ -21,7 +21,6 @@
 #define UI_STRING_LENGTH 50
 #define UI_MAIN_ITEMS    6
 #define UI_COUNTER_ITEMS 6
-#define UI_CONV_ITEMS    5
 
 
 #define SMALL 1
@@ -44,14 +43,14 @@ typedef enum
 
 extern const char uiMainMenu[UI_MAIN_ITEMS][UI_STRING_LENGTH];
 extern const char uiCounterMenu[UI_COUNTER_ITEMS][UI_STRING_LENGTH];
-extern const char uiConveyorMenu[UI_CONV_ITEMS][UI_STRING_LENGTH];
 
 // User interface functions
 void ui_printf(const char menuArray[][UI_STRING_LENGTH], int numOptions);
+void ui_conveyor_menu(void);
 menu_t ui_main(int menuSelect);
 void ui_counter(int ctr, int cnv);
 void ui_reset(int ctr, int cnv);
-int  ui_input(void);
+int  ui_input(int min, int max);
 
 
 #endif
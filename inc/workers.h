@@ -0,0 +1,23 @@
+/*
+ * ****************************************************************************
+ * File           : workers.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Pool of worker threads for running independent jobs,
+ *                  such as groups of lanes, in parallel
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+/* Job function, called once for each job number from 0 to jobs - 1 */
+typedef void (*work_fn_t)(void *arg, int job);
+
+int  workersStart(int count);
+void workersStop(void);
+int  workersCount(void);
+void workersRun(work_fn_t fn, void *arg, int jobs);
+
+#endif
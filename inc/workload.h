@@ -0,0 +1,60 @@
+/*
+ * ****************************************************************************
+ * File           : workload.h
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Block arrival generator. A workload describes how blocks
+ *                  arrive on every lane (fixed pitch, Poisson, bursts or a
+ *                  recorded trace) and the mix of small and big blocks; each
+ *                  lane then draws its own stream from it.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdint.h>
+
+#include "rng.h"
+#include "trace.h"
+
+/* Arrival distributions */
+typedef enum
+{
+  WL_FIXED,   /* one block every gap */
+  WL_POISSON, /* exponential gaps with mean gap */
+  WL_BURSTY,  /* bursts of blocks burstGap apart, bursts gap apart */
+  WL_TRACE    /* arrivals and sizes taken from a recorded trace */
+} wl_kind_t;
+
+typedef struct
+{
+  wl_kind_t kind;
+  double gap;        /* seconds, mean gap between blocks or bursts */
+  double minGap;     /* seconds, blocks never arrive closer than this */
+  double smallRatio; /* fraction of blocks that are small */
+  double emptyRatio; /* fraction of arrival slots with no block */
+  double burst;      /* WL_BURSTY: mean blocks per burst */
+  double burstGap;   /* WL_BURSTY: mean seconds between blocks in a burst */
+  trace_t trace;     /* WL_TRACE: mapped trace */
+} workload_t;
+
+/* One lane's stream from a workload, owned by a single thread */
+typedef struct
+{
+  rng_t  rng;
+  double time;       /* seconds, arrival time of the last block */
+  int    burstLeft;  /* WL_BURSTY: blocks left in the current burst */
+  const trace_sample_t *next;
+  const trace_sample_t *end;
+  uint32_t tickUs;
+} wl_lane_t;
+
+void workloadDefaults(workload_t *wl);
+int  workloadParse(workload_t *wl, const char *spec);
+void workloadFree(workload_t *wl);
+void workloadLaneInit(const workload_t *wl, wl_lane_t *lane, int laneNum, uint64_t seed);
+int  workloadNext(const workload_t *wl, wl_lane_t *lane, double *time, int *size);
+
+#endif
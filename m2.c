@@ -20,109 +20,99 @@
 #include "sysLib.h"
 #include "semLib.h"
 #include "taskLib.h"
-#include "wdLib.h"
 #include "time.h"
 
 /* Local Files */
 #include "cinterface.h"
 #include "config.h"
+#include "blockring.h"
+#include "budget.h"
+#include "counters.h"
+#include "gatesched.h"
+#include "lanes.h"
+#include "placement.h"
+#include "rma.h"
+#include "twheel.h"
+#include "workload.h"
 
 /* SEMAPHORES */
-/* List of semaphores used */
-enum Semaphores
-{
-  INTERFACE_SEM,
-  GATE_SEM,
-  R_COUNT_SEM,
-  L_COUNT_SEM,
-  NUM_SEM /* Used to initialise semaphore array */
-};
-/* Array to store all semaphore*/
-SEM_ID Sem[NUM_SEM];
+/* The interface is locked per lane with cLaneLock */
+/* Given by countTimerCallback once per big block that is due, one per lane */
+SEM_ID countSem[MAX_LANES];
+/* Given by sizeTask for every small block it passes on, one per lane */
+SEM_ID gateSem[MAX_LANES];
+
+/* PIPELINE */
+/* Blocks passed from each sizeTask to its lane's gate and count tasks */
+block_ring_t gateRing[MAX_LANES];
+block_ring_t countRing[MAX_LANES];
 
 /* TIMERS */
-/* Array of timers for multiple blocks */
-/* Half of array is used for each side*/
-/* eg. if GATE_TIM_NUM=20 RIGHT uses 0-9 and LEFT 10-19*/
-WDOG_ID gateTIM[GATE_TIM_NUM];
-WDOG_ID countTIM[COUNT_TIM_NUM];
+/* Count deadlines of every block in flight, turned by timerTask */
+twheel_t blockTimers;
+/* Close windows waiting at each gate, only touched by the gate's task */
+gate_sched_t gates[MAX_LANES];
 
 /* TASKS */
 /* List of tasks used for controlling conveyor belt */
 enum Tasks
 {
   UI_TASK,
-  L_SIZE_TASK,
-  R_SIZE_TASK,
-  L_COUNT_TASK,
-  R_COUNT_TASK,
-  GATE_TASK,
+  TIMER_TASK,
   NUM_TASKS /* Used to initialise task array*/
 };
 
 /* Used for storing task IDs */
 int Task[NUM_TASKS];
-
-/* List priorities from high to low */
-enum Priority
-{
-  GATE_PR,
-  L_SIZE_PR,
-  R_SIZE_PR,
-  L_COUNT_PR,
-  R_COUNT_PR
-};
-
-/* Structure used to hold counter values for both sides of conveyor*/
-struct
-{
-  int big[2];
-  int small[2];
-  int collected[2];
-} counters;
-
-/* Flags */
-/* Used  for gate control logic */
-int rightGate;
-int leftGate;
+/* Size, count and gate tasks, one of each per lane */
+int sizeTaskId[MAX_LANES];
+int countTaskId[MAX_LANES];
+int gateTaskId[MAX_LANES];
+/* Task names, taskSpawn keeps a pointer to the name */
+char sizeTaskName[MAX_LANES][TASK_NAME_LENGTH];
+char countTaskName[MAX_LANES][TASK_NAME_LENGTH];
+char gateTaskName[MAX_LANES][TASK_NAME_LENGTH];
+
+/* Periods, execution times and the priority levels assigned to them by
+   rmaAnalyse, lanes share a priority level */
+rma_task_t taskSet[RMA_TASKS(MAX_LANES)];
+#define PRIORITY(task) (BASE_PRIORITY + taskSet[task].level)
+/* Per-iteration CPU budgets, the analysed wcet of each task in taskSet */
+task_budget_t budgets[RMA_TASKS(MAX_LANES)];
+/* Release times of size tasks that fell back to polling their sensors */
+TASK_PERIOD sizePeriod[MAX_LANES];
+
+/* Blocks placed by the simulated interface, when progStart is given one */
+workload_t workload;
+int useWorkload = FALSE;
+
+/* CPUs and scheduling policy of each task, when progStart is given them */
+placement_t placement;
+int usePlacement = FALSE;
 
 int shutdownFlg = 0;
 int debugMode = 1;
 
-/* REVIEW Rate Monotonic Scheduling */
-
 /* Function prototpyes */
 void calibration(void);
 void printMenu(char *menuArray, int numOptions);
 void shutdown(void);
+static void lockWaitPrint(const char *name, int conveyor);
 void debugPrintf(char *dbgMessage, ...);
 b
 /* Task Functions */
 void countTask(int side);
-void gateTask(void);
+void gateTask(int side);
+void gateDrain(int side);
 void sizeTask(int side);
+void sizePass(int side, block_t *block);
+void timerTask(void);
+tw_tick_t timerTicks(void);
+void budgetDegrade(task_budget_t *budget);
+void placeTask(int taskId, place_role_t role, int lane, int priority);
+void placeOthers(void);
 void uiTask(void);
 
-/* TODO implement gate control logic*/
-/**
- * @brief Callback function for controlling the gates.
- *        Called when a small block is detected by sizeTask
- *
- * @param side - indicates which conveyor
- */
-void gateTimerCallback(int side)
-{
-  if (side == RIGHT)
-  {
-    rightGate++;
-  }
-  else if (side == LEFT)
-  {
-    leftGate++;
-  }
-  semGive(Sem[GATE_SEM]);
-}
-
 /**
  * @brief Callback function for counter sensor at end of conveyor
  *        Called when a big block is detected by sizeTask
@@ -131,38 +121,87 @@ void gateTimerCallback(int side)
  */
 void countTimerCallback(int side)
 {
-  /* Not the prettiest logic but seems to work */
-  /* LEFT = 1, RIGHT = 0*/
-  /* R_COUNT_SEM + RIGHT = R_COUNT_SEM*/
-  /* R_COUNT_SEM + LEFT  = L_COUNT_SEM*/
-  semGive(Sem[R_COUNT_SEM + side]);
+  semGive(countSem[side]);
 }
 
 /**
  * @brief Main function for coursework, runs calibration and starts tasks and timers for controlling conveyor belt
  *
+ * @param laneCount - number of conveyor lanes to control, 0 for DEFAULT_LANES
+ * @param workloadSpec - blocks for the simulated interface to place, see
+ *                       workloadParse, NULL for its random readings
+ * @param placeSpec - CPUs and scheduling policies of the tasks, see
+ *                    placement.c, NULL to leave them as spawned
  */
-void progStart(void)
+void progStart(int laneCount, char *workloadSpec, char *placeSpec)
 {
-  int tim; /*Used for timer initialisation for loop*/
+  int lane;
   char rxChar;
+  TASK_PERIOD motorPeriod;
 
-  /* Mutually exclusive to prevent reentrance in the interface library */
-  Sem[INTERFACE_SEM] = semMCreate(SEM_Q_PRIORITY);
+  if (laneCount == 0)
+  {
+    laneCount = DEFAULT_LANES;
+  }
+  if (lanesInit(laneCount) != 0)
+  {
+    printf("Lanes must be between 1 and %d\n", MAX_LANES);
+    return;
+  }
+  if (workloadSpec != NULL)
+  {
+    if (workloadParse(&workload, workloadSpec) != 0)
+    {
+      printf("Invalid workload %s\n", workloadSpec);
+      return;
+    }
+    useWorkload = TRUE;
+  }
+  if (placeSpec != NULL)
+  {
+    if (placementParse(&placement, placeSpec) != 0)
+    {
+      printf("Invalid placement %s\n", placeSpec);
+      return;
+    }
+    if (placementCheck(&placement, stdout) != 0)
+    {
+      printf("Placement can't be applied, not started\n");
+      return;
+    }
+    placementPrint(stdout, &placement);
+    usePlacement = TRUE;
+  }
 
-  Sem[GATE_SEM]    = semBCreate(SEM_Q_FIFO, SEM_EMPTY);
-  Sem[R_COUNT_SEM] = semBCreate(SEM_Q_FIFO, SEM_EMPTY);
-  Sem[L_COUNT_SEM] = semBCreate(SEM_Q_FIFO, SEM_EMPTY);
+  /* Priorities come from the response time analysis, a task set that can
+     miss a deadline isn't started */
+  if (rmaAnalyse(taskSet, rmaControllerTasks(taskSet, numLanes, sysClkRateGet())) != 0)
+  {
+    rmaPrint(stdout, taskSet, RMA_TASKS(numLanes));
+    printf("%d lanes can miss deadlines, not started\n", numLanes);
+    return;
+  }
+  debugPrintf("Utilisation %.3f with %d lanes\n", rmaUtilisation(taskSet, RMA_TASKS(numLanes)), numLanes);
 
+  /* Hold every task to the execution time the analysis assumed */
+  for (lane = 0; lane < RMA_TASKS(numLanes); lane++)
+  {
+    budgetInit(&budgets[lane], taskSet[lane].name, taskSet[lane].wcet, budgetDegrade);
+  }
 
-  /* Initialise watchdog timer arrays */
-  for (tim = 0; tim < GATE_TIM_NUM; tim++)
+  /* Count semaphore and gate queue for each lane */
+  for (lane = 0; lane < numLanes; lane++)
   {
-    gateTIM[tim] = wdCreate();
+    countSem[lane] = semCCreate(SEM_Q_FIFO, 0);
+    gateSem[lane]  = semCCreate(SEM_Q_FIFO, 0);
+    gateSchedInit(&gates[lane]);
   }
-  for (tim = 0; tim < COUNT_TIM_NUM; tim++)
+
+  /* One timer per block in flight, shared by every lane */
+  if (twInit(&blockTimers, BLOCK_TIMERS, timerTicks()) != 0)
   {
-    countTIM[tim] = wdCreate();
+    printf("Could not create block timers\n");
+    return;
   }
 
   /* user prompt for running calibration routine */
@@ -182,44 +221,66 @@ void progStart(void)
     startMotor();
   }
 
-  /* Start tasks */
-  /*                                     Task Name,   Priority, Options, Stack,   Function Pointer, Arguments*/
-  Task[L_SIZE_TASK]  = taskSpawn( "CW_l_size_task",  L_SIZE_PR,       0, 20000,  (FUNCPTR)sizeTask, LEFT, 0, 0, 0, 0, 0, 0, 0, 0, 0);
-  Task[R_SIZE_TASK]  = taskSpawn( "CW_r_size_task",  R_SIZE_PR,       0, 20000,  (FUNCPTR)sizeTask, RIGHT, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  /* Blocks start arriving once the motor is running */
+  if (useWorkload == TRUE)
+  {
+    cWorkloadStart(&workload, DEFAULT_SEED);
+  }
 
-  Task[L_COUNT_TASK] = taskSpawn("CW_l_count_task", L_COUNT_PR,       0, 20000, (FUNCPTR)countTask, LEFT, 0, 0, 0, 0, 0, 0, 0, 0, 0);
-  Task[R_COUNT_TASK] = taskSpawn("CW_r_count_task", R_COUNT_PR,       0, 20000, (FUNCPTR)countTask, RIGHT, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  /* Start tasks, a size, count and gate task for every lane */
+  for (lane = 0; lane < numLanes; lane++)
+  {
+    snprintf(sizeTaskName[lane], TASK_NAME_LENGTH, "CW_size_task_%d", lane);
+    snprintf(countTaskName[lane], TASK_NAME_LENGTH, "CW_count_task_%d", lane);
+    snprintf(gateTaskName[lane], TASK_NAME_LENGTH, "CW_gate_task_%d", lane);
+
+    /*                                          Task Name, Priority, Options, Stack,   Function Pointer, Arguments*/
+    sizeTaskId[lane]  = taskSpawn( sizeTaskName[lane], PRIORITY(RMA_LANE(lane, RMA_SIZE)),  0, 20000,  (FUNCPTR)sizeTask, lane, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    countTaskId[lane] = taskSpawn(countTaskName[lane], PRIORITY(RMA_LANE(lane, RMA_COUNT)), 0, 20000, (FUNCPTR)countTask, lane, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    gateTaskId[lane]  = taskSpawn( gateTaskName[lane], PRIORITY(RMA_LANE(lane, RMA_GATE)),  0, 20000,  (FUNCPTR)gateTask, lane, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    placeTask(sizeTaskId[lane],  PLACE_SIZE,  lane, PRIORITY(RMA_LANE(lane, RMA_SIZE)));
+    placeTask(countTaskId[lane], PLACE_COUNT, lane, PRIORITY(RMA_LANE(lane, RMA_COUNT)));
+    placeTask(gateTaskId[lane],  PLACE_GATE,  lane, PRIORITY(RMA_LANE(lane, RMA_GATE)));
+  }
 
-  Task[GATE_TASK]    = taskSpawn(   "CW_gate_task",    GATE_PR,       0, 20000,  (FUNCPTR)gateTask, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  Task[TIMER_TASK]   = taskSpawn(  "CW_timer_task", PRIORITY(RMA_TIMER),                  0, 20000, (FUNCPTR)timerTask, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  placeTask(Task[TIMER_TASK], PLACE_TIMER, -1, PRIORITY(RMA_TIMER));
+  placeOthers();
   /*
   Task[UI_TASK] =       taskSpawn(     "CW_ui_task",        UI_PR,       0,     20000,    (FUNCPTR)uiTask,      0,0,0,0,0,0,0,0,0,0);
   */
 
-  /* Give interface semaphore to start tasks */
-  semGive(Sem[INTERFACE_SEM]);
-
   /* Run until user requests shutdown */
+  taskPeriodInit(&motorPeriod, 250 * sysClkRateGet());
   while (shutdownFlg == FALSE)
   {
-    /* Wait for 5 minutes */
-    taskDelay(250 * sysClkRateGet());
+    /* Wait for 5 minutes, counted from the last restart rather than from
+       when the motor lock was released */
+    taskPeriodWait(&motorPeriod);
     /* Restart motors as it stops after certain period */
-    semTake(Sem[INTERFACE_SEM], WAIT_FOREVER);
+    cDeviceLock();
     startMotor();
-    semGive(Sem[INTERFACE_SEM]);
+    cDeviceUnlock();
   }
 }
 
 /**
- * @brief Task for handling size detection
+ * @brief Task for handling size detection. Sleeps until the interface reports
+ *        a sensor edge, or polls every TASK_DELAY ticks if it can't. Polls
+ *        are released on a fixed period, so the time taken by each one
+ *        doesn't slow the sampling rate.
  *
  * @param side - Indicates which conveyor belt to monitor
  */
 void sizeTask(int side)
 {
   int sensorVal;
-  int gateTimCnt  = 0;
-  int countTimCnt = 0;
+  int polling = FALSE;
+  int counted;
+  block_t block = {.id = 0, .lane = side};
+  cEvent_t event;
+  task_budget_t *budget = &budgets[RMA_LANE(side, RMA_SIZE)];
 
   /* States for size detection FSM */
   typedef enum Size_State
@@ -231,13 +292,32 @@ void sizeTask(int side)
   } Size_State;
 
   Size_State state = WAITING;
-  printf("%s size task started\n", sideString[side]);
+  printf("%s size task started\n", laneName(side));
 
   while (1)
   {
-    semTake(Sem[INTERFACE_SEM], WAIT_FOREVER);
-    sensorVal = readSizeSensors(side);
-    resetSizeSensors(side);
+    /* Block until the sensors change */
+    if (polling == FALSE && cWaitSensor(side, &event, CIF_WAIT_FOREVER) == 1)
+    {
+      budgetStart(budget);
+      sensorVal = event.size;
+    }
+    else
+    {
+      if (polling == FALSE)
+      {
+        polling = TRUE;
+        taskPeriodInit(&sizePeriod[side], TASK_DELAY);
+      }
+      budgetStart(budget);
+
+      /* Only this lane's count task can contend for the lane */
+      cLaneLock(side);
+      sensorVal = readSizeSensors(side);
+      resetSizeSensors(side);
+      cLaneUnlock(side);
+    }
+
     /* Block detection FSM */
     switch (state)
     {
@@ -248,7 +328,7 @@ void sizeTask(int side)
       {
         /* Change state */
         state = DETECTED;
-        debugPrintf("%s DETECTED\n", sideString[side]);
+        debugPrintf("%s DETECTED\n", laneName(side));
       }
       break;
 
@@ -259,144 +339,314 @@ void sizeTask(int side)
       {
         /* Change state*/
         state = BIG;
-
-        counters.big[side]++;
-
-        /* Start watchdog timer for triggering count sensor task */
-        wdStart(countTIM[countTimCnt + (side * (COUNT_TIM_NUM / 2))], COUNT_DELAY * sysClkRateGet(), (FUNCPTR)countTimerCallback, side);
-
-        debugPrintf("%s %i Big blocks detected\n", sideString[side], counters.big[side]);
-
-        /* increment watchdog timer index and boundary check*/
-        countTimCnt++;
-        if (countTimCnt == (COUNT_TIM_NUM / 2))
-        {
-          countTimCnt = 0;/*Reset*/
-        }
+        counted = counterInc(&lanes[side].counters, CTR_SIZE_WRITER, CTR_BIG);
+        block.size = SIZE_BIG;
+        sizePass(side, &block);
+        debugPrintf("%s %i Big blocks detected\n", laneName(side), counted);
       }
       /* Nothing in front of sensors */
       else if (sensorVal == 0)
       {
         state = SMALL;
-        counters.small[side]++;
-
-        wdStart(gateTIM[gateTimCnt + (side * (GATE_TIM_NUM / 2))], GATE_DELAY * sysClkRateGet(), (FUNCPTR)gateTimerCallback, side);
-
-        debugPrintf("%s %i Small blocks detected\n", sideString[side], counters.small[side]);
-
-        gateTimCnt++;
-        if (gateTimCnt == (GATE_TIM_NUM / 2))
-        {
-          gateTimCnt = 0;
-        }
+        counted = counterInc(&lanes[side].counters, CTR_SIZE_WRITER, CTR_SMALL);
+        block.size = SIZE_SMALL;
+        sizePass(side, &block);
+        debugPrintf("%s %i Small blocks detected\n", laneName(side), counted);
       }
       break;
     /*REVIEW functionality for SMALL and BIG states?*/
     default:
-      /* Reset state to WAITING*/
-      state = WAITING;
+      /* Reset state to WAITING, the next block may already be in front of
+         the first sensor */
+      state = (sensorVal == 1) ? DETECTED : WAITING;
       break;
     }
-    /* Give semaphore back and delay to allow other tasks to function */
-    semGive(Sem[INTERFACE_SEM]);
-    taskDelay(TASK_DELAY);
+    budgetStop(budget);
+    /* Wait for the next poll, skipping any that are already a whole period
+       overdue */
+    if (polling == TRUE)
+    {
+      taskPeriodWait(&sizePeriod[side]);
+    }
   }
 }
 
 /**
- * @brief Task for monitoring count sensors at the end of the
+ * @brief Passes an identified block on to the next stage of its lane. Big
+ *        blocks go to the count task with a timer for when they reach the
+ *        count sensor, small blocks go to the gate task.
+ *
+ * @param side  - lane the block is on
+ * @param block - record of the block, its id is moved on for the next one
+ */
+void sizePass(int side, block_t *block)
+{
+  block->detected = timerTicks();
+  if (block->size == SIZE_BIG)
+  {
+    if (blockRingPush(&countRing[side], block) != 0)
+    {
+      printf("%s block %u lost, %d blocks waiting to be counted\n", laneName(side), block->id, BLOCK_RING);
+    }
+    /* Timers fire in the order they were started, so each give is for the
+       oldest block in the ring. A block without a timer has to come back
+       out, or every later give would pop the block before its own */
+    else if (twStart(&blockTimers, COUNT_DELAY * sysClkRateGet(), countTimerCallback, side).timer == NULL)
+    {
+      blockRingUnpush(&countRing[side]);
+      printf("%s block %u lost, %d count timers in flight\n", laneName(side), block->id, BLOCK_TIMERS);
+    }
+  }
+  else if (blockRingPush(&gateRing[side], block) != 0)
+  {
+    printf("%s block %u lost, %d blocks waiting for the gate\n", laneName(side), block->id, BLOCK_RING);
+  }
+  else
+  {
+    semGive(gateSem[side]);
+  }
+  block->id++;
+}
+
+/**
+ * @brief Task for monitoring count sensors at the end of the belt. Each
+ *        wakeup is for one big block, so every reading is matched to the
+ *        block it should have seen.
  *
  * @param side - RIGHT or LEFT to indicate conveyor belt
  */
 void countTask(int side)
 {
   int sensorVal = 0;
-  int detected = 0;
-  int Count = 0;
+  int counted;
+  block_t block;
+  task_budget_t *budget = &budgets[RMA_LANE(side, RMA_COUNT)];
 
-  printf("%s side count sensor task started\n", sideString[side]);
+  printf("%s side count sensor task started\n", laneName(side));
 
   while (1)
   {
-    /* Janky logic, described in countTimerCallback */
-    semTake(Sem[R_COUNT_SEM + side], WAIT_FOREVER);
-    semTake(Sem[INTERFACE_SEM], WAIT_FOREVER);
+    /* Given by countTimerCallback when the oldest block is due */
+    semTake(countSem[side], WAIT_FOREVER);
+    if (blockRingPop(&countRing[side], &block) != 0)
+    {
+      continue;
+    }
+    budgetStart(budget);
 
     /* Read sensor value and reset to keep interface happy*/
+    cLaneLock(side);
     sensorVal = readCountSensor(side);
     resetCountSensor(side);
+    cLaneUnlock(side);
 
-    /* FIXME Is detected redundant now that count watchdog is being used?*/
-    /* Only increment count if the sensor hasn't already detected the block */
-    if ((sensorVal == 1) && (detected == 0))
+    if (sensorVal == 1)
     {
-      detected = 1;
-      counters.collected[side]++;
-      debugPrintf("%s %i blocks counted\n", sideString[side], counters.collected[side]);
+      counted = counterInc(&lanes[side].counters, CTR_COUNT_WRITER, CTR_COLLECTED);
+      debugPrintf("%s %i blocks counted, block %u after %u ticks\n", laneName(side), counted,
+                  block.id, (unsigned)(timerTicks() - block.detected));
     }
     else
     {
-      detected = 0;
+      debugPrintf("%s block %u not seen by the count sensor\n", laneName(side), block.id);
     }
-    semGive(Sem[INTERFACE_SEM]);
+    budgetStop(budget);
   }
 }
 
 
-/* REVIEW seperate tasks for each gate? */
 /**
- * @brief Task for controlling the gates, triggered by timer interrupt when gateSEM is given
+ * @brief Current time in system clock ticks, the time base of blockTimers
  *
+ * @return tw_tick_t - ticks of CLOCK_MONOTONIC
  */
-void gateTask(void)
+tw_tick_t timerTicks(void)
 {
-  int GateVal;
+  struct timespec now;
+  int rate = sysClkRateGet();
 
-  printf("Gate task started\n");
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (tw_tick_t)now.tv_sec * rate + (tw_tick_t)now.tv_nsec * rate / 1000000000;
+}
+
+/**
+ * @brief Task turning the block timer wheel every tick. The wheel is moved to
+ *        the clock rather than by one tick per wakeup, so a late wakeup fires
+ *        the timers it missed instead of drifting.
+ *
+ */
+void timerTask(void)
+{
+  task_budget_t *budget = &budgets[RMA_TIMER];
+
+  printf("Timer task started\n");
 
   while (1)
   {
-    /* Semaphore given by gateTimerCallback*/
-    semTake(Sem[GATE_SEM], WAIT_FOREVER);
-    GateVal = 0;
+    /* Timer callbacks are charged to the timer task */
+    budgetStart(budget);
+    twAdvance(&blockTimers, timerTicks());
+    budgetStop(budget);
+    taskDelay(1);
+  }
+}
 
-    /* check counters and set gateVal accordingly*/
-    if (leftGate >= 1)
-    {
-      GateVal += 2;
-    }
-    if (rightGate >= 1)
+/**
+ * @brief Turns the small blocks passed on by sizeTask into close windows on
+ *        the gate's queue
+ *
+ * @param side - lane of the gate
+ */
+void gateDrain(int side)
+{
+  block_t block;
+  tw_tick_t closeAt;
+
+  while (blockRingPop(&gateRing[side], &block) == 0)
+  {
+    closeAt = block.detected + GATE_DELAY * sysClkRateGet();
+    if (gateSchedAdd(&gates[side], closeAt, closeAt + GATE_CLOSE * sysClkRateGet()) < 0)
     {
-      GateVal += 1;
+      printf("%s gate window for block %u lost, %d windows queued\n", laneName(side), block.id, GATE_WINDOWS);
     }
+  }
+}
 
-    /* Close gates and wait for GATE_CLOSE seconds till opening*/
-    setGates(GateVal);
-    taskDelay(GATE_CLOSE * sysClkRateGet());
+/**
+ * @brief Task for controlling one gate. Works through the gate's queue of
+ *        close windows, closing at the start of each and opening at its end.
+ *        Windows merged while the gate is closed keep it closed, so a run of
+ *        small blocks moves the gate once. Gates never wait on each other.
+ *
+ * @param side - lane of the gate
+ */
+void gateTask(int side)
+{
+  gate_window_t window;
+  tw_tick_t now;
+  tw_tick_t remaining;
+  task_budget_t *budget = &budgets[RMA_LANE(side, RMA_GATE)];
 
-    /* count down side counters*/
-    leftGate--;
-    rightGate--;
-    GateVal = 0;
+  printf("%s gate task started\n", laneName(side));
 
-    if (leftGate > 1)
+  while (1)
+  {
+    /* A close cycle is one iteration, time asleep in it isn't charged */
+    budgetStart(budget);
+
+    /* Only sleep once every block passed on has a window */
+    gateDrain(side);
+    if (gateSchedPeek(&gates[side], &window) != 0)
     {
-      GateVal += 2;
+      semTake(gateSem[side], WAIT_FOREVER);
+      continue;
     }
-    else if (leftGate <= 0)
+
+    now = timerTicks();
+    if (window.close > now)
     {
-      leftGate = 0;
+      taskDelay(window.close - now);
     }
+    setGate(side, GATE_CLOSED);
+    debugPrintf("%s gate closed\n", laneName(side));
+
+    /* Stay closed until the window, and any merged into it, has ended */
+    do
+    {
+      gateDrain(side);
+      remaining = gateSchedRelease(&gates[side], timerTicks());
+      if (remaining > 0)
+      {
+        taskDelay(remaining);
+      }
+    } while (remaining > 0);
+    setGate(side, GATE_OPEN);
+    debugPrintf("%s gate open\n", laneName(side));
+    budgetStop(budget);
+  }
+}
+
+/**
+ * @brief Moves a spawned task to the CPUs and policy the placement profile
+ *        gives its role
+ *
+ * @param taskId   - task to move
+ * @param role     - what the task does
+ * @param lane     - lane of a lane task, -1 otherwise
+ * @param priority - VxWorks priority it was spawned at
+ */
+void placeTask(int taskId, place_role_t role, int lane, int priority)
+{
+  v2pthread_cb_t *tcb;
+
+  if (usePlacement == FALSE)
+  {
+    return;
+  }
+  tcb = (v2pthread_cb_t *)taskTcb(taskId);
+  if (tcb == NULL || placementApply(&placement, role, lane, priority, tcb->pthrid) != 0)
+  {
+    printf("Could not place task %s\n", taskName(taskId));
+  }
+}
 
-    if (rightGate > 1)
+/**
+ * @brief Places the thread running progStart as the UI, and every task
+ *        the controller didn't spawn, libv2lin's own included, as other
+ */
+void placeOthers(void)
+{
+  int ids[MAX_TASK_IDS];
+  int count;
+  int i;
+  int lane;
+  int ours;
+  int priority;
+
+  if (usePlacement == FALSE)
+  {
+    return;
+  }
+  if (placementApply(&placement, PLACE_UI, -1, MIN_V2PT_PRIORITY, pthread_self()) != 0)
+  {
+    printf("Could not place the UI\n");
+  }
+
+  count = taskIdListGet(ids, MAX_TASK_IDS);
+  for (i = 0; i < count; i++)
+  {
+    ours = (ids[i] == Task[TIMER_TASK]);
+    for (lane = 0; lane < numLanes && ours == FALSE; lane++)
     {
-      GateVal += 1;
+      ours = (ids[i] == sizeTaskId[lane] || ids[i] == countTaskId[lane] || ids[i] == gateTaskId[lane]);
     }
-    else if (rightGate <= 0)
+    if (ours == FALSE && taskPriorityGet(ids[i], &priority) == OK)
     {
-      rightGate = 0;
+      placeTask(ids[i], PLACE_OTHER, -1, priority);
     }
-    setGates(GateVal);
+  }
+}
+
+/**
+ * @brief Degrade action for every task's budget, run by the task that
+ *        overran. Debug output goes first as printing is the slowest part
+ *        of most iterations, if overruns carry on the UI task is moved to
+ *        the lowest priority.
+ *
+ * @param budget - budget that was overrun
+ */
+void budgetDegrade(task_budget_t *budget)
+{
+  if (debugMode == TRUE)
+  {
+    debugMode = FALSE;
+    printf("%s over budget, took %lluus, debug output off\n", budget->name,
+           (unsigned long long)(budget->worstNs / 1000));
+  }
+  else if (Task[UI_TASK] != 0 && budget->overruns == BUDGET_DEGRADE_UI)
+  {
+    taskPrioritySet(Task[UI_TASK], MIN_V2PT_PRIORITY);
+    printf("%s still over budget, UI task lowered\n", budget->name);
   }
 }
 
@@ -574,7 +824,7 @@ void uiTask(void)
     case 0x32:
       printMenu(uiCounterMenu, UI_COUNTER_ITEMS);
       counterSel = getchar();
-      printMenu(uiConveyorMenu, UI_CONV_ITEMS);
+      ui_conveyor_menu();
       conveyorSel = getchar();
 
       break;
@@ -619,8 +869,8 @@ void uiTask(void)
 void shutdown(void)
 {
   int task;
-  int semaphore;
-  int timer;
+  int lane;
+  int missed;
 
   printf("Shutting down\n");
 
@@ -630,15 +880,65 @@ void shutdown(void)
     taskDelete(Task[task]);
   }
 
-  for (semaphore = 0; semaphore < NUM_SEM; semaphore++)
+  for (lane = 0; lane < numLanes; lane++)
   {
-    semDelete(Sem[semaphore]);
+    taskDelete(sizeTaskId[lane]);
+    taskDelete(countTaskId[lane]);
+    taskDelete(gateTaskId[lane]);
+    semDelete(countSem[lane]);
+    semDelete(gateSem[lane]);
   }
 
-  for (timer = 0; timer < GATE_TIM_NUM; timer++)
+  budgetPrint(stdout, budgets, RMA_TASKS(numLanes));
+
+  /* The analysis at startup had only estimates, check it with what ran */
+  if (rmaMeasured(taskSet, budgets, RMA_TASKS(numLanes)) > 0)
+  {
+    missed = rmaAnalyse(taskSet, RMA_TASKS(numLanes));
+    rmaPrint(stdout, taskSet, RMA_TASKS(numLanes));
+    printf("With measured execution times %d lanes %s\n", numLanes,
+           (missed == 0) ? "are schedulable" : "can miss deadlines");
+  }
+  for (lane = 0; lane < numLanes; lane++)
+  {
+    if (sizePeriod[lane].releases > 0)
+    {
+      printf("%s size polls: %u released, %u late, %u missed\n", laneName(lane),
+             sizePeriod[lane].releases, sizePeriod[lane].late, sizePeriod[lane].missed);
+    }
+  }
+  lockWaitPrint("Device", CIF_DEVICE_LOCK);
+  for (lane = 0; lane < numLanes; lane++)
+  {
+    lockWaitPrint(laneName(lane), lane);
+  }
+
+  /* Timer task is gone, pending block timers are dropped */
+  twFree(&blockTimers);
+
+  if (useWorkload == TRUE)
+  {
+    cWorkloadStop();
+    workloadFree(&workload);
+    useWorkload = FALSE;
+  }
+}
+
+/**
+ * @brief prints how long tasks waited for an interface lock, if they ever did
+ *
+ * @param name     - what the lock guards
+ * @param conveyor - lane of the lock, CIF_DEVICE_LOCK for the device lock
+ */
+static void lockWaitPrint(const char *name, int conveyor)
+{
+  cLockWait_t wait;
+
+  cLockWaitGet(conveyor, &wait);
+  if (wait.count > 0)
   {
-    wdCancel(gateTIM[timer]);
-    wdDelete(gateTIM[timer]);
+    printf("%s lock: %u waits, %.1f us mean, %.1f us max\n", name, wait.count,
+           wait.totalNs / 1000.0 / wait.count, wait.maxNs / 1000.0);
   }
 }
 
@@ -666,22 +966,24 @@ void printMenu(char *menuArray, int numOptions)
 void counterMenu(void)
 {
   char menuSelect;
+  counter_snap_t snap[MAX_LANES];
 
   printMenu(uiCounterMenu, UI_COUNTER_ITEMS);
   menuSelect = getchar();
+  countersRead(snap);
 
   if (menuSelect == 0x33)
   {
-    printf("%d small blocks counted on %s conveyor\n", counters.small[LEFT], sideString[LEFT]);
-    printf("%d small blocks counted on %s conveyor\n", counters.small[RIGHT], sideString[RIGHT]);
+    printf("%d small blocks counted on %s conveyor\n", (int)snap[LEFT].value[CTR_SMALL], laneName(LEFT));
+    printf("%d small blocks counted on %s conveyor\n", (int)snap[RIGHT].value[CTR_SMALL], laneName(RIGHT));
   }
   else if (menuSelect == 0x32)
   {
-    printf("%d small blocks counted on %s conveyor\n", counters.small[RIGHT], sideString[RIGHT]);
+    printf("%d small blocks counted on %s conveyor\n", (int)snap[RIGHT].value[CTR_SMALL], laneName(RIGHT));
   }
   else if (menuSelect == 0x33)
   {
-    printf("%d small blocks counted on %s conveyor\n", counters.small[LEFT], sideString[LEFT]);
+    printf("%d small blocks counted on %s conveyor\n", (int)snap[LEFT].value[CTR_SMALL], laneName(LEFT));
   }
   else
   {
@@ -0,0 +1,84 @@
+/*
+ * ****************************************************************************
+ * File           : budget.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Per-task execution budgets, see budget.h. The common
+ *                  path is inline in the header, this file has the rarely
+ *                  run parts.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <stdio.h>
+#include <string.h>
+
+//Project Header Files
+#include "../inc/budget.h"
+#include "../inc/config.h"
+/* !SECTION Includes */
+
+
+// Global functions
+
+/**
+ * @brief Sets up a task's budget with nothing charged to it
+ *
+ * @param budget  - budget to initialise
+ * @param name    - task it belongs to, for reports
+ * @param seconds - CPU time allowed per iteration
+ * @param overrun - degrade action run on every overrun, NULL for none
+ */
+void budgetInit(task_budget_t *budget, const char *name, double seconds, budget_fn_t overrun)
+{
+  memset(budget, 0, sizeof(*budget));
+  snprintf(budget->name, TASK_NAME_LENGTH, "%s", name);
+  budget->budgetNs = (uint64_t)(seconds * 1e9);
+  budget->overrun  = overrun;
+}
+
+/**
+ * @brief Records an iteration that went over budget and degrades. Kept out
+ *        of line, budgetStop only calls it when something is already late.
+ *
+ * @param budget - budget that was overrun
+ * @param used   - CPU time the iteration used, nanoseconds
+ */
+void budgetOverrun(task_budget_t *budget, uint64_t used)
+{
+  __atomic_store_n(&budget->overruns, budget->overruns + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&budget->excessNs, budget->excessNs + used - budget->budgetNs, __ATOMIC_RELAXED);
+  if (budget->overrun != NULL)
+  {
+    budget->overrun(budget);
+  }
+}
+
+/**
+ * @brief Prints runs and overruns of a list of budgets, times in
+ *        microseconds
+ *
+ * @param out    - stream to print to
+ * @param budget - budgets to print
+ * @param count  - number of budgets
+ */
+void budgetPrint(FILE *out, const task_budget_t *budget, int count)
+{
+  int i;
+  uint64_t overruns;
+
+  fprintf(out, "%-*s %10s %10s %10s %10s %12s\n", TASK_NAME_LENGTH, "task",
+          "budget", "runs", "worst", "overruns", "mean excess");
+  for (i = 0; i < count; i++)
+  {
+    overruns = __atomic_load_n(&budget[i].overruns, __ATOMIC_RELAXED);
+    fprintf(out, "%-*s %10.1f %10llu %10.1f %10llu %12.1f\n", TASK_NAME_LENGTH, budget[i].name,
+            budget[i].budgetNs / 1e3,
+            (unsigned long long)__atomic_load_n(&budget[i].runs, __ATOMIC_RELAXED),
+            __atomic_load_n(&budget[i].worstNs, __ATOMIC_RELAXED) / 1e3,
+            (unsigned long long)overruns,
+            overruns ? __atomic_load_n(&budget[i].excessNs, __ATOMIC_RELAXED) / 1e3 / overruns : 0.0);
+  }
+}
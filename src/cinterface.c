@@ -3,22 +3,42 @@
  * File           : cinterface.c
  * Project        : Real Time Embedded Systems Coursework
  *
- * Description    :
+ * Description    : Simulated conveyor interface. Sensor readings come from
+ *                  random numbers, a block workload or are replayed from a
+ *                  recorded trace, and every reading can be recorded into a
+ *                  new trace. Lanes share no state, each has its own lock
+ *                  for callers that read its sensors from several tasks.
+ *                  Locks inherit priority and time how long tasks wait.
  * ****************************************************************************
  * ChangeLog:
  */
 
 
 /* SECTION Includes ---------------------------------------------------------*/
+// ppoll
+#define _GNU_SOURCE
+
 //Standard C Libraries
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 //Project Header Files
 #include "../inc/config.h"
 #include "../inc/cinterface.h"
+#include "../inc/rng.h"
+#include "../inc/trace.h"
+#include "../inc/workload.h"
 /* !SECTION Includes */
 
+/* Big blocks remembered on their way to the count sensor, power of 2 */
+#define CIF_BLOCK_RING 16
+
 
 /* SECTION Variable Declarations --------------------------------------------*/
 
@@ -28,21 +48,105 @@
 
 /* SECTION Local Variables --------------------------------------------------*/
 static int motor;
-static int gate;
-static int size[2];
-static int count[2];
+
+/* Held around sequences of calls that span lanes */
+static pthread_mutex_t deviceLock;
+static cLockWait_t deviceWait;
+
+/* Makes the locks priority inheritance mutexes before first use */
+static pthread_once_t locksOnce = PTHREAD_ONCE_INIT;
+
+/* Sensor and gate state for each lane, one cache line per lane */
+typedef struct
+{
+  int size;
+  int count;
+  int gate;
+
+  /* Held by a task reading the lane's sensors, see cLaneLock */
+  pthread_mutex_t lock;
+  cLockWait_t lockWait;
+
+  /* Random readings, each lane has its own generator, seeded with
+     DEFAULT_SEED if cSeed is never called */
+  rng_t rng;
+  int   seeded;
+
+  /* Replay position, size and count reads each walk the lane's samples */
+  const trace_sample_t *sizeNext;
+  const trace_sample_t *countNext;
+  const trace_sample_t *end;
+
+  /* Block put at the sensors by cPlaceBlock, read once */
+  int placed;
+
+  /* Signalled when a block is placed, -1 until cWaitSensor first runs */
+  int eventFd;
+
+  /* Workload blocks, the next block and big blocks heading for the count
+     sensor, times in seconds since the workload started */
+  wl_lane_t wl;
+  double wlTime;
+  int    wlSize;
+  int    wlEdge; /* sensor edges of the block already handed out */
+  double bigTime[CIF_BLOCK_RING];
+  unsigned bigHead;
+  unsigned bigTail;
+} __attribute__((aligned(CACHE_LINE))) cLane_t;
+
+static cLane_t lane[MAX_LANES] = {
+  [0 ... MAX_LANES - 1] = { .eventFd = -1 }
+};
+
+/* Size sensor value for each random number from gen_random */
+static const char randomSizes[10] = {
+  SIZE_BIG, SIZE_SMALL, SIZE_BIG, SIZE_SMALL, SIZE_BIG,
+  SIZE_SMALL, SIZE_BIG, SIZE_SMALL, SIZE_BIG, SIZE_NONE
+};
+
+/* Trace being replayed, sensors read random numbers when not replaying */
+static int replaying = FALSE;
+static trace_t replay;
+
+/* Trace being recorded */
+static int recording = FALSE;
+static trace_writer_t recorder;
+static uint64_t (*recordClock)(void);
+static struct timespec recordStart;
+
+/* Workload placing blocks in real time */
+static const workload_t *source;
+static struct timespec sourceStart;
 
 
 
 // Function Decleration
-int gen_random(void);
+int gen_random(int conv);
+static const trace_sample_t *replayNext(const trace_sample_t **next, const trace_sample_t *end, int valid);
+static uint64_t monotonicClock(void);
+static uint64_t elapsedUs(const struct timespec *since);
+static void workloadAdvance(int conv);
+static int  sensorProfile(int size, double age);
+static void workloadPassed(int conv);
+static int  workloadSize(int conv);
+static double workloadEdge(int conv, int *value, int take);
+static int  workloadCount(int conv);
+static void laneSeed(int conv);
+static int  laneEvents(int conv);
+static uint64_t monotonicUs(void);
+static uint64_t sourceStartUs(void);
+static void locksInit(void);
+static void lockTimed(pthread_mutex_t *mutex, cLockWait_t *wait);
 
 
 // Global functions
 
 /**
  * @brief simulates reading size sensors by using random numbers to decide which
- *        size of block is detected (if any)
+ *        size of block is detected (if any). A block placed by cPlaceBlock,
+ *        the running workload or the lane's next recorded sample when
+ *        replaying are used instead. Detected sizes are held until
+ *        resetSizeSensors is called.
  *
  * @param conveyor - Which conveyor to check, LEFT or RIGHT
  *
@@ -52,25 +156,46 @@ char readSizeSensors(char conveyor)
 {
   // Removes warning messages
   int conv = conveyor;
+  const trace_sample_t *sample;
+  int value = SIZE_NONE;
 
-  int randomInt = gen_random();
+  if (lane[conv].placed != SIZE_NONE)
+  {
+    value = __atomic_exchange_n(&lane[conv].placed, SIZE_NONE, __ATOMIC_ACQ_REL);
+  }
+  else if (source != NULL)
+  {
+    value = workloadSize(conv);
+  }
+  else if (replaying == TRUE)
+  {
+    sample = replayNext(&lane[conv].sizeNext, lane[conv].end, TRACE_SIZE);
+    if (sample != NULL)
+    {
+      value = sample->size;
+    }
+  }
+  else
+  {
+    value = randomSizes[gen_random(conv)];
+  }
 
-  // Big block detected
-  if ((randomInt <= 8) && (randomInt % 2 == 0))
+  if (recording == TRUE)
   {
-    size[conv] = SIZE_BIG;
+    traceWriterAdd(&recorder, conv, recordClock(), TRACE_SIZE, value, COUNT_NONE);
   }
-  // Small block detected
-  else if ((randomInt <= 8) && (randomInt % 2 != 0) )
+
+  if (value != SIZE_NONE)
   {
-    size[conv] = SIZE_SMALL;
+    lane[conv].size = value;
   }
 
-  return (size[conv]);
+  return (lane[conv].size);
 }
 
 /**
  * @brief simulates count sensor function, will always return COUNT_BLOCK
+ *        unless a trace is being replayed or a workload is running
  *
  * @param conveyor - Which conveyor to check
  * @return char - COUNT_BLOCK, COUNT_NONE
@@ -79,10 +204,26 @@ char readCountSensor(char conveyor)
 {
   // To remove warnings
   int conv = conveyor;
-  //int randomInt = gen_random();
-  count[conv] = COUNT_BLOCK;
-  // Left conveyor, big block
-  return(count[conv]);
+  const trace_sample_t *sample;
+  int value = COUNT_BLOCK;
+
+  if (source != NULL)
+  {
+    value = workloadCount(conv);
+  }
+  else if (replaying == TRUE)
+  {
+    sample = replayNext(&lane[conv].countNext, lane[conv].end, TRACE_COUNT);
+    value = (sample != NULL) ? sample->count : COUNT_NONE;
+  }
+
+  if (recording == TRUE)
+  {
+    traceWriterAdd(&recorder, conv, recordClock(), TRACE_COUNT, SIZE_NONE, value);
+  }
+
+  lane[conv].count = value;
+  return(lane[conv].count);
 
 }
 
@@ -96,7 +237,7 @@ void resetSizeSensors(char conveyor)
   // To remove warnings
   int conv = conveyor;
 
-  size[conv] = SIZE_NONE;
+  lane[conv].size = SIZE_NONE;
 }
 
 /**
@@ -109,7 +250,7 @@ void resetCountSensor(char conveyor)
   // To remove warnings
   int conv = conveyor;
 
-  count[conv] = COUNT_NONE;
+  lane[conv].count = COUNT_NONE;
 }
 
 /**
@@ -119,11 +260,23 @@ void resetCountSensor(char conveyor)
  */
 void setGates(char state)
 {
-  // To remove warnings
-  int stt = state;
+  __atomic_store_n(&lane[LEFT].gate, (state & GATE_CLOSED_L) ? GATE_CLOSED : GATE_OPEN, __ATOMIC_RELEASE);
+  __atomic_store_n(&lane[RIGHT].gate, (state & GATE_CLOSED_R) ? GATE_CLOSED : GATE_OPEN, __ATOMIC_RELEASE);
+}
 
-  gate = state;
+/**
+ * @brief Controls the gate of a single lane, gates on other lanes are left
+ *        as they are. Needs no lock, the gate is a single store.
+ *
+ * @param conveyor - lane of the gate
+ * @param state    - GATE_OPEN or GATE_CLOSED
+ */
+void setGate(char conveyor, char state)
+{
+  // To remove warnings
+  int conv = conveyor;
 
+  __atomic_store_n(&lane[conv].gate, state, __ATOMIC_RELEASE);
 }
 
 /**
@@ -132,7 +285,7 @@ void setGates(char state)
  */
 void startMotor(void)
 {
-  motor = MOTOR_ON;
+  __atomic_store_n(&motor, MOTOR_ON, __ATOMIC_RELEASE);
 }
 
 /**
@@ -141,21 +294,759 @@ void startMotor(void)
  */
 void stopMotor(void)
 {
-  motor = MOTOR_OFF;
+  __atomic_store_n(&motor, MOTOR_OFF, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Seeds the random sensor readings. Each lane gets its own sequence
+ *        derived from the seed, so the same seed repeats a run exactly.
+ *
+ * @param seed - any value
+ */
+void cSeed(uint64_t seed)
+{
+  int conv;
+
+  for (conv = 0; conv < MAX_LANES; conv++)
+  {
+    rngSeed(&lane[conv].rng, seed + conv);
+    lane[conv].seeded = TRUE;
+  }
+}
+
+/**
+ * @brief Takes a lane's lock. Calls on different lanes never share state, so
+ *        tasks on different lanes need no locking; tasks sharing a lane
+ *        (its size and count tasks) hold the lane's lock around each read
+ *        and reset. Gates and the motor are single stores and need no lock.
+ *
+ * @param conveyor - lane to lock
+ */
+void cLaneLock(char conveyor)
+{
+  int conv = conveyor;
+
+  lockTimed(&lane[conv].lock, &lane[conv].lockWait);
+}
+
+/**
+ * @brief Releases a lane's lock taken with cLaneLock
+ *
+ * @param conveyor - lane to unlock
+ */
+void cLaneUnlock(char conveyor)
+{
+  int conv = conveyor;
+
+  pthread_mutex_unlock(&lane[conv].lock);
+}
+
+/**
+ * @brief Takes the device lock, for sequences of calls that must not be
+ *        interleaved with other device wide changes (motor, setGates). Lane
+ *        locks may be taken while holding it, never the other way round.
+ *
+ */
+void cDeviceLock(void)
+{
+  lockTimed(&deviceLock, &deviceWait);
+}
+
+/**
+ * @brief Releases the device lock
+ *
+ */
+void cDeviceUnlock(void)
+{
+  pthread_mutex_unlock(&deviceLock);
+}
+
+/**
+ * @brief Reads how often tasks had to wait for a lock and for how long. The
+ *        locks inherit priority, so a wait on a lower priority owner lasts
+ *        only as long as its critical section.
+ *
+ * @param conveyor - lane of the lock, CIF_DEVICE_LOCK for the device lock
+ * @param wait     - filled with the lock's waits so far
+ */
+void cLockWaitGet(char conveyor, cLockWait_t *wait)
+{
+  int conv = conveyor;
+  pthread_mutex_t *mutex = (conv == CIF_DEVICE_LOCK) ? &deviceLock : &lane[conv].lock;
+
+  pthread_once(&locksOnce, locksInit);
+  pthread_mutex_lock(mutex);
+  *wait = (conv == CIF_DEVICE_LOCK) ? deviceWait : lane[conv].lockWait;
+  pthread_mutex_unlock(mutex);
+}
+
+/**
+ * @brief Reads a batch of size and count samples for a lane in one call.
+ *        Each sample is a raw reading, nothing is held between samples and
+ *        the lane's sensor state is left untouched. Random samples take four
+ *        readings from each 64 bit random number.
+ *
+ * @param conveyor - lane to read
+ * @param samples  - filled with the readings
+ * @param n        - number of samples wanted
+ * @return int - number of samples filled, less than n if a replayed trace
+ *               runs out
+ */
+int cReadSamples(char conveyor, cSample_t *samples, int n)
+{
+  int conv = conveyor;
+  const trace_sample_t *sample;
+  uint64_t bits = 0;
+  int i;
+
+  if (replaying == TRUE)
+  {
+    for (i = 0; i < n; i++)
+    {
+      sample = replayNext(&lane[conv].sizeNext, lane[conv].end, TRACE_SIZE);
+      if (sample == NULL)
+      {
+        break;
+      }
+      samples[i].size  = sample->size;
+      samples[i].count = (sample->valid & TRACE_COUNT) ? sample->count : COUNT_NONE;
+    }
+    n = i;
+  }
+  else
+  {
+    laneSeed(conv);
+    for (i = 0; i < n; i++)
+    {
+      if ((i & 3) == 0)
+      {
+        bits = rngNext(&lane[conv].rng);
+      }
+      // 16 bits scaled to 0-9
+      samples[i].size  = randomSizes[((bits & 0xffff) * 10) >> 16];
+      samples[i].count = COUNT_BLOCK;
+      bits >>= 16;
+    }
+  }
+
+  if (recording == TRUE)
+  {
+    uint64_t now = recordClock();
+    for (i = 0; i < n; i++)
+    {
+      traceWriterAdd(&recorder, conv, now, TRACE_SIZE | TRACE_COUNT, samples[i].size, samples[i].count);
+    }
+  }
+  return n;
+}
+
+/**
+ * @brief Starts serving sensor readings from a recorded trace. The trace is
+ *        mapped into memory, reads take samples straight from the mapping.
+ *        Lanes missing from the trace read as empty.
+ *
+ * @param path - trace file
+ * @return int - number of lanes in the trace, -1 if it could not be opened
+ */
+int cReplayStart(const char *path)
+{
+  const trace_sample_t *first;
+  uint64_t samples;
+  int conv;
+
+  cReplayStop();
+  if (traceOpen(&replay, path) != 0)
+  {
+    return -1;
+  }
+
+  for (conv = 0; conv < MAX_LANES; conv++)
+  {
+    first = traceSamples(&replay, conv, &samples);
+    lane[conv].sizeNext  = first;
+    lane[conv].countNext = first;
+    lane[conv].end       = first + samples;
+  }
+  replaying = TRUE;
+
+  return replay.header->lanes;
+}
+
+/**
+ * @brief Stops replaying, sensors go back to random readings
+ *
+ */
+void cReplayStop(void)
+{
+  int conv;
+
+  if (replaying == TRUE)
+  {
+    replaying = FALSE;
+    for (conv = 0; conv < MAX_LANES; conv++)
+    {
+      lane[conv].sizeNext  = NULL;
+      lane[conv].countNext = NULL;
+      lane[conv].end       = NULL;
+    }
+    traceClose(&replay);
+  }
+}
+
+/**
+ * @brief Time of the next block in the replayed trace, skipping empty size
+ *        samples. The next readSizeSensors call returns that block.
+ *
+ * @param conveyor - lane to check
+ * @return uint64_t - sample time in microseconds, CIF_NO_BLOCK when the lane
+ *                    has no more blocks or nothing is being replayed
+ */
+uint64_t cReplayNextBlock(char conveyor)
+{
+  int conv = conveyor;
+  const trace_sample_t *sample;
+
+  if (replaying == FALSE)
+  {
+    return CIF_NO_BLOCK;
+  }
+
+  while ((sample = replayNext(&lane[conv].sizeNext, lane[conv].end, TRACE_SIZE)) != NULL)
+  {
+    if (sample->size != SIZE_NONE)
+    {
+      // Leave it for readSizeSensors
+      lane[conv].sizeNext = sample;
+      return (uint64_t)sample->time * replay.header->tickUs;
+    }
+  }
+  return CIF_NO_BLOCK;
+}
+
+/**
+ * @brief Starts recording every sensor reading into a trace
+ *
+ * @param lanes - number of lanes to record
+ * @param clock - returns the time of a reading in microseconds, NULL to use
+ *                the time since recording started
+ * @return int - 0 on success, -1 if out of memory
+ */
+int cRecordStart(int lanes, uint64_t (*clock)(void))
+{
+  if (recording == TRUE || traceWriterInit(&recorder, lanes, TRACE_TICK_US) != 0)
+  {
+    return -1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &recordStart);
+  recordClock = (clock != NULL) ? clock : monotonicClock;
+  recording = TRUE;
+  return 0;
+}
+
+/**
+ * @brief Stops recording and writes the trace to a file
+ *
+ * @param path - file to write
+ * @return int - 0 on success, -1 if not recording or the file failed
+ */
+int cRecordSave(const char *path)
+{
+  int result;
+
+  if (recording == FALSE)
+  {
+    return -1;
+  }
+  recording = FALSE;
+
+  result = traceWriterSave(&recorder, path);
+  traceWriterFree(&recorder);
+  return result;
+}
+
+/**
+ * @brief Puts a block at a lane's size sensors, the next readSizeSensors call
+ *        returns it whatever the sensors would otherwise read, and a task
+ *        waiting in cWaitSensor is woken with it. Lets a simulator that
+ *        generates its own blocks drive the interface.
+ *
+ * @param conveyor - lane of the block
+ * @param size     - SIZE_SMALL or SIZE_BIG
+ */
+void cPlaceBlock(char conveyor, char size)
+{
+  int conv = conveyor;
+  uint64_t one = 1;
+  int fd;
+
+  __atomic_store_n(&lane[conv].placed, size, __ATOMIC_RELEASE);
+
+  fd = __atomic_load_n(&lane[conv].eventFd, __ATOMIC_ACQUIRE);
+  if (fd >= 0 && write(fd, &one, sizeof(one)) < 0)
+  {
+    // Counter is only full after 2^64 - 1 unread wakeups, nothing to do
+  }
+}
+
+/**
+ * @brief Waits for the size sensors of a lane to change, instead of polling
+ *        them. Edges come from the running workload, with the time they
+ *        happened, and from cPlaceBlock. A late caller still gets every edge,
+ *        in order. Takes the lane's lock itself, so must not be called with
+ *        it held.
+ *
+ * @param conveyor  - lane to wait on
+ * @param event     - filled with the sensor reading after the edge
+ * @param timeoutMs - longest wait in milliseconds, CIF_WAIT_FOREVER for no
+ *                    limit
+ * @return int - 1 for an event, 0 on timeout, -1 if the lane has no edge
+ *               events (random or replayed readings), poll it instead
+ */
+int cWaitSensor(char conveyor, cEvent_t *event, int timeoutMs)
+{
+  int conv = conveyor;
+  cLane_t *l = &lane[conv];
+  struct pollfd pfd;
+  struct timespec wait;
+  uint64_t start = monotonicUs();
+  uint64_t deadline = (timeoutMs < 0) ? CIF_NO_BLOCK : start + (uint64_t)timeoutMs * 1000;
+  uint64_t wake;
+  uint64_t now;
+  uint64_t count;
+  double edge;
+  int value;
+  int placed;
+
+  if (source == NULL && replaying == TRUE)
+  {
+    return -1;
+  }
+  if (laneEvents(conv) != 0)
+  {
+    return -1;
+  }
+  // Random readings have no edges to wait for unless blocks are placed
+  if (source == NULL && timeoutMs < 0 && l->placed == SIZE_NONE)
+  {
+    return -1;
+  }
+
+  while (1)
+  {
+    placed = __atomic_exchange_n(&l->placed, SIZE_NONE, __ATOMIC_ACQ_REL);
+    if (placed != SIZE_NONE)
+    {
+      event->size   = placed;
+      event->timeUs = monotonicUs();
+      if (recording == TRUE)
+      {
+        cLaneLock(conv);
+        traceWriterAdd(&recorder, conv, recordClock(), TRACE_SIZE, placed, COUNT_NONE);
+        cLaneUnlock(conv);
+      }
+      return 1;
+    }
+
+    now  = monotonicUs();
+    wake = deadline;
+    if (source != NULL)
+    {
+      cLaneLock(conv);
+      edge = workloadEdge(conv, &value, FALSE);
+      if (edge != HUGE_VAL)
+      {
+        wake = sourceStartUs() + (uint64_t)(edge * 1e6);
+        if (wake <= now)
+        {
+          workloadEdge(conv, &value, TRUE);
+          // Recorded under the lane lock, like readSizeSensor's readings
+          if (recording == TRUE)
+          {
+            traceWriterAdd(&recorder, conv, recordClock(), TRACE_SIZE, value, COUNT_NONE);
+          }
+          cLaneUnlock(conv);
+
+          event->size   = value;
+          event->timeUs = wake;
+          return 1;
+        }
+        wake = (wake < deadline) ? wake : deadline;
+      }
+      cLaneUnlock(conv);
+    }
+
+    if (now >= deadline)
+    {
+      return 0;
+    }
+
+    // Sleep until the next edge, a placed block or the timeout
+    pfd.fd     = l->eventFd;
+    pfd.events = POLLIN;
+    if (wake != CIF_NO_BLOCK)
+    {
+      wait.tv_sec  = (wake - now) / 1000000;
+      wait.tv_nsec = ((wake - now) % 1000000) * 1000;
+    }
+    if (ppoll(&pfd, 1, (wake != CIF_NO_BLOCK) ? &wait : NULL, NULL) > 0 &&
+        read(l->eventFd, &count, sizeof(count)) < 0)
+    {
+      // Another reader took the wakeup, the placed block is still checked
+    }
+  }
+}
+
+/**
+ * @brief Starts placing blocks from a workload in real time, size sensors
+ *        see a block for BLOCK_SENSOR_TIME after it arrives and the count
+ *        sensor sees big blocks COUNT_DELAY later. Small blocks are assumed
+ *        to be sorted off before the count sensor.
+ *
+ * @param wl   - workload, must stay valid until cWorkloadStop
+ * @param seed - seed for the lanes' block streams
+ */
+void cWorkloadStart(const workload_t *wl, uint64_t seed)
+{
+  int conv;
+
+  for (conv = 0; conv < MAX_LANES; conv++)
+  {
+    workloadLaneInit(wl, &lane[conv].wl, conv, seed);
+    lane[conv].bigHead = 0;
+    lane[conv].bigTail = 0;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &sourceStart);
+  source = wl;
+  for (conv = 0; conv < MAX_LANES; conv++)
+  {
+    workloadAdvance(conv);
+  }
+}
+
+/**
+ * @brief Stops placing workload blocks, sensors go back to random readings
+ *
+ */
+void cWorkloadStop(void)
+{
+  source = NULL;
 }
 
 // Local functions
 
 /**
- * @brief Generates a random number and returns it.
+ * @brief Moves a lane on to its next workload block
+ *
+ * @param conv - lane
+ */
+static void workloadAdvance(int conv)
+{
+  lane[conv].wlEdge = 0;
+  if (workloadNext(source, &lane[conv].wl, &lane[conv].wlTime, &lane[conv].wlSize) != 0)
+  {
+    lane[conv].wlTime = HUGE_VAL;
+    lane[conv].wlSize = SIZE_NONE;
+  }
+}
+
+/**
+ * @brief Size sensor reading a block gives, the first sensor sees any block
+ *        for the first half of BLOCK_SENSOR_TIME, then both sensors see a
+ *        big block for the second half
+ *
+ * @param size - SIZE_SMALL or SIZE_BIG
+ * @param age  - seconds since the block arrived
+ * @return int - size sensor reading
+ */
+static int sensorProfile(int size, double age)
+{
+  if (age < 0 || age >= BLOCK_SENSOR_TIME)
+  {
+    return SIZE_NONE;
+  }
+  if (age < BLOCK_SENSOR_TIME / 2)
+  {
+    return SIZE_SMALL;
+  }
+  return (size == SIZE_BIG) ? SIZE_BIG : SIZE_NONE;
+}
+
+/**
+ * @brief Moves a lane's block past the size sensors, big blocks head on to
+ *        the count sensor
+ *
+ * @param conv - lane
+ */
+static void workloadPassed(int conv)
+{
+  cLane_t *l = &lane[conv];
+
+  if (l->wlSize == SIZE_BIG)
+  {
+    // Full ring drops the oldest block
+    if (l->bigHead - l->bigTail == CIF_BLOCK_RING)
+    {
+      l->bigTail++;
+    }
+    l->bigTime[l->bigHead++ % CIF_BLOCK_RING] = l->wlTime;
+  }
+  workloadAdvance(conv);
+}
+
+/**
+ * @brief Size sensor reading from the workload. Blocks that pass between
+ *        reads are missed but still travel on to the count sensor.
+ *
+ * @param conv - lane
+ * @return int - SIZE_NONE, SIZE_SMALL or SIZE_BIG
+ */
+static int workloadSize(int conv)
+{
+  cLane_t *l = &lane[conv];
+  double now = elapsedUs(&sourceStart) / 1e6;
+
+  while (l->wlTime + BLOCK_SENSOR_TIME <= now)
+  {
+    workloadPassed(conv);
+  }
+  return sensorProfile(l->wlSize, now - l->wlTime);
+}
+
+/**
+ * @brief Next change of the size sensors from the workload, see
+ *        sensorProfile. Edges are handed out in order and each only once.
+ *
+ * @param conv  - lane
+ * @param value - set to the sensor reading after the edge
+ * @param take  - TRUE to move on past the edge
+ * @return double - seconds since the workload started, HUGE_VAL if the lane
+ *                  has no more blocks
+ */
+static double workloadEdge(int conv, int *value, int take)
+{
+  cLane_t *l = &lane[conv];
+  double time = l->wlTime + l->wlEdge * BLOCK_SENSOR_TIME / 2;
+
+  *value = sensorProfile(l->wlSize, time - l->wlTime);
+  if (take == TRUE)
+  {
+    // Small blocks leave at the second edge, big ones at the third
+    if (++l->wlEdge > ((l->wlSize == SIZE_BIG) ? 2 : 1))
+    {
+      workloadPassed(conv);
+    }
+  }
+  return time;
+}
+
+/**
+ * @brief Count sensor reading from the workload, finds a big block that has
+ *        reached the sensor and not yet passed it
+ *
+ * @param conv - lane
+ * @return int - COUNT_NONE or COUNT_BLOCK
+ */
+static int workloadCount(int conv)
+{
+  cLane_t *l = &lane[conv];
+  double now = elapsedUs(&sourceStart) / 1e6;
+  double reach;
+
+  while (l->bigTail != l->bigHead)
+  {
+    reach = l->bigTime[l->bigTail % CIF_BLOCK_RING] + COUNT_DELAY;
+    if (now < reach)
+    {
+      break;
+    }
+    l->bigTail++;
+    if (now < reach + BLOCK_SENSOR_TIME)
+    {
+      return COUNT_BLOCK;
+    }
+  }
+  return COUNT_NONE;
+}
+
+/**
+ * @brief Takes the next replay sample holding a reading of the given sensor
+ *
+ * @param next  - lane's cursor for the sensor, moved past the sample
+ * @param end   - end of the lane's samples
+ * @param valid - TRACE_SIZE or TRACE_COUNT
+ * @return const trace_sample_t* - sample, NULL when the lane has run out
+ */
+static const trace_sample_t *replayNext(const trace_sample_t **next, const trace_sample_t *end, int valid)
+{
+  const trace_sample_t *sample = *next;
+
+  while (sample < end && (sample->valid & valid) == 0)
+  {
+    sample++;
+  }
+  if (sample >= end)
+  {
+    *next = end;
+    return NULL;
+  }
+  *next = sample + 1;
+  return sample;
+}
+
+/**
+ * @brief Default recording clock, microseconds since recording started
  *
- * @return int random number from 0-10
+ */
+static uint64_t monotonicClock(void)
+{
+  return elapsedUs(&recordStart);
+}
+
+/**
+ * @brief Microseconds of CLOCK_MONOTONIC since a start time
  *
+ * @param since - start time
  */
-int gen_random(void)
+static uint64_t elapsedUs(const struct timespec *since)
 {
-  // Calculate random number from 0-10
-  int input = rand() % 10;
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)(now.tv_sec - since->tv_sec) * 1000000 +
+         (now.tv_nsec - since->tv_nsec) / 1000;
+}
+
+/**
+ * @brief Creates a lane's event counter the first time it is waited on
+ *
+ * @param conv - lane
+ * @return int - 0 on success, -1 if the eventfd could not be created
+ */
+static int laneEvents(int conv)
+{
+  int fd;
+  int unset = -1;
+
+  if (__atomic_load_n(&lane[conv].eventFd, __ATOMIC_ACQUIRE) >= 0)
+  {
+    return 0;
+  }
+  fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  // Two first waiters can race here, the loser's counter is closed
+  if (!__atomic_compare_exchange_n(&lane[conv].eventFd, &unset, fd, FALSE,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+  {
+    close(fd);
+  }
+  return 0;
+}
+
+/**
+ * @brief CLOCK_MONOTONIC in microseconds, the clock of sensor events
+ *
+ */
+static uint64_t monotonicUs(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * @brief Makes the device and lane locks priority inheritance mutexes, so a
+ *        low priority task holding one runs at the priority of its waiter
+ *
+ */
+static void locksInit(void)
+{
+  pthread_mutexattr_t attr;
+  int conv;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+  pthread_mutex_init(&deviceLock, &attr);
+  for (conv = 0; conv < MAX_LANES; conv++)
+  {
+    pthread_mutex_init(&lane[conv].lock, &attr);
+  }
+  pthread_mutexattr_destroy(&attr);
+}
+
+/**
+ * @brief Takes a lock, timing the wait if another task holds it. The wait is
+ *        added up under the lock just taken, so needs no atomics.
+ *
+ * @param mutex - lock to take
+ * @param wait  - the lock's waits
+ */
+static void lockTimed(pthread_mutex_t *mutex, cLockWait_t *wait)
+{
+  struct timespec start;
+  struct timespec now;
+  uint64_t waitNs;
+
+  pthread_once(&locksOnce, locksInit);
+  if (pthread_mutex_trylock(mutex) == 0)
+  {
+    return;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pthread_mutex_lock(mutex);
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  waitNs = (uint64_t)(now.tv_sec - start.tv_sec) * 1000000000 + (now.tv_nsec - start.tv_nsec);
+  wait->count++;
+  wait->totalNs += waitNs;
+  if (waitNs > wait->maxNs)
+  {
+    wait->maxNs = waitNs;
+  }
+}
+
+/**
+ * @brief Time the workload started, in monotonicUs time
+ *
+ */
+static uint64_t sourceStartUs(void)
+{
+  return (uint64_t)sourceStart.tv_sec * 1000000 + sourceStart.tv_nsec / 1000;
+}
+
+/**
+ * @brief Seeds a lane's generator as cSeed(DEFAULT_SEED) would, if nothing
+ *        has seeded it yet. An all zero generator only ever returns zero.
+ *
+ * @param conv - lane to seed
+ */
+static void laneSeed(int conv)
+{
+  if (lane[conv].seeded == FALSE)
+  {
+    rngSeed(&lane[conv].rng, DEFAULT_SEED + conv);
+    lane[conv].seeded = TRUE;
+  }
+}
+
+/**
+ * @brief Generates a random number from the lane's own generator, lanes
+ *        never share a generator so no locking is needed.
+ *
+ * @param conv - lane to generate for
+ * @return int random number from 0-9
+ *
+ */
+int gen_random(int conv)
+{
+  laneSeed(conv);
+
+  // Calculate random number from 0-9
+  int input = rngBelow(&lane[conv].rng, 10);
   //debug_printf("%d", input);
 
   return(input);
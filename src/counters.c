@@ -0,0 +1,146 @@
+/*
+ * ****************************************************************************
+ * File           : counters.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Snapshots of the lane counters, see counters.h. Counters
+ *                  only ever go up, so two passes over every slot that read
+ *                  the same values saw them all at a single instant. Readers
+ *                  pass again until two agree, so a snapshot never straddles
+ *                  a count, and are serialised among themselves. Writers
+ *                  never wait.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <pthread.h>
+#include <string.h>
+
+//Project Header Files
+#include "../inc/config.h"
+#include "../inc/counters.h"
+#include "../inc/lanes.h"
+/* !SECTION Includes */
+
+/* SECTION Local Variables --------------------------------------------------*/
+/* Serialises readers, they share the baselines */
+static pthread_mutex_t readLock = PTHREAD_MUTEX_INITIALIZER;
+/* !SECTION Local Variables */
+
+// Function Decleration
+static void countersCollect(counter_snap_t *raw);
+static void countersSnapshot(counter_snap_t *raw);
+
+
+// Global functions
+
+/**
+ * @brief Reads every lane's counters at once
+ *
+ * @param snap - numLanes entries, filled with the counts since the last reset
+ */
+void countersRead(counter_snap_t *snap)
+{
+  int lane;
+  int id;
+
+  pthread_mutex_lock(&readLock);
+  countersSnapshot(snap);
+  for (lane = 0; lane < numLanes; lane++)
+  {
+    for (id = 0; id < NUM_COUNTERS; id++)
+    {
+      snap[lane].value[id] -= lanes[lane].counters.base[id];
+    }
+  }
+  pthread_mutex_unlock(&readLock);
+}
+
+/**
+ * @brief Reads every lane's counters at once and resets the selected ones
+ *        at that same instant, so no count is lost or reported twice
+ *
+ * @param snap - numLanes entries, filled with the counts since the last
+ *               reset, the values being cleared for the selected counters
+ * @param lane - lane to reset, -1 for every lane
+ * @param mask - counters to reset, bit (1 << CounterId), CTR_ALL for all
+ */
+void countersReadReset(counter_snap_t *snap, int lane, unsigned mask)
+{
+  counters_t *counters;
+  uint64_t raw;
+  int side;
+  int id;
+
+  pthread_mutex_lock(&readLock);
+  countersSnapshot(snap);
+  for (side = 0; side < numLanes; side++)
+  {
+    counters = &lanes[side].counters;
+    for (id = 0; id < NUM_COUNTERS; id++)
+    {
+      raw = snap[side].value[id];
+      snap[side].value[id] = raw - counters->base[id];
+      if ((lane < 0 || lane == side) && (mask & (1u << id)))
+      {
+        counters->base[id] = raw;
+      }
+    }
+  }
+  pthread_mutex_unlock(&readLock);
+}
+
+
+// Local functions
+
+/**
+ * @brief One pass over every slot, adding up each lane's writers
+ *
+ * @param raw - numLanes entries, filled with the raw totals
+ */
+static void countersCollect(counter_snap_t *raw)
+{
+  const counters_t *counters;
+  int lane;
+  int writer;
+  int id;
+
+  for (lane = 0; lane < numLanes; lane++)
+  {
+    counters = &lanes[lane].counters;
+    for (id = 0; id < NUM_COUNTERS; id++)
+    {
+      raw[lane].value[id] = 0;
+      for (writer = 0; writer < NUM_CTR_WRITERS; writer++)
+      {
+        raw[lane].value[id] += __atomic_load_n(&counters->slot[writer].value[id], __ATOMIC_ACQUIRE);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Collects until two passes agree. Each counter held its value from
+ *        its read in the first pass to its read in the second, so they all
+ *        held them between the passes. Blocks are counted a few a second
+ *        and a pass takes well under a microsecond, so a retry is rare.
+ *
+ * @param raw - numLanes entries, filled with the raw totals
+ */
+static void countersSnapshot(counter_snap_t *raw)
+{
+  counter_snap_t check[MAX_LANES];
+
+  countersCollect(raw);
+  for (;;)
+  {
+    countersCollect(check);
+    if (memcmp(check, raw, numLanes * sizeof(counter_snap_t)) == 0)
+    {
+      break;
+    }
+    memcpy(raw, check, numLanes * sizeof(counter_snap_t));
+  }
+}
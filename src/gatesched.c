@@ -0,0 +1,120 @@
+/*
+ * ****************************************************************************
+ * File           : gatesched.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Per-gate deadline queue, see gatesched.h. Windows are
+ *                  added at the tail and served from the head, by the gate
+ *                  task alone so nothing needs locking.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <string.h>
+
+//Project Header Files
+#include "../inc/config.h"
+#include "../inc/gatesched.h"
+/* !SECTION Includes */
+
+
+// Global functions
+
+/**
+ * @brief Sets up an empty gate queue
+ *
+ * @param gate - queue to initialise
+ */
+void gateSchedInit(gate_sched_t *gate)
+{
+  memset(gate, 0, sizeof(*gate));
+}
+
+/**
+ * @brief Asks for the gate to be closed from close until open. A window
+ *        starting before the last one ends extends it instead of queueing,
+ *        so consecutive small blocks keep the gate closed in one go.
+ *
+ * @param gate  - gate's queue
+ * @param close - tick to close the gate
+ * @param open  - tick to open it again
+ * @return int - 0 if queued, 1 if merged into the last window, -1 if the
+ *               queue is full
+ */
+int gateSchedAdd(gate_sched_t *gate, tw_tick_t close, tw_tick_t open)
+{
+  gate_window_t *last;
+  int result;
+
+  last = &gate->window[(gate->tail - 1) % GATE_WINDOWS];
+
+  if (gate->tail != gate->head && close <= last->open)
+  {
+    if (open > last->open)
+    {
+      last->open = open;
+    }
+    gate->merged++;
+    result = 1;
+  }
+  else if (gate->tail - gate->head == GATE_WINDOWS)
+  {
+    gate->dropped++;
+    result = -1;
+  }
+  else
+  {
+    gate->window[gate->tail++ % GATE_WINDOWS] = (gate_window_t){close, open};
+    result = 0;
+  }
+  return result;
+}
+
+/**
+ * @brief Oldest window still to be served. Its open time may still be
+ *        pushed back by merges, gateSchedRelease has the final say.
+ *
+ * @param gate   - gate's queue
+ * @param window - filled with the window
+ * @return int - 0 on success, -1 if the queue is empty
+ */
+int gateSchedPeek(gate_sched_t *gate, gate_window_t *window)
+{
+  if (gate->tail == gate->head)
+  {
+    return -1;
+  }
+  *window = gate->window[gate->head % GATE_WINDOWS];
+  return 0;
+}
+
+/**
+ * @brief Retires the oldest window if it is over. Add any blocks waiting
+ *        for the gate first, so they can still merge into it.
+ *
+ * @param gate - gate's queue
+ * @param now  - current tick
+ * @return tw_tick_t - 0 if the window was retired and the gate can open,
+ *                     otherwise ticks until it ends
+ */
+tw_tick_t gateSchedRelease(gate_sched_t *gate, tw_tick_t now)
+{
+  gate_window_t *window;
+  tw_tick_t remaining = 0;
+
+  if (gate->tail != gate->head)
+  {
+    window = &gate->window[gate->head % GATE_WINDOWS];
+    if (window->open > now)
+    {
+      remaining = window->open - now;
+    }
+    else
+    {
+      gate->head++;
+    }
+  }
+  return remaining;
+}
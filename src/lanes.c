@@ -0,0 +1,100 @@
+/*
+ * ****************************************************************************
+ * File           : lanes.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Allocates and names the conveyor lanes, the number of
+ *                  lanes is chosen at startup
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Project Header Files
+#include "../inc/config.h"
+#include "../inc/lanes.h"
+/* !SECTION Includes */
+
+/* SECTION Global Variables -------------------------------------------------*/
+int numLanes = 0;
+lane_t *lanes = NULL;
+
+/* Names of the two original conveyors, index with LEFT or RIGHT */
+const char sideString[2][6] = {{"Right"}, {"Left"}};
+/* !SECTION Global Variables */
+
+/* SECTION Local Variables --------------------------------------------------*/
+static char laneNames[MAX_LANES][LANE_NAME_LENGTH];
+/* !SECTION Local Variables */
+
+
+// Global functions
+
+/**
+ * @brief Allocates cache line aligned state for count lanes
+ *
+ * @param count - number of lanes, 1 to MAX_LANES
+ * @return int - 0 on success, -1 on bad count or no memory
+ */
+int lanesInit(int count)
+{
+  int lane;
+
+  if (count < 1 || count > MAX_LANES)
+  {
+    return -1;
+  }
+
+  lanes = aligned_alloc(CACHE_LINE, count * sizeof(lane_t));
+  if (lanes == NULL)
+  {
+    return -1;
+  }
+  memset(lanes, 0, count * sizeof(lane_t));
+  numLanes = count;
+
+  // First two lanes keep the names of the original conveyors
+  for (lane = 0; lane < count; lane++)
+  {
+    if (lane == RIGHT || lane == LEFT)
+    {
+      snprintf(laneNames[lane], LANE_NAME_LENGTH, "%s", sideString[lane]);
+    }
+    else
+    {
+      snprintf(laneNames[lane], LANE_NAME_LENGTH, "Lane %d", lane + 1);
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Frees the lane state allocated by lanesInit
+ *
+ */
+void lanesFree(void)
+{
+  free(lanes);
+  lanes = NULL;
+  numLanes = 0;
+}
+
+/**
+ * @brief Name of a lane for printing
+ *
+ * @param lane - lane index
+ * @return const char* - "Right", "Left", "Lane 3", ...
+ */
+const char *laneName(int lane)
+{
+  if (lane < 0 || lane >= MAX_LANES)
+  {
+    return "Unknown";
+  }
+  return laneNames[lane];
+}
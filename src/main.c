@@ -23,20 +23,21 @@
 // Project files
 #include "../inc/config.h"
 #include "../inc/cinterface.h"
+#include "../inc/counters.h"
+#include "../inc/lanes.h"
+#include "../inc/rma.h"
+#include "../inc/script.h"
+#include "../inc/sim.h"
+#include "../inc/sweep.h"
 #include "../inc/ui.h"
+#include "../inc/workers.h"
+#include "../inc/workload.h"
 
 int shutdown = FALSE;
 int debug = FALSE;
 
-const char sideString[2][6] = {{"Right"}, {"Left"}};
-const char gateString[4][15] = {{"Both open"}, {"Left closed"}, {"Right closed"}, {"Both closed"}};
-
-// Structure used to hold counter values for both conveyors
-
 SEM_ID test;
 
-counter_t counters;
-
 menu_t menuLevel;
 
 enum Tasks
@@ -48,16 +49,70 @@ enum Tasks
   R_COUNT_TASK,
   GATE_TASK,
   NUM_TASKS
-}
+};
+
+// Simulated plant, runs in virtual time between UI inputs. Lanes are split
+// into shards, each shard is run by one worker at a time
+typedef struct
+{
+  sim_t sim;
+} __attribute__((aligned(CACHE_LINE))) shard_t;
+
+static shard_t *shards;
+static int numShards;
+
+// Shard being run by this thread, gives recorded sensor reads their time
+static __thread const sim_t *runningShard;
+
+// Trace file given on the command line to replay or record
+static const char *replayFile;
+static const char *recordFile;
+
+// Workload given on the command line, each lane draws its blocks from it
+static workload_t workload;
+static int useWorkload = FALSE;
+static uint64_t runSeed = DEFAULT_SEED;
+
+typedef struct
+{
+  wl_lane_t stream;
+  int size;         /* size of the lane's next block */
+} __attribute__((aligned(CACHE_LINE))) block_source_t;
+
+static block_source_t *blockSources;
 
 
 // Task function
 void conveyor_sim(void);
+static void conveyor_run(sim_time_t duration);
 int task_ui(void);
 int task_size(int side);
 void task_count(int side);
-void task_gate(int side);
+void task_gate(int side, int closed);
+
+// Simulator callbacks
+static sim_time_t sim_arrival(void *arg, int lane, sim_time_t now);
+static sim_time_t sim_block(void *arg, int lane, sim_time_t now);
+static int sim_detect(void *arg, int lane);
+static int sim_place(void *arg, int lane);
+static void sim_collect(void *arg, int lane);
+static void sim_gate(void *arg, int lane, int closed);
+static uint64_t sim_clock(void);
+
+// Blocks arrive every SIM_ARRIVAL_GAP, when the replayed trace has them or
+// when the workload places them
+static const sim_ops_t plantOps    = {NULL, sim_detect, sim_collect, sim_gate};
+static const sim_ops_t replayOps   = {sim_arrival, sim_detect, sim_collect, sim_gate};
+static const sim_ops_t workloadOps = {sim_block, sim_place, sim_collect, sim_gate};
+
+static void run_shard(void *arg, int shard);
+static void usage(const char *prog);
 
+// Headless mode
+static int  run_headless(double duration, uint64_t blockLimit, const script_t *script);
+static void headless_command(const script_cmd_t *cmd, sim_time_t now);
+static void headless_summary(sim_time_t now, double wall);
+static void plant_stats(sim_stats_t *total, int *idle);
 
 
 void debug_printf(char *dbgMessage, ...);
@@ -67,32 +122,202 @@ void debug_printf(char *dbgMessage, ...);
 /**
  * @brief main function for user interface simulation
  *
+ * Options:
+ *   -l lanes    number of conveyor lanes (default DEFAULT_LANES)
+ *   -w workers  number of threads driving the lanes (default one per CPU)
+ *   -r trace    replay sensor readings from a recorded trace
+ *   -R trace    record sensor readings to a trace, written on shutdown
+ *   -s seed     seed for the simulated sensors (default DEFAULT_SEED)
+ *   -S spec     run the parameter sweep in spec and print CSV results
+ *   -W workload generate blocks from a workload, e.g. "poisson,gap=0.5"
+ *   -d seconds  run headless for a virtual duration
+ *   -b blocks   run headless until a number of blocks have been placed
+ *   -c script   run headless, applying the counter commands in script
+ *   -a          check the controller's tasks can meet their deadlines with
+ *               this many lanes, print the priorities and exit. Uses the
+ *               estimated execution times in config.h, nothing is measured
+ *
+ * Headless runs never read stdin (unless the script is "-") and print JSON
+ * lines, one per counter command and a summary at the end.
  */
-int main(void)
+int main(int argc, char *argv[])
 {
 
-  time_t t;
+  int opt;
+  uint64_t seed = DEFAULT_SEED;
+  const char *sweepFile = NULL;
+  sweep_spec_t sweep;
+  int result;
+  int laneCount = DEFAULT_LANES;
+  int workerCount = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *workloadSpec = NULL;
+  const char *scriptFile = NULL;
+  double duration = 0;
+  uint64_t blockLimit = 0;
+  int headless = FALSE;
+  script_t script;
+  int analyse = FALSE;
+  rma_task_t tasks[RMA_TASKS(MAX_LANES)];
+
+  while ((opt = getopt(argc, argv, "l:w:r:R:s:S:W:d:b:c:a")) != -1)
+  {
+    switch (opt)
+    {
+    case 'l':
+      laneCount = atoi(optarg);
+      break;
+    case 'w':
+      workerCount = atoi(optarg);
+      break;
+    case 'r':
+      replayFile = optarg;
+      break;
+    case 'R':
+      recordFile = optarg;
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 0);
+      break;
+    case 'S':
+      sweepFile = optarg;
+      break;
+    case 'W':
+      workloadSpec = optarg;
+      break;
+    case 'd':
+      duration = atof(optarg);
+      headless = TRUE;
+      break;
+    case 'b':
+      blockLimit = strtoull(optarg, NULL, 0);
+      headless = TRUE;
+      break;
+    case 'c':
+      scriptFile = optarg;
+      headless = TRUE;
+      break;
+    case 'a':
+      analyse = TRUE;
+      break;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (lanesInit(laneCount) != 0)
+  {
+    printf("Lanes must be between 1 and %d\n", MAX_LANES);
+    return EXIT_FAILURE;
+  }
 
-  //Initializes random number generator
-  //Moved here as kept getting the same number generated
-  srand((unsigned) time(&t));
+  // Schedulability of the controller with this many lanes, nothing is run
+  if (analyse == TRUE)
+  {
+    result = rmaAnalyse(tasks, rmaControllerTasks(tasks, numLanes, CLOCK_RATE));
+    rmaPrint(stdout, tasks, RMA_TASKS(numLanes));
+    printf("%d lanes %s\n", numLanes, (result == 0) ? "schedulable" : "NOT schedulable");
+    return (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
+  if (workersStart(workerCount) != 0)
+  {
+    printf("Could only start %d worker threads\n", workersCount());
+  }
+
+  // Batch sweep runs its own plants and exits without the UI
+  if (sweepFile != NULL)
+  {
+    if (sweepLoad(&sweep, sweepFile) != 0)
+    {
+      printf("Could not load sweep %s\n", sweepFile);
+      workersStop();
+      return EXIT_FAILURE;
+    }
+    result = sweepRun(&sweep, stdout);
+    sweepFree(&sweep);
+    workersStop();
+    return (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
-  printf("Conveyor belt UI starting\n");
+  if (workloadSpec != NULL)
+  {
+    if (workloadParse(&workload, workloadSpec) != 0)
+    {
+      printf("Invalid workload %s\n", workloadSpec);
+      return EXIT_FAILURE;
+    }
+    useWorkload = TRUE;
+  }
 
+  if (replayFile != NULL && cReplayStart(replayFile) < 0)
+  {
+    printf("Could not replay trace %s\n", replayFile);
+    return EXIT_FAILURE;
+  }
+  if (recordFile != NULL && cRecordStart(numLanes, sim_clock) != 0)
+  {
+    printf("Could not record trace\n");
+    return EXIT_FAILURE;
+  }
 
-  //Default to top level menu
-  conveyor_sim();
+  //Seed the simulated sensors, the same seed repeats a run exactly
+  cSeed(seed);
+  runSeed = seed;
 
-  while (shutdown == FALSE)
+  if (headless == TRUE)
+  {
+    scriptInit(&script);
+    if (scriptFile != NULL && scriptLoad(&script, scriptFile) != 0)
+    {
+      printf("Could not load script %s\n", scriptFile);
+      return EXIT_FAILURE;
+    }
+    // A script alone runs until its last command
+    if (duration <= 0 && blockLimit == 0 && script.count > 0)
+    {
+      duration = script.cmd[script.count - 1].time;
+    }
+    if (duration <= 0 && blockLimit == 0)
+    {
+      printf("Headless runs need a duration, block count or script\n");
+      return EXIT_FAILURE;
+    }
+
+    shutdown = (run_headless(duration, blockLimit, &script) == 0) ? TRUE : -1;
+    scriptFree(&script);
+  }
+  else
   {
+    printf("Conveyor belt UI starting, %d lanes on %d workers, seed %llu\n",
+           numLanes, workersCount(), (unsigned long long)seed);
+
+
+    //Default to top level menu
+    conveyor_sim();
 
-    if(task_ui() == TRUE)
+    while (shutdown == FALSE)
     {
-      conveyor_sim();
+
+      if(task_ui() == TRUE)
+      {
+        conveyor_sim();
+      }
     }
   }
 
+  workersStop();
+
+  if (recordFile != NULL && cRecordSave(recordFile) != 0)
+  {
+    printf("Could not write trace %s\n", recordFile);
+  }
+  cReplayStop();
+  if (useWorkload == TRUE)
+  {
+    workloadFree(&workload);
+  }
+
   if(shutdown == TRUE)
   {
     return EXIT_SUCCESS;
@@ -119,52 +344,404 @@ void debug_printf(char *dbgMessage, ...)
     va_start(Args, dbgMessage);
 
     vprintf(dbgMessage, Args);
+    va_end(Args);
   }
 }
 
+/**
+ * @brief prints command line options
+ *
+ * @param prog - name of the executable
+ */
+static void usage(const char *prog)
+{
+  printf("Usage: %s [-l lanes] [-w workers] [-r trace] [-R trace] [-s seed] [-S spec] [-W workload]\n"
+         "       [-d seconds] [-b blocks] [-c script] [-a]\n", prog);
+  printf("  -l lanes    number of conveyor lanes, 1-%d (default %d)\n", MAX_LANES, DEFAULT_LANES);
+  printf("  -w workers  threads driving the lanes (default one per CPU)\n");
+  printf("  -r trace    replay sensor readings from a trace\n");
+  printf("  -R trace    record sensor readings to a trace\n");
+  printf("  -s seed     seed for the simulated sensors (default %d)\n", DEFAULT_SEED);
+  printf("  -S spec     run a parameter sweep and print CSV results\n");
+  printf("  -W workload generate blocks, kind[,key=value...] where kind is fixed,\n");
+  printf("              poisson, bursty or trace and keys are gap, mingap, small,\n");
+  printf("              empty, burst, burstgap and file\n");
+  printf("  -d seconds  run headless for a virtual duration\n");
+  printf("  -b blocks   run headless until a number of blocks have been placed\n");
+  printf("  -c script   run headless with counter commands, one per line:\n");
+  printf("              <seconds> read|reset [small|big|collected|all] [lane|all]\n");
+  printf("  -a          check the controller meets its deadlines with -l lanes,\n");
+  printf("              using estimated, not measured, execution times\n");
+}
+
 
 /**
- * @brief simulates conveyor belt interface, uses random numbers to decide
+ * @brief simulates the conveyor belt for SIM_RUN_TIME seconds of virtual
+ *        time, continuing from where the last call stopped.
  *
  */
 void conveyor_sim (void)
 {
-  int size;
-  int side = LEFT;
-  int numBlocks = 10;
-  // Allow up to ten blocks to be placed on conveyor
-  for (int i = 0; i < numBlocks; i++)
+  conveyor_run(SIM_SECONDS(SIM_RUN_TIME));
+}
+
+/**
+ * @brief simulates the conveyor belt for a period of virtual time,
+ *        continuing from where the last call stopped. Block sizes come
+ *        from the size sensors, gate and count timing from config.h.
+ *        Lanes never interact, so each shard of lanes runs on its own worker.
+ *
+ * @param duration - virtual time to run for
+ */
+static void conveyor_run(sim_time_t duration)
+{
+  static int started = FALSE;
+  sim_params_t params;
+  const sim_ops_t *ops = &plantOps;
+  int shard;
+  int lane;
+
+  if (started == FALSE)
   {
-    size = 0;
-    //If odd block is on left conveyor
-    side = LEFT;
+    numShards = workersCount();
+    if (numShards > numLanes)
+    {
+      numShards = numLanes;
+    }
+
+    shards = aligned_alloc(CACHE_LINE, numShards * sizeof(shard_t));
+    if (shards == NULL)
+    {
+      printf("Failed to start conveyor simulation\n");
+      shutdown = TRUE;
+      return;
+    }
 
-    //If even block is on RIGHT conveyor
-    if(i % 2 == 0)
+    if (useWorkload == TRUE)
     {
-      side = RIGHT;
+      blockSources = aligned_alloc(CACHE_LINE, numLanes * sizeof(block_source_t));
+      if (blockSources == NULL)
+      {
+        printf("Failed to start conveyor simulation\n");
+        shutdown = TRUE;
+        return;
+      }
+      for (lane = 0; lane < numLanes; lane++)
+      {
+        workloadLaneInit(&workload, &blockSources[lane].stream, lane, runSeed);
+      }
+      ops = &workloadOps;
+    }
+    else if (replayFile != NULL)
+    {
+      ops = &replayOps;
+    }
+
+    simDefaultParams(&params);
+    params.plantLanes = numLanes;
+    for (shard = 0; shard < numShards; shard++)
+    {
+      params.firstLane = (shard * numLanes) / numShards;
+      params.lanes = ((shard + 1) * numLanes) / numShards - params.firstLane;
+
+      if (simInit(&shards[shard].sim, &params, ops, NULL) != 0)
+      {
+        printf("Failed to start conveyor simulation\n");
+        shutdown = TRUE;
+        return;
+      }
     }
+    started = TRUE;
+  }
 
-    //Detect the size of the block
-    size = task_size(side);
+  workersRun(run_shard, &duration, numShards);
+}
 
-    //Process block according to size
-    if(size == SIZE_BIG)
+/**
+ * @brief runs the plant unattended, applying script commands at their
+ *        virtual times, until the duration has passed, the block limit is
+ *        reached or every lane has run out of blocks. The block limit is
+ *        checked every HEADLESS_STEP, so a run can overshoot it slightly.
+ *
+ * @param duration   - virtual seconds to run for, 0 for no limit
+ * @param blockLimit - blocks to place, 0 for no limit
+ * @param script     - counter commands
+ * @return int - 0 on success, -1 if the plant could not be started
+ */
+static int run_headless(double duration, uint64_t blockLimit, const script_t *script)
+{
+  sim_time_t end = (duration > 0) ? SIM_SECONDS(duration) : SIM_NEVER;
+  sim_time_t step = SIM_SECONDS(HEADLESS_STEP);
+  sim_time_t now = 0;
+  sim_time_t stop;
+  sim_time_t due;
+  sim_stats_t total;
+  struct timespec start;
+  struct timespec finish;
+  int next = 0;
+  int idle;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (shutdown == FALSE)
+  {
+    stop = end;
+    if (next < script->count)
     {
-      //Wait for block to reach count sensor
-      //sleep(COUNT_DELAY);
-      //Count collected block
-      task_count(side);
+      due = SIM_SECONDS(script->cmd[next].time);
+      stop = (due < stop) ? due : stop;
     }
-    else if( size == SIZE_SMALL)
+    if (blockLimit > 0 && now + step < stop)
+    {
+      stop = now + step;
+    }
+
+    conveyor_run(stop - now);
+    now = stop;
+
+    while (next < script->count && SIM_SECONDS(script->cmd[next].time) <= now)
     {
-      //Wait for block to reach gate
-      //sleep(GATE_DELAY);
-      //Close the gate for a period then open again
-      task_gate(side);
+      headless_command(&script->cmd[next++], now);
+    }
+
+    plant_stats(&total, &idle);
+    if (now >= end || (blockLimit > 0 && total.blocks >= blockLimit) ||
+        (idle == TRUE && next >= script->count))
+    {
+      break;
     }
-    //sleep(2);
   }
+
+  if (shutdown != FALSE)
+  {
+    return -1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  headless_summary(now, (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1e9);
+  return 0;
+}
+
+/**
+ * @brief applies one script command, reads print the lane counters
+ *
+ * @param cmd - command to apply
+ * @param now - virtual time it was applied at
+ */
+static void headless_command(const script_cmd_t *cmd, sim_time_t now)
+{
+  counter_snap_t snap[MAX_LANES];
+  const counter_snap_t *counter;
+  unsigned mask = (cmd->ctr == ALL) ? CTR_ALL : 1u << (cmd->ctr - SMALL);
+  int side;
+
+  // Resets report the values they cleared
+  if (cmd->action == SCRIPT_RESET)
+  {
+    countersReadReset(snap, cmd->lane, mask);
+  }
+  else
+  {
+    countersRead(snap);
+  }
+
+  for (side = 0; side < numLanes; side++)
+  {
+    if (cmd->lane != SCRIPT_ALL_LANES && cmd->lane != side)
+    {
+      continue;
+    }
+    counter = &snap[side];
+
+    printf("{\"event\":\"%s\",\"time\":%.6f,\"lane\":%d",
+           (cmd->action == SCRIPT_READ) ? "read" : "reset", (double)now / SIM_US_PER_SEC, side + 1);
+    if (cmd->ctr == SMALL || cmd->ctr == ALL)
+    {
+      printf(",\"small\":%llu", (unsigned long long)counter->value[CTR_SMALL]);
+    }
+    if (cmd->ctr == BIG || cmd->ctr == ALL)
+    {
+      printf(",\"big\":%llu", (unsigned long long)counter->value[CTR_BIG]);
+    }
+    if (cmd->ctr == COLLECTED || cmd->ctr == ALL)
+    {
+      printf(",\"collected\":%llu", (unsigned long long)counter->value[CTR_COLLECTED]);
+    }
+    printf("}\n");
+  }
+}
+
+/**
+ * @brief prints the end of run summary as a single JSON line, plant totals
+ *        followed by each lane's counters
+ *
+ * @param now  - virtual time the run stopped at
+ * @param wall - seconds the run took
+ */
+static void headless_summary(sim_time_t now, double wall)
+{
+  sim_stats_t total;
+  counter_snap_t snap[MAX_LANES];
+  int idle;
+  int side;
+
+  plant_stats(&total, &idle);
+  countersRead(snap);
+
+  printf("{\"event\":\"summary\",\"time\":%.6f,\"wall\":%.6f,\"lanes\":%d,\"workers\":%d,"
+         "\"seed\":%llu,\"events\":%llu,\"blocks\":%llu,\"small\":%llu,\"big\":%llu,"
+         "\"sorted\":%llu,\"missed_gates\":%llu,\"missorted\":%llu,\"collected\":%llu,"
+         "\"missed_counts\":%llu,\"blocks_per_sec\":%.1f,\"counters\":[",
+         (double)now / SIM_US_PER_SEC, wall, numLanes, workersCount(),
+         (unsigned long long)runSeed,
+         (unsigned long long)total.events,
+         (unsigned long long)total.blocks,
+         (unsigned long long)total.small,
+         (unsigned long long)total.big,
+         (unsigned long long)total.sorted,
+         (unsigned long long)total.missedGates,
+         (unsigned long long)total.missorted,
+         (unsigned long long)total.collected,
+         (unsigned long long)total.missedCounts,
+         (wall > 0) ? total.blocks / wall : 0.0);
+
+  for (side = 0; side < numLanes; side++)
+  {
+    printf("%s{\"lane\":%d,\"small\":%llu,\"big\":%llu,\"collected\":%llu}",
+           (side > 0) ? "," : "", side + 1,
+           (unsigned long long)snap[side].value[CTR_SMALL],
+           (unsigned long long)snap[side].value[CTR_BIG],
+           (unsigned long long)snap[side].value[CTR_COLLECTED]);
+  }
+  printf("]}\n");
+}
+
+/**
+ * @brief adds up the statistics of every shard
+ *
+ * @param total - filled with the plant totals
+ * @param idle  - set TRUE when no shard has anything left to simulate
+ */
+static void plant_stats(sim_stats_t *total, int *idle)
+{
+  const sim_stats_t *stats;
+  int shard;
+
+  memset(total, 0, sizeof(*total));
+  *idle = TRUE;
+
+  for (shard = 0; shard < numShards; shard++)
+  {
+    stats = &shards[shard].sim.stats;
+    total->events       += stats->events;
+    total->blocks       += stats->blocks;
+    total->small        += stats->small;
+    total->big          += stats->big;
+    total->sorted       += stats->sorted;
+    total->missedGates  += stats->missedGates;
+    total->missorted    += stats->missorted;
+    total->collected    += stats->collected;
+    total->missedCounts += stats->missedCounts;
+
+    if (shards[shard].sim.queueLen > 0)
+    {
+      *idle = FALSE;
+    }
+  }
+}
+
+/**
+ * @brief worker job, runs one shard of lanes on for the requested duration
+ *
+ * @param arg   - pointer to the sim_time_t duration
+ * @param shard - shard to run
+ */
+static void run_shard(void *arg, int shard)
+{
+  runningShard = &shards[shard].sim;
+  simRunFor(&shards[shard].sim, *(sim_time_t *)arg);
+  runningShard = NULL;
+}
+
+/**
+ * @brief simulator callback when replaying, blocks arrive at the times
+ *        recorded in the trace
+ *
+ * @return sim_time_t - time of the lane's next block, SIM_NEVER at the end
+ */
+static sim_time_t sim_arrival(void *arg, int lane, sim_time_t now)
+{
+  uint64_t next = cReplayNextBlock(lane);
+
+  return (next == CIF_NO_BLOCK) ? SIM_NEVER : next;
+}
+
+/**
+ * @brief simulator callback with a workload, takes the lane's next block
+ *        from its stream and holds its size until it reaches the sensors
+ *
+ * @return sim_time_t - time of the lane's next block, SIM_NEVER at the end
+ */
+static sim_time_t sim_block(void *arg, int lane, sim_time_t now)
+{
+  double time;
+
+  if (workloadNext(&workload, &blockSources[lane].stream, &time, &blockSources[lane].size) != 0)
+  {
+    return SIM_NEVER;
+  }
+  return SIM_SECONDS(time);
+}
+
+/**
+ * @brief simulator callback with a workload, puts the generated block at the
+ *        size sensors and reads them as normal
+ *
+ * @return int - SIZE_NONE, SIZE_SMALL or SIZE_BIG
+ */
+static int sim_place(void *arg, int lane)
+{
+  cPlaceBlock(lane, blockSources[lane].size);
+  return task_size(lane);
+}
+
+/**
+ * @brief clock for recorded sensor reads, virtual time of the shard running
+ *        on this thread
+ *
+ * @return uint64_t - time in microseconds
+ */
+static uint64_t sim_clock(void)
+{
+  return (runningShard != NULL) ? runningShard->now : 0;
+}
+
+/**
+ * @brief simulator callback, block has reached the size sensors
+ *
+ * @return int - SIZE_NONE, SIZE_SMALL or SIZE_BIG
+ */
+static int sim_detect(void *arg, int lane)
+{
+  return task_size(lane);
+}
+
+/**
+ * @brief simulator callback, count timer found a block at the count sensor
+ *
+ */
+static void sim_collect(void *arg, int lane)
+{
+  task_count(lane);
+}
+
+/**
+ * @brief simulator callback, gate timer has closed or opened a gate
+ *
+ */
+static void sim_gate(void *arg, int lane, int closed)
+{
+  task_gate(lane, closed);
 }
 
 /**
@@ -185,14 +762,14 @@ int task_size(int side)
   //Increment counters depending on size of block
   if(sensorVal == SIZE_SMALL)
   {
-    debug_printf("Small block detected on %s side\n", sideString[side]);
-    counters.small[side]++;
+    debug_printf("Small block detected on %s lane\n", laneName(side));
+    counterInc(&lanes[side].counters, CTR_SIZE_WRITER, CTR_SMALL);
     returnVal = SIZE_SMALL;
   }
   else if(sensorVal == SIZE_BIG)
   {
-    debug_printf("Big block detected on %s side\n", sideString[side]);
-    counters.big[side]++;
+    debug_printf("Big block detected on %s lane\n", laneName(side));
+    counterInc(&lanes[side].counters, CTR_SIZE_WRITER, CTR_BIG);
     returnVal = SIZE_BIG;
   }
   return(returnVal);
@@ -214,38 +791,30 @@ void task_count(int side)
   // Increment collected count when a block is detected
   if(sensorVal == COUNT_BLOCK)
   {
-    debug_printf("Block collected on %s side\n", sideString[side]);
-    counters.collected[side]++;
+    debug_printf("Block collected on %s lane\n", laneName(side));
+    counterInc(&lanes[side].counters, CTR_COUNT_WRITER, CTR_COLLECTED);
   }
 }
 
 /**
- * @brief simulates gate functionality for sorting blocks
+ * @brief simulates gate functionality for sorting blocks, gates on other
+ *        lanes are left as they are
  *
- * @param side - Which conveyor to sort, LEFT or RIGHT
+ * @param side   - Which lane to sort
+ * @param closed - TRUE to close the gate, FALSE to open it
  */
-void task_gate(int side)
+void task_gate(int side, int closed)
 {
-  int gateVal;
-
-  // Set gate to close to match side
-  if(side == LEFT)
+  if(closed == TRUE)
   {
-    gateVal = GATE_CLOSED_L;
+    debug_printf("%s gate closed\n", laneName(side));
+    setGate(side, GATE_CLOSED);
   }
-  else if(side == RIGHT)
+  else
   {
-    gateVal = GATE_CLOSED_R;
+    debug_printf("%s gate open\n", laneName(side));
+    setGate(side, GATE_OPEN);
   }
-
-  // close gate(s)
-  debug_printf("Gate state : %s\n", gateString[gateVal]);
-  setGates(gateVal);
-  //Wait for block to be pushed off
-  //sleep(GATE_CLOSE);
-  //Open gates
-  debug_printf("Gate state : %s\n", gateString[gateVal]);
-  setGates(GATE_OPEN);
 }
 
 int task_ui(void)
@@ -261,7 +830,8 @@ int task_ui(void)
 
       ui_printf(uiMainMenu, UI_MAIN_ITEMS);
 
-      menuLevel = ui_main(ui_input());
+      // Options follow the two title lines
+      menuLevel = ui_main(ui_input(1, UI_MAIN_ITEMS - 2));
       break;
 
     // Enters and exits debug mode
@@ -283,29 +853,53 @@ int task_ui(void)
     //User has requested counter values
     case COUNTERS:
       ui_printf(uiCounterMenu, UI_MAIN_ITEMS);
-      ctr = ui_input();
+      ctr = ui_input(SMALL, ALL);
       menuLevel = COUNTERS_CONV;
+      if (ctr == 0)
+      {
+        printf("Invalid input\n");
+        menuLevel = TOP;
+      }
       break;
 
     //Decides which conveyor to print value for
     case COUNTERS_CONV:
-      ui_printf(uiConveyorMenu, UI_MAIN_ITEMS);
-      cnv = ui_input();
-      ui_counter(ctr, cnv);
+      ui_conveyor_menu();
+      cnv = ui_input(1, numLanes + 1);
+      if (cnv != 0)
+      {
+        ui_counter(ctr, cnv);
+      }
+      else
+      {
+        printf("Invalid input\n");
+      }
       menuLevel = TOP;
       //sleep(3);
       break;
 
     case RESET:
       ui_printf(uiCounterMenu, UI_MAIN_ITEMS);
-      ctr = ui_input();
+      ctr = ui_input(SMALL, ALL);
       menuLevel = RESET_CONV;
+      if (ctr == 0)
+      {
+        printf("Invalid input\n");
+        menuLevel = TOP;
+      }
       break;
 
     case RESET_CONV:
-      ui_printf(uiConveyorMenu, UI_MAIN_ITEMS);
-      cnv = ui_input();
-      ui_reset(ctr, cnv);
+      ui_conveyor_menu();
+      cnv = ui_input(1, numLanes + 1);
+      if (cnv != 0)
+      {
+        ui_reset(ctr, cnv);
+      }
+      else
+      {
+        printf("Invalid input\n");
+      }
       menuLevel = TOP;
       //sleep(3);
       break;
@@ -0,0 +1,444 @@
+/*
+ * ****************************************************************************
+ * File           : placement.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Task placement profiles, see placement.h. Profiles are
+ *                  written as space separated rules,
+ *
+ *                    role=cpus[:policy]
+ *
+ *                  where role is timer, size, count, gate, ui or other, cpus
+ *                  is a list such as 2-3,6 or * for any CPU and policy is
+ *                  other, fifo or rr. Lane tasks are spread over their
+ *                  role's CPUs by lane, so a lane's size, count and gate
+ *                  tasks share a core when their roles list the same CPUs.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+// CPU affinity
+#define _GNU_SOURCE
+
+//Standard C Libraries
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+// VxWorks Libraries
+#include "../VxWorks/vxWorks.h"
+#include "../VxWorks/taskLib.h"
+
+//Project Header Files
+#include "../inc/config.h"
+#include "../inc/placement.h"
+/* !SECTION Includes */
+
+/* Kernel list of CPUs kept free of other work by isolcpus */
+#define PLACE_ISOLATED "/sys/devices/system/cpu/isolated"
+
+/* SECTION Local Variables --------------------------------------------------*/
+static const char *roleName[NUM_PLACE_ROLES] = {"timer", "size", "count", "gate", "ui", "other"};
+/* !SECTION Local Variables */
+
+// Function Decleration
+static int  placeCpuList(const char *list, int *cpu, int max);
+static int  placePolicy(const char *name);
+static const char *placePolicyName(int policy);
+static int  placeHasCpu(const place_rule_t *rule, int cpu);
+static void placeIsolated(cpu_set_t *isolated);
+
+
+// Global functions
+
+/**
+ * @brief Reads a placement profile, roles it doesn't mention are left as
+ *        they are spawned
+ *
+ * @param place - filled with the profile
+ * @param spec  - rules as described above
+ * @return int - 0 on success, -1 if a rule is invalid
+ */
+int placementParse(placement_t *place, const char *spec)
+{
+  char *copy;
+  char *rule;
+  char *save;
+  char *cpus;
+  char *policy;
+  place_rule_t *r;
+  int role;
+  int result = 0;
+
+  memset(place, 0, sizeof(*place));
+  copy = strdup(spec);
+  if (copy == NULL)
+  {
+    return -1;
+  }
+
+  for (rule = strtok_r(copy, " \t;", &save); rule != NULL && result == 0; rule = strtok_r(NULL, " \t;", &save))
+  {
+    cpus = strchr(rule, '=');
+    if (cpus == NULL)
+    {
+      result = -1;
+      break;
+    }
+    *cpus++ = '\0';
+    policy = strchr(cpus, ':');
+    if (policy != NULL)
+    {
+      *policy++ = '\0';
+    }
+
+    for (role = 0; role < NUM_PLACE_ROLES; role++)
+    {
+      if (strcmp(rule, roleName[role]) == 0)
+      {
+        break;
+      }
+    }
+    if (role == NUM_PLACE_ROLES)
+    {
+      result = -1;
+      break;
+    }
+
+    r = &place->rule[role];
+    r->set    = TRUE;
+    r->policy = (policy == NULL) ? SCHED_OTHER : placePolicy(policy);
+    r->cpuCount = (strcmp(cpus, "*") == 0) ? 0 : placeCpuList(cpus, r->cpu, PLACE_MAX_CPUS);
+    if (r->policy < 0 || r->cpuCount < 0)
+    {
+      result = -1;
+    }
+  }
+
+  free(copy);
+  return result;
+}
+
+/**
+ * @brief Checks a profile can be applied on this machine. CPUs that don't
+ *        exist or that the process may not use, and real-time policies
+ *        without permission to use them, are errors. Control tasks sharing
+ *        a CPU with the UI or other tasks, or on CPUs that aren't isolated,
+ *        only get a warning.
+ *
+ * @param place - profile to check
+ * @param out   - stream to report problems to
+ * @return int - number of errors, 0 if the profile can be applied
+ */
+int placementCheck(const placement_t *place, FILE *out)
+{
+  cpu_set_t allowed;
+  cpu_set_t isolated;
+  struct rlimit rtprio;
+  const place_rule_t *r;
+  int role;
+  int other;
+  int i;
+  int errors = 0;
+  int top = 0;
+
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+  placeIsolated(&isolated);
+
+  for (role = 0; role < NUM_PLACE_ROLES; role++)
+  {
+    r = &place->rule[role];
+    if (r->set == FALSE)
+    {
+      continue;
+    }
+    /* Tasks at VxWorks priority 0, or in taskLock, run this high */
+    if (v2lin_posix_priority(r->policy, MAX_V2PT_PRIORITY) > top)
+    {
+      top = v2lin_posix_priority(r->policy, MAX_V2PT_PRIORITY);
+    }
+
+    for (i = 0; i < r->cpuCount; i++)
+    {
+      if (r->cpu[i] >= CPU_SETSIZE || !CPU_ISSET(r->cpu[i], &allowed))
+      {
+        fprintf(out, "placement: %s cpu %d is not available\n", roleName[role], r->cpu[i]);
+        errors++;
+        continue;
+      }
+      if (role == PLACE_UI || role == PLACE_OTHER)
+      {
+        continue;
+      }
+
+      /* Control tasks only get steady timing on CPUs nothing else uses */
+      for (other = PLACE_UI; other <= PLACE_OTHER; other++)
+      {
+        if (place->rule[other].set == FALSE || placeHasCpu(&place->rule[other], r->cpu[i]))
+        {
+          fprintf(out, "placement: warning, %s cpu %d is shared with %s tasks\n",
+                  roleName[role], r->cpu[i], roleName[other]);
+        }
+      }
+      if (!CPU_ISSET(r->cpu[i], &isolated))
+      {
+        fprintf(out, "placement: warning, %s cpu %d is not isolated\n", roleName[role], r->cpu[i]);
+      }
+    }
+  }
+
+  if (top > 0 && geteuid() != 0 &&
+      (getrlimit(RLIMIT_RTPRIO, &rtprio) != 0 || rtprio.rlim_cur < (rlim_t)top))
+  {
+    fprintf(out, "placement: no permission for real-time priorities up to %d\n", top);
+    errors++;
+  }
+  return errors;
+}
+
+/**
+ * @brief Applies a role's placement to a thread
+ *
+ * @param place    - profile to apply
+ * @param role     - what the thread does
+ * @param lane     - lane of a lane task, which picks its CPU from the
+ *                   role's list, -1 to allow every CPU in the list
+ * @param priority - VxWorks priority of the task, 0 highest
+ * @param thread   - thread to place
+ * @return int - 0 on success or if the role isn't placed, -1 if the thread
+ *               could not be moved
+ */
+int placementApply(const placement_t *place, place_role_t role, int lane, int priority, pthread_t thread)
+{
+  const place_rule_t *r = &place->rule[role];
+  struct sched_param param;
+  cpu_set_t cpus;
+  int i;
+
+  if (r->set == FALSE)
+  {
+    return 0;
+  }
+
+  if (r->cpuCount > 0)
+  {
+    CPU_ZERO(&cpus);
+    if (lane >= 0)
+    {
+      CPU_SET(r->cpu[lane % r->cpuCount], &cpus);
+    }
+    else
+    {
+      for (i = 0; i < r->cpuCount; i++)
+      {
+        CPU_SET(r->cpu[i], &cpus);
+      }
+    }
+    if (pthread_setaffinity_np(thread, sizeof(cpus), &cpus) != 0)
+    {
+      return -1;
+    }
+  }
+
+  /* The shim's own mapping, which taskPrioritySet and taskLock reapply */
+  param.sched_priority = v2lin_posix_priority(r->policy, priority);
+  return (pthread_setschedparam(thread, r->policy, &param) == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Prints a profile, one line per role
+ *
+ * @param out   - stream to print to
+ * @param place - profile to print
+ */
+void placementPrint(FILE *out, const placement_t *place)
+{
+  const place_rule_t *r;
+  int role;
+  int i;
+
+  for (role = 0; role < NUM_PLACE_ROLES; role++)
+  {
+    r = &place->rule[role];
+    fprintf(out, "%-6s ", roleName[role]);
+    if (r->set == FALSE)
+    {
+      fprintf(out, "not placed\n");
+      continue;
+    }
+
+    if (r->cpuCount == 0)
+    {
+      fprintf(out, "any cpu");
+    }
+    for (i = 0; i < r->cpuCount; i++)
+    {
+      fprintf(out, "%s%d", (i == 0) ? "cpu " : ",", r->cpu[i]);
+    }
+    fprintf(out, ", %s", placePolicyName(r->policy));
+    if (r->policy != SCHED_OTHER)
+    {
+      fprintf(out, " priority %d down by VxWorks priority",
+              v2lin_posix_priority(r->policy, MAX_V2PT_PRIORITY));
+    }
+    fprintf(out, "\n");
+  }
+}
+
+
+// Local functions
+
+/**
+ * @brief Reads a CPU list such as 0-2,5
+ *
+ * @param list - text of the list
+ * @param cpu  - filled with the CPUs in order
+ * @param max  - most CPUs to accept
+ * @return int - number of CPUs, -1 if the list is invalid or too long
+ */
+static int placeCpuList(const char *list, int *cpu, int max)
+{
+  const char *p = list;
+  char *end;
+  long first;
+  long last;
+  int count = 0;
+
+  while (*p != '\0')
+  {
+    first = strtol(p, &end, 10);
+    if (end == p || first < 0)
+    {
+      return -1;
+    }
+    last = first;
+    p = end;
+    if (*p == '-')
+    {
+      last = strtol(p + 1, &end, 10);
+      if (end == p + 1 || last < first)
+      {
+        return -1;
+      }
+      p = end;
+    }
+    for (; first <= last; first++)
+    {
+      if (count == max)
+      {
+        return -1;
+      }
+      cpu[count++] = first;
+    }
+    if (*p == ',')
+    {
+      p++;
+    }
+    else if (*p != '\0' && *p != '\n')
+    {
+      return -1;
+    }
+    else
+    {
+      break;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Scheduling policy from its name
+ *
+ * @return int - SCHED_OTHER, SCHED_FIFO or SCHED_RR, -1 if unknown
+ */
+static int placePolicy(const char *name)
+{
+  if (strcmp(name, "other") == 0)
+  {
+    return SCHED_OTHER;
+  }
+  if (strcmp(name, "fifo") == 0)
+  {
+    return SCHED_FIFO;
+  }
+  if (strcmp(name, "rr") == 0)
+  {
+    return SCHED_RR;
+  }
+  return -1;
+}
+
+/**
+ * @brief Name of a scheduling policy, as used in profiles
+ */
+static const char *placePolicyName(int policy)
+{
+  switch (policy)
+  {
+  case SCHED_FIFO:
+    return "fifo";
+  case SCHED_RR:
+    return "rr";
+  default:
+    return "other";
+  }
+}
+
+/**
+ * @brief Whether a rule lets its tasks run on a CPU
+ */
+static int placeHasCpu(const place_rule_t *rule, int cpu)
+{
+  int i;
+
+  if (rule->cpuCount == 0)
+  {
+    return TRUE;
+  }
+  for (i = 0; i < rule->cpuCount; i++)
+  {
+    if (rule->cpu[i] == cpu)
+    {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/**
+ * @brief Reads the CPUs isolated from the kernel's scheduler, none if the
+ *        kernel doesn't say
+ *
+ * @param isolated - filled with the isolated CPUs
+ */
+static void placeIsolated(cpu_set_t *isolated)
+{
+  char line[256];
+  int cpu[CPU_SETSIZE];
+  int count = 0;
+  int i;
+  FILE *file;
+
+  CPU_ZERO(isolated);
+  file = fopen(PLACE_ISOLATED, "r");
+  if (file == NULL)
+  {
+    return;
+  }
+  if (fgets(line, sizeof(line), file) != NULL && line[0] != '\n')
+  {
+    count = placeCpuList(line, cpu, CPU_SETSIZE);
+  }
+  fclose(file);
+
+  for (i = 0; i < count; i++)
+  {
+    CPU_SET(cpu[i], isolated);
+  }
+}
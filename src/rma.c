@@ -0,0 +1,293 @@
+/*
+ * ****************************************************************************
+ * File           : rma.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Deadline monotonic priority assignment and response time
+ *                  analysis, see rma.h. Tasks with the same deadline share a
+ *                  priority level, as the lanes' tasks do, and are assumed to
+ *                  interfere with each other both ways.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Project Header Files
+#include "../inc/budget.h"
+#include "../inc/config.h"
+#include "../inc/rma.h"
+/* !SECTION Includes */
+
+/* Slack allowed when comparing times, keeps exact multiples exact */
+#define RMA_EPSILON 1e-12
+
+// Function Decleration
+static double rmaDeadline(const rma_task_t *task);
+static int    rmaCompare(const void *a, const void *b);
+static double rmaResponse(const rma_task_t *task, int count, int i);
+
+
+// Global functions
+
+/**
+ * @brief Fills in the controller's task set, periods from config.h and the
+ *        interface timing. Size tasks are released every poll, count and
+ *        gate tasks once per block, the timer task every tick. Execution
+ *        times are the estimates in config.h until rmaMeasured replaces
+ *        them.
+ *
+ * @param task     - RMA_TASKS(lanes) tasks to fill
+ * @param lanes    - number of lanes controlled
+ * @param tickRate - system clock ticks per second
+ * @return int - number of tasks filled in
+ */
+int rmaControllerTasks(rma_task_t *task, int lanes, double tickRate)
+{
+  int lane;
+  rma_task_t *t;
+
+  memset(task, 0, RMA_TASKS(lanes) * sizeof(rma_task_t));
+
+  t = &task[RMA_TIMER];
+  snprintf(t->name, TASK_NAME_LENGTH, "CW_timer_task");
+  t->period = 1 / tickRate;
+  t->wcet   = TIMER_WCET;
+
+  for (lane = 0; lane < lanes; lane++)
+  {
+    /* The size task holds the lane lock against its count task */
+    t = &task[RMA_LANE(lane, RMA_SIZE)];
+    snprintf(t->name, TASK_NAME_LENGTH, "CW_size_task_%d", lane);
+    t->period   = TASK_DELAY / tickRate;
+    t->wcet     = SIZE_WCET;
+    t->blocking = LOCK_WCET;
+
+    t = &task[RMA_LANE(lane, RMA_COUNT)];
+    snprintf(t->name, TASK_NAME_LENGTH, "CW_count_task_%d", lane);
+    t->period = BLOCK_MIN_GAP;
+    t->wcet   = COUNT_WCET;
+
+    t = &task[RMA_LANE(lane, RMA_GATE)];
+    snprintf(t->name, TASK_NAME_LENGTH, "CW_gate_task_%d", lane);
+    t->period = BLOCK_MIN_GAP;
+    t->wcet   = GATE_WCET;
+  }
+  return RMA_TASKS(lanes);
+}
+
+/**
+ * @brief Replaces estimated execution times with the worst iteration each
+ *        task's budget has measured, for tasks that have run
+ *
+ * @param task   - tasks to update, in the same order as their budgets
+ * @param budget - budgets charged by the running tasks
+ * @param count  - number of tasks
+ * @return int - number of tasks given a measured time
+ */
+int rmaMeasured(rma_task_t *task, const task_budget_t *budget, int count)
+{
+  int i;
+  int measured = 0;
+
+  for (i = 0; i < count; i++)
+  {
+    if (__atomic_load_n(&budget[i].runs, __ATOMIC_RELAXED) > 0)
+    {
+      task[i].wcet     = __atomic_load_n(&budget[i].worstNs, __ATOMIC_RELAXED) / 1e9;
+      task[i].measured = 1;
+      measured++;
+    }
+  }
+  return measured;
+}
+
+/**
+ * @brief Assigns priority levels, shortest deadline first, then works out
+ *        each task's worst case response time
+ *
+ *        R = C + B + sum over tasks j at the same or a higher level of
+ *            ceil(R / Tj) * Cj
+ *
+ *        iterated from R = C + B until it settles or passes the deadline.
+ *
+ * @param task  - tasks to analyse, level and response are filled in
+ * @param count - number of tasks
+ * @return int - 0 if every deadline is met, otherwise the number of tasks
+ *               that can miss theirs, -1 if there are more tasks than the
+ *               largest controller
+ */
+int rmaAnalyse(rma_task_t *task, int count)
+{
+  double deadline[RMA_TASKS(MAX_LANES)];
+  int levels = 0;
+  int i;
+  int missed = 0;
+
+  if (count > RMA_TASKS(MAX_LANES))
+  {
+    return -1;
+  }
+
+  /* Distinct deadlines, shortest first, a task's level is its position */
+  for (i = 0; i < count; i++)
+  {
+    deadline[i] = rmaDeadline(&task[i]);
+  }
+  qsort(deadline, count, sizeof(double), rmaCompare);
+  for (i = 0; i < count; i++)
+  {
+    if (levels == 0 || deadline[i] > deadline[levels - 1] + RMA_EPSILON)
+    {
+      deadline[levels++] = deadline[i];
+    }
+  }
+  for (i = 0; i < count; i++)
+  {
+    task[i].level = 0;
+    while (deadline[task[i].level] < rmaDeadline(&task[i]) - RMA_EPSILON)
+    {
+      task[i].level++;
+    }
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    task[i].response = rmaResponse(task, count, i);
+    if (task[i].response == 0)
+    {
+      missed++;
+    }
+  }
+  return missed;
+}
+
+/**
+ * @brief Total processor utilisation of a task set
+ *
+ * @return double - sum of wcet / period
+ */
+double rmaUtilisation(const rma_task_t *task, int count)
+{
+  double total = 0;
+  int i;
+
+  for (i = 0; i < count; i++)
+  {
+    total += task[i].wcet / task[i].period;
+  }
+  return total;
+}
+
+/**
+ * @brief Liu and Layland utilisation bound, any set of count tasks with
+ *        deadlines equal to periods under it is schedulable
+ *
+ * @return double - count * (2^(1/count) - 1)
+ */
+double rmaBound(int count)
+{
+  if (count <= 0)
+  {
+    return 1;
+  }
+  return count * (pow(2, 1.0 / count) - 1);
+}
+
+/**
+ * @brief Prints the analysis as a table, times in milliseconds
+ *
+ * @param out   - stream to print to
+ * @param task  - tasks analysed by rmaAnalyse
+ * @param count - number of tasks
+ */
+void rmaPrint(FILE *out, const rma_task_t *task, int count)
+{
+  int i;
+  int estimated = 0;
+  double util = rmaUtilisation(task, count);
+
+  fprintf(out, "%-*s %5s %10s %10s %10s %10s %s\n", TASK_NAME_LENGTH, "task",
+          "level", "period", "wcet", "deadline", "response", "");
+  for (i = 0; i < count; i++)
+  {
+    estimated += !task[i].measured;
+    fprintf(out, "%-*s %5d %10.3f %9.3f%c %10.3f ", TASK_NAME_LENGTH, task[i].name,
+            task[i].level, task[i].period * 1e3, task[i].wcet * 1e3,
+            task[i].measured ? ' ' : '*', rmaDeadline(&task[i]) * 1e3);
+    if (task[i].response > 0)
+    {
+      fprintf(out, "%10.3f ok\n", task[i].response * 1e3);
+    }
+    else
+    {
+      fprintf(out, "%10s MISSED\n", "-");
+    }
+  }
+  fprintf(out, "utilisation %.3f, rate monotonic bound %.3f\n", util, rmaBound(count));
+  if (estimated > 0)
+  {
+    fprintf(out, "* %d of %d wcet are unmeasured estimates from config.h\n", estimated, count);
+  }
+}
+
+
+// Local functions
+
+/**
+ * @brief Deadline of a task, its period unless one is given
+ */
+static double rmaDeadline(const rma_task_t *task)
+{
+  return (task->deadline > 0) ? task->deadline : task->period;
+}
+
+/**
+ * @brief Orders deadlines for qsort, shortest first
+ */
+static int rmaCompare(const void *a, const void *b)
+{
+  double da = *(const double *)a;
+  double db = *(const double *)b;
+
+  return (da > db) - (da < db);
+}
+
+/**
+ * @brief Worst case response time of one task
+ *
+ * @param task  - analysed task set, levels already assigned
+ * @param count - number of tasks
+ * @param i     - task to find the response time of
+ * @return double - response time, 0 if it can pass the deadline
+ */
+static double rmaResponse(const rma_task_t *task, int count, int i)
+{
+  double deadline = rmaDeadline(&task[i]);
+  double response = task[i].wcet + task[i].blocking;
+  double next;
+  int j;
+
+  while (response <= deadline + RMA_EPSILON)
+  {
+    next = task[i].wcet + task[i].blocking;
+    for (j = 0; j < count; j++)
+    {
+      if (j != i && task[j].level <= task[i].level)
+      {
+        next += ceil(response / task[j].period - RMA_EPSILON) * task[j].wcet;
+      }
+    }
+    if (next <= response + RMA_EPSILON)
+    {
+      return response;
+    }
+    response = next;
+  }
+  return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * ****************************************************************************
+ * File           : rng.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Seeding and helpers for the xoshiro256** generator
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Project Header Files
+#include "../inc/rng.h"
+/* !SECTION Includes */
+
+
+// Global functions
+
+/**
+ * @brief Seeds a generator. The seed is expanded with splitmix64 so nearby
+ *        seeds (such as seed + lane) still give unrelated sequences.
+ *
+ * @param rng  - generator to seed
+ * @param seed - any value, including 0
+ */
+void rngSeed(rng_t *rng, uint64_t seed)
+{
+  int i;
+  uint64_t z;
+
+  for (i = 0; i < 4; i++)
+  {
+    seed += 0x9e3779b97f4a7c15ULL;
+    z = seed;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    rng->s[i] = z ^ (z >> 31);
+  }
+}
+
+/**
+ * @brief Random double in the range [0, 1)
+ *
+ */
+double rngUniform(rng_t *rng)
+{
+  return (rngNext(rng) >> 11) * 0x1.0p-53;
+}
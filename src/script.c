@@ -0,0 +1,184 @@
+/*
+ * ****************************************************************************
+ * File           : script.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Reads headless command scripts, see script.h. Each line
+ *                  is "<seconds> read|reset [counter] [lane]" where counter
+ *                  is small, big, collected or all and lane is a lane number
+ *                  from 1 or all. Both default to all.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Project Header Files
+#include "../inc/config.h"
+#include "../inc/lanes.h"
+#include "../inc/script.h"
+#include "../inc/ui.h"
+/* !SECTION Includes */
+
+/* Starting size of the command list, grows when full */
+#define SCRIPT_START 16
+
+/* Counter names, in SMALL, BIG, COLLECTED, ALL order */
+static const char counterNames[4][10] = {
+  {"small"}, {"big"}, {"collected"}, {"all"}
+};
+
+
+// Global functions
+
+/**
+ * @brief Starts an empty script
+ *
+ * @param script - script to initialise
+ */
+void scriptInit(script_t *script)
+{
+  memset(script, 0, sizeof(*script));
+}
+
+/**
+ * @brief Parses one script line and inserts it in time order. Blank lines
+ *        and lines starting with # are accepted and ignored. Lanes are
+ *        checked against numLanes, so lanes must be set up first.
+ *
+ * @param script - script to add to
+ * @param line   - command text
+ * @return int - 0 on success, -1 on a bad line or out of memory
+ */
+int scriptAdd(script_t *script, const char *line)
+{
+  script_cmd_t cmd;
+  char action[8];
+  char counter[12] = "all";
+  char lane[8] = "all";
+  script_cmd_t *grown;
+  int fields;
+  int pos;
+
+  fields = sscanf(line, "%lf %7s %11s %7s", &cmd.time, action, counter, lane);
+  if (fields <= 0)
+  {
+    // Blank line, or a comment when nothing converted
+    return (sscanf(line, " %1[#]", action) == 1 || fields == EOF) ? 0 : -1;
+  }
+  if (fields < 2 || cmd.time < 0)
+  {
+    return -1;
+  }
+
+  if (strcmp(action, "read") == 0)
+  {
+    cmd.action = SCRIPT_READ;
+  }
+  else if (strcmp(action, "reset") == 0)
+  {
+    cmd.action = SCRIPT_RESET;
+  }
+  else
+  {
+    return -1;
+  }
+
+  for (cmd.ctr = SMALL; cmd.ctr <= ALL; cmd.ctr++)
+  {
+    if (strcmp(counter, counterNames[cmd.ctr - SMALL]) == 0)
+    {
+      break;
+    }
+  }
+  if (cmd.ctr > ALL)
+  {
+    return -1;
+  }
+
+  if (strcmp(lane, "all") == 0)
+  {
+    cmd.lane = SCRIPT_ALL_LANES;
+  }
+  else
+  {
+    cmd.lane = atoi(lane) - 1;
+    if (cmd.lane < 0 || cmd.lane >= numLanes)
+    {
+      return -1;
+    }
+  }
+
+  if (script->count == script->cap)
+  {
+    script->cap = (script->cap == 0) ? SCRIPT_START : 2 * script->cap;
+    grown = realloc(script->cmd, script->cap * sizeof(script_cmd_t));
+    if (grown == NULL)
+    {
+      return -1;
+    }
+    script->cmd = grown;
+  }
+
+  // Insert after every command due at or before it
+  pos = script->count++;
+  while (pos > 0 && script->cmd[pos - 1].time > cmd.time)
+  {
+    script->cmd[pos] = script->cmd[pos - 1];
+    pos--;
+  }
+  script->cmd[pos] = cmd;
+  return 0;
+}
+
+/**
+ * @brief Reads a script file, one command per line
+ *
+ * @param script - script to add the commands to
+ * @param path   - script file, "-" for stdin
+ * @return int - 0 on success, -1 if the file can't be read or has a bad line
+ */
+int scriptLoad(script_t *script, const char *path)
+{
+  char line[128];
+  int lineNum = 0;
+  int result = 0;
+  FILE *file;
+
+  file = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+  if (file == NULL)
+  {
+    return -1;
+  }
+
+  while (result == 0 && fgets(line, sizeof(line), file) != NULL)
+  {
+    lineNum++;
+    result = scriptAdd(script, line);
+    if (result != 0)
+    {
+      fprintf(stderr, "%s:%d: bad script line\n", path, lineNum);
+    }
+  }
+
+  if (file != stdin)
+  {
+    fclose(file);
+  }
+  return result;
+}
+
+/**
+ * @brief Releases a script's commands
+ *
+ * @param script - script to free
+ */
+void scriptFree(script_t *script)
+{
+  free(script->cmd);
+  scriptInit(script);
+}
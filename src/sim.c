@@ -0,0 +1,432 @@
+/*
+ * ****************************************************************************
+ * File           : sim.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Discrete-event engine for the conveyor belt simulator.
+ *                  Each block placed on a lane becomes a chain of events
+ *                  (size sensor, gate, count sensor) and the controller's
+ *                  timers become gate and count read events, all kept on a
+ *                  single time ordered heap.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <stdlib.h>
+#include <string.h>
+
+//Project Header Files
+#include "../inc/config.h"
+#include "../inc/sim.h"
+/* !SECTION Includes */
+
+/* Starting size of the event queue, grows when full */
+#define SIM_QUEUE_START 256
+
+// Function Decleration
+static int  simPush(sim_t *sim, sim_time_t time, int type, int lane, int size);
+static void simPop(sim_t *sim, sim_event_t *ev);
+static void simHandle(sim_t *sim, const sim_event_t *ev);
+static int  simNextArrival(sim_t *sim, int lane, sim_time_t now, int first);
+static sim_time_t simTimerDelay(double seconds, double tickRate);
+
+
+// Global functions
+
+/**
+ * @brief Fills params with the timing values from config.h, the belt is
+ *        assumed to match the controller timing exactly
+ *
+ * @param params - parameters to fill
+ */
+void simDefaultParams(sim_params_t *params)
+{
+  params->gateDelay   = GATE_DELAY;
+  params->gateClose   = GATE_CLOSE;
+  params->countDelay  = COUNT_DELAY;
+  params->pollPeriod  = 0;
+  params->tickRate    = 0;
+  params->gateTravel  = GATE_DELAY;
+  params->countTravel = COUNT_DELAY;
+  params->arrivalGap  = SIM_ARRIVAL_GAP;
+  params->firstLane   = 0;
+  params->lanes       = DEFAULT_LANES;
+  params->plantLanes  = DEFAULT_LANES;
+}
+
+/**
+ * @brief Sets up a simulation and schedules the first block on each lane.
+ *        Lanes are staggered so blocks do not all arrive together.
+ *
+ * @param sim    - simulation to initialise
+ * @param params - plant and controller timing
+ * @param ops    - controller callbacks
+ * @param arg    - passed to every callback
+ *
+ * @return int - 0 on success, -1 if memory could not be allocated
+ */
+int simInit(sim_t *sim, const sim_params_t *params, const sim_ops_t *ops, void *arg)
+{
+  int lane;
+
+  memset(sim, 0, sizeof(*sim));
+  sim->params = *params;
+  sim->ops    = ops;
+  sim->arg    = arg;
+
+  sim->gateDelay   = simTimerDelay(params->gateDelay, params->tickRate);
+  sim->gateClose   = simTimerDelay(params->gateClose, params->tickRate);
+  sim->countDelay  = simTimerDelay(params->countDelay, params->tickRate);
+  sim->pollPeriod  = SIM_SECONDS(params->pollPeriod);
+  sim->gateTravel  = SIM_SECONDS(params->gateTravel);
+  sim->countTravel = SIM_SECONDS(params->countTravel);
+  sim->arrivalGap  = SIM_SECONDS(params->arrivalGap);
+
+  /* Count sensor is assumed to be after the gate */
+  if (sim->countTravel > sim->gateTravel)
+  {
+    sim->gateToCount = sim->countTravel - sim->gateTravel;
+  }
+
+  /* A zero gap would schedule every arrival at the same instant forever */
+  if (sim->arrivalGap == 0)
+  {
+    sim->arrivalGap = 1;
+  }
+
+  /* A shard is always part of the plant it is staggered across */
+  if (sim->params.plantLanes < params->firstLane + params->lanes)
+  {
+    sim->params.plantLanes = params->firstLane + params->lanes;
+  }
+
+  sim->lane  = calloc(params->lanes, sizeof(sim_lane_t));
+  sim->queue = malloc(SIM_QUEUE_START * sizeof(sim_event_t));
+  if (sim->lane == NULL || sim->queue == NULL)
+  {
+    simFree(sim);
+    return -1;
+  }
+  sim->queueCap = SIM_QUEUE_START;
+
+  for (lane = 0; lane < params->lanes; lane++)
+  {
+    if (simNextArrival(sim, lane, 0, TRUE) != 0)
+    {
+      simFree(sim);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Releases the memory held by a simulation
+ *
+ * @param sim - simulation to free
+ */
+void simFree(sim_t *sim)
+{
+  free(sim->queue);
+  free(sim->lane);
+  sim->queue = NULL;
+  sim->lane  = NULL;
+  sim->queueLen = 0;
+  sim->queueCap = 0;
+}
+
+/**
+ * @brief Processes every event due before end, then leaves the virtual
+ *        clock at end
+ *
+ * @param sim - simulation to run
+ * @param end - virtual time to stop at
+ */
+void simRunUntil(sim_t *sim, sim_time_t end)
+{
+  sim_event_t ev;
+
+  while (sim->queueLen > 0 && sim->queue[0].time < end)
+  {
+    simPop(sim, &ev);
+    sim->now = ev.time;
+    simHandle(sim, &ev);
+    sim->stats.events++;
+  }
+  sim->now = end;
+}
+
+/**
+ * @brief Runs the simulation for a period of virtual time
+ *
+ * @param sim      - simulation to run
+ * @param duration - virtual time to run for
+ */
+void simRunFor(sim_t *sim, sim_time_t duration)
+{
+  simRunUntil(sim, sim->now + duration);
+}
+
+
+// Local functions
+
+/**
+ * @brief Converts a controller delay to virtual time. With a tick rate the
+ *        delay is truncated to whole ticks, as wdStart and taskDelay do with
+ *        seconds * sysClkRateGet().
+ *
+ * @param seconds  - delay in seconds
+ * @param tickRate - ticks per second, 0 for no quantisation
+ * @return sim_time_t - delay in virtual time
+ */
+static sim_time_t simTimerDelay(double seconds, double tickRate)
+{
+  if (tickRate > 0)
+  {
+    return SIM_SECONDS((int)(seconds * tickRate) / tickRate);
+  }
+  return SIM_SECONDS(seconds);
+}
+
+/**
+ * @brief Orders two events, earliest first then by type and insertion order
+ *
+ * @return int - non zero when a should be handled before b
+ */
+static inline int simBefore(const sim_event_t *a, const sim_event_t *b)
+{
+  if (a->time != b->time)
+  {
+    return a->time < b->time;
+  }
+  if (a->type != b->type)
+  {
+    return a->type < b->type;
+  }
+  return (int32_t)(a->seq - b->seq) < 0;
+}
+
+/**
+ * @brief Adds an event to the queue, doubling the queue when full
+ *
+ * @return int - 0 on success, -1 if the queue could not grow
+ */
+static int simPush(sim_t *sim, sim_time_t time, int type, int lane, int size)
+{
+  sim_event_t ev;
+  uint32_t pos;
+  uint32_t parent;
+
+  if (sim->queueLen == sim->queueCap)
+  {
+    sim_event_t *grown = realloc(sim->queue, 2 * sim->queueCap * sizeof(sim_event_t));
+    if (grown == NULL)
+    {
+      return -1;
+    }
+    sim->queue = grown;
+    sim->queueCap *= 2;
+  }
+
+  ev.time = time;
+  ev.seq  = sim->seq++;
+  ev.type = type;
+  ev.size = size;
+  ev.lane = lane;
+
+  /* Sift up */
+  pos = sim->queueLen++;
+  while (pos > 0)
+  {
+    parent = (pos - 1) / 2;
+    if (!simBefore(&ev, &sim->queue[parent]))
+    {
+      break;
+    }
+    sim->queue[pos] = sim->queue[parent];
+    pos = parent;
+  }
+  sim->queue[pos] = ev;
+  return 0;
+}
+
+/**
+ * @brief Removes the earliest event from the queue
+ *
+ * @param ev - filled with the removed event
+ */
+static void simPop(sim_t *sim, sim_event_t *ev)
+{
+  sim_event_t last;
+  uint32_t pos = 0;
+  uint32_t child;
+
+  *ev  = sim->queue[0];
+  last = sim->queue[--sim->queueLen];
+
+  /* Sift down */
+  while ((child = 2 * pos + 1) < sim->queueLen)
+  {
+    if (child + 1 < sim->queueLen && simBefore(&sim->queue[child + 1], &sim->queue[child]))
+    {
+      child++;
+    }
+    if (!simBefore(&sim->queue[child], &last))
+    {
+      break;
+    }
+    sim->queue[pos] = sim->queue[child];
+    pos = child;
+  }
+  sim->queue[pos] = last;
+}
+
+/**
+ * @brief Schedules the next block on a lane, from the arrival callback when
+ *        there is one. Without one, plant lanes are staggered across the first gap
+ *        and then get a block every arrivalGap.
+ *
+ * @param sim   - simulation
+ * @param lane  - simulation lane number
+ * @param now   - current time, the next block can't arrive before it
+ * @param first - TRUE for the lane's first block
+ * @return int - 0 on success, -1 if the queue could not grow
+ */
+static int simNextArrival(sim_t *sim, int lane, sim_time_t now, int first)
+{
+  sim_time_t next;
+
+  if (sim->ops->arrival != NULL)
+  {
+    next = sim->ops->arrival(sim->arg, sim->params.firstLane + lane, now);
+    if (next == SIM_NEVER)
+    {
+      return 0;
+    }
+    if (next < now)
+    {
+      next = now;
+    }
+  }
+  else if (first == TRUE)
+  {
+    // By plant lane, so the plant is the same however it is sharded
+    next = now + (sim->arrivalGap * (sim->params.firstLane + lane)) /
+                 sim->params.plantLanes;
+  }
+  else
+  {
+    next = now + sim->arrivalGap;
+  }
+  return simPush(sim, next, EV_ARRIVAL, lane, SIZE_NONE);
+}
+
+/**
+ * @brief Applies one event to the plant and schedules whatever follows it
+ *
+ * @param sim - simulation the event belongs to
+ * @param ev  - event to handle
+ */
+static void simHandle(sim_t *sim, const sim_event_t *ev)
+{
+  sim_lane_t *lane = &sim->lane[ev->lane];
+  int plantLane = sim->params.firstLane + ev->lane;
+  sim_time_t now = ev->time;
+  sim_time_t seen;
+  int size;
+
+  switch (ev->type)
+  {
+  /* Block at the size sensors, controller detects it and arms its timers */
+  case EV_ARRIVAL:
+    size = sim->ops->detect(sim->arg, plantLane);
+    simNextArrival(sim, ev->lane, now, FALSE);
+
+    /* A polling controller only sees the block at its next poll */
+    seen = now;
+    if (sim->pollPeriod > 0)
+    {
+      seen = ((now + sim->pollPeriod - 1) / sim->pollPeriod) * sim->pollPeriod;
+    }
+
+    if (size == SIZE_SMALL)
+    {
+      sim->stats.small++;
+      simPush(sim, seen + sim->gateDelay, EV_GATE_CLOSE, ev->lane, size);
+      simPush(sim, seen + sim->gateDelay + sim->gateClose, EV_GATE_OPEN, ev->lane, size);
+    }
+    else if (size == SIZE_BIG)
+    {
+      sim->stats.big++;
+      simPush(sim, seen + sim->countDelay, EV_COUNT_READ, ev->lane, size);
+    }
+    else
+    {
+      /* Empty slot on the belt */
+      break;
+    }
+    sim->stats.blocks++;
+    simPush(sim, now + sim->gateTravel, EV_GATE_REACH, ev->lane, size);
+    break;
+
+  /* Overlapping close windows keep the gate closed until the last one ends */
+  case EV_GATE_CLOSE:
+    if (lane->gateDepth++ == 0)
+    {
+      sim->ops->gate(sim->arg, plantLane, TRUE);
+    }
+    break;
+
+  case EV_GATE_OPEN:
+    if (--lane->gateDepth == 0)
+    {
+      sim->ops->gate(sim->arg, plantLane, FALSE);
+    }
+    break;
+
+  /* Closed gate pushes the block off, otherwise it carries on to the end */
+  case EV_GATE_REACH:
+    if (lane->gateDepth > 0)
+    {
+      if (ev->size == SIZE_SMALL)
+      {
+        sim->stats.sorted++;
+      }
+      else
+      {
+        sim->stats.missorted++;
+      }
+    }
+    else
+    {
+      if (ev->size == SIZE_SMALL)
+      {
+        sim->stats.missedGates++;
+      }
+      simPush(sim, now + sim->gateToCount, EV_COUNT_HIT, ev->lane, ev->size);
+    }
+    break;
+
+  case EV_COUNT_HIT:
+    lane->countLatch++;
+    break;
+
+  case EV_COUNT_READ:
+    if (lane->countLatch > 0)
+    {
+      lane->countLatch--;
+      sim->stats.collected++;
+      sim->ops->collect(sim->arg, plantLane);
+    }
+    else
+    {
+      sim->stats.missedCounts++;
+    }
+    break;
+
+  default:
+    break;
+  }
+}
@@ -0,0 +1,477 @@
+/*
+ * ****************************************************************************
+ * File           : sweep.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Parameter sweep harness. Every plant is a separate
+ *                  simulation with its own generator, so plants run on the
+ *                  worker threads without sharing anything but the results
+ *                  table, where each plant writes only its own row.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//Project Header Files
+#include "../inc/config.h"
+#include "../inc/rng.h"
+#include "../inc/sim.h"
+#include "../inc/sweep.h"
+#include "../inc/workers.h"
+#include "../inc/workload.h"
+/* !SECTION Includes */
+
+/* Upper limit on plants in one sweep */
+#define SWEEP_MAX_PLANTS 10000000
+
+/* Names used in spec files and the results header */
+static const char paramNames[NUM_SWEEP_PARAMS][12] = {
+  {"gate_delay"}, {"gate_close"}, {"count_delay"},
+  {"task_delay"}, {"clock_rate"}, {"arrival_gap"}
+};
+
+/* Results of one plant */
+typedef struct
+{
+  double      value[NUM_SWEEP_PARAMS];
+  uint64_t    seed;
+  sim_stats_t stats;
+} __attribute__((aligned(CACHE_LINE))) sweep_result_t;
+
+/* Blocks of one plant when the sweep has a workload */
+typedef struct
+{
+  workload_t wl;
+  wl_lane_t  lane[MAX_LANES];
+  int        size[MAX_LANES]; /* size of each lane's next block */
+} sweep_plant_t;
+
+/* Everything a worker needs to run its plants */
+typedef struct
+{
+  const sweep_spec_t *spec;
+  int steps[NUM_SWEEP_PARAMS];
+  sweep_result_t *result;
+  int failed;
+} sweep_batch_t;
+
+// Function Decleration
+static int  sweepRangeOk(int param, double start, double stop, double step);
+static int  sweepSteps(const sweep_range_t *range);
+static void sweepJob(void *arg, int job);
+static int  sweepDetect(void *arg, int lane);
+static sim_time_t sweepArrival(void *arg, int lane, sim_time_t now);
+static int  sweepPlaced(void *arg, int lane);
+static void sweepCollect(void *arg, int lane);
+static void sweepGate(void *arg, int lane, int closed);
+
+static const sim_ops_t sweepOps = {NULL, sweepDetect, sweepCollect, sweepGate};
+static const sim_ops_t workloadOps = {sweepArrival, sweepPlaced, sweepCollect, sweepGate};
+
+
+// Global functions
+
+/**
+ * @brief Fills a spec with a single plant using the values in config.h
+ *
+ * @param spec - spec to fill
+ */
+void sweepDefaults(sweep_spec_t *spec)
+{
+  const double defaults[NUM_SWEEP_PARAMS] = {
+    GATE_DELAY, GATE_CLOSE, COUNT_DELAY, TASK_DELAY, CLOCK_RATE, SIM_ARRIVAL_GAP
+  };
+  int param;
+
+  for (param = 0; param < NUM_SWEEP_PARAMS; param++)
+  {
+    spec->range[param].start = defaults[param];
+    spec->range[param].stop  = defaults[param];
+    spec->range[param].step  = 0;
+  }
+  spec->seeds    = 1;
+  spec->lanes    = DEFAULT_LANES;
+  spec->duration = SWEEP_DURATION;
+  spec->seed     = DEFAULT_SEED;
+  spec->useWorkload = FALSE;
+}
+
+/**
+ * @brief Reads a sweep spec file on top of the defaults. Each line is one of
+ *
+ *          <param> start [stop step]   param from paramNames
+ *          seeds <n>                   plants per tuple
+ *          lanes <n>                   lanes per plant
+ *          duration <seconds>          virtual time per plant
+ *          seed <n>                    first seed
+ *          workload <spec>             blocks from a workload, see
+ *                                      workloadParse, its gap is used as
+ *                                      arrival_gap unless that is given
+ *
+ *        Blank lines and lines starting with # are ignored. Ranges must be
+ *        finite, not negative and not run backwards, clock_rate must be
+ *        above 0 and arrival_gap at least the longest poll period (and one
+ *        clock tick), or a plant would spend its time placing blocks.
+ *
+ * @param spec - spec to fill
+ * @param path - spec file
+ * @return int - 0 on success, -1 if the file can't be read or has a bad line
+ */
+int sweepLoad(sweep_spec_t *spec, const char *path)
+{
+  char line[128];
+  char name[32];
+  char text[sizeof(line)];
+  double a, b, c;
+  double minGap;
+  int gapGiven = FALSE;
+  int lineNum = 0;
+  int fields;
+  int param;
+  FILE *file;
+
+  sweepDefaults(spec);
+
+  file = fopen(path, "r");
+  if (file == NULL)
+  {
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    lineNum++;
+    fields = sscanf(line, "%31s %lf %lf %lf", name, &a, &b, &c);
+    if (fields < 1 || name[0] == '#')
+    {
+      continue;
+    }
+
+    for (param = 0; param < NUM_SWEEP_PARAMS; param++)
+    {
+      if (strcmp(name, paramNames[param]) == 0)
+      {
+        break;
+      }
+    }
+
+    if (param < NUM_SWEEP_PARAMS && (fields == 2 || fields == 4) &&
+        sweepRangeOk(param, a, (fields == 4) ? b : a, (fields == 4) ? c : 0))
+    {
+      gapGiven |= (param == SWEEP_ARRIVAL_GAP);
+      spec->range[param].start = a;
+      spec->range[param].stop  = (fields == 4) ? b : a;
+      spec->range[param].step  = (fields == 4) ? c : 0;
+    }
+    else if (strcmp(name, "seeds") == 0 && fields == 2 && a >= 1)
+    {
+      spec->seeds = a;
+    }
+    else if (strcmp(name, "lanes") == 0 && fields == 2 && a >= 1 && a <= MAX_LANES)
+    {
+      spec->lanes = a;
+    }
+    else if (strcmp(name, "duration") == 0 && fields == 2 && a > 0)
+    {
+      spec->duration = a;
+    }
+    else if (strcmp(name, "seed") == 0 && fields == 2)
+    {
+      spec->seed = a;
+    }
+    else if (strcmp(name, "workload") == 0 && spec->useWorkload == FALSE &&
+             sscanf(line, "%*s %127s", text) == 1 && workloadParse(&spec->workload, text) == 0)
+    {
+      spec->useWorkload = TRUE;
+    }
+    else
+    {
+      fprintf(stderr, "%s:%d: bad sweep line\n", path, lineNum);
+      fclose(file);
+      sweepFree(spec);
+      return -1;
+    }
+  }
+
+  if (spec->useWorkload == TRUE && gapGiven == FALSE)
+  {
+    spec->range[SWEEP_ARRIVAL_GAP].start = spec->workload.gap;
+    spec->range[SWEEP_ARRIVAL_GAP].stop  = spec->workload.gap;
+    spec->range[SWEEP_ARRIVAL_GAP].step  = 0;
+  }
+
+  // Slowest polling is the longest task_delay at the lowest clock_rate
+  minGap = fmax(spec->range[SWEEP_TASK_DELAY].stop, 1) / spec->range[SWEEP_CLOCK_RATE].start;
+  if (!(spec->range[SWEEP_ARRIVAL_GAP].start >= minGap))
+  {
+    fprintf(stderr, "%s: arrival_gap %g s is below the %g s poll period\n",
+            path, spec->range[SWEEP_ARRIVAL_GAP].start, minGap);
+    fclose(file);
+    sweepFree(spec);
+    return -1;
+  }
+
+  fclose(file);
+  return 0;
+}
+
+/**
+ * @brief Releases anything sweepLoad opened for the spec
+ *
+ * @param spec - spec to free
+ */
+void sweepFree(sweep_spec_t *spec)
+{
+  if (spec->useWorkload == TRUE)
+  {
+    workloadFree(&spec->workload);
+    spec->useWorkload = FALSE;
+  }
+}
+
+/**
+ * @brief Runs every plant in the sweep on the worker threads and writes one
+ *        CSV row per plant to out, followed by a summary on stderr
+ *
+ * @param spec - sweep to run
+ * @param out  - results file
+ * @return int - 0 on success, -1 if the sweep is too big or a plant failed
+ */
+int sweepRun(const sweep_spec_t *spec, FILE *out)
+{
+  sweep_batch_t batch;
+  sweep_result_t *result;
+  struct timespec start;
+  struct timespec stop;
+  double wall;
+  double plants = spec->seeds;
+  double wrong;
+  uint64_t blocks = 0;
+  int param;
+  int job;
+
+  memset(&batch, 0, sizeof(batch));
+  batch.spec = spec;
+  for (param = 0; param < NUM_SWEEP_PARAMS; param++)
+  {
+    batch.steps[param] = sweepSteps(&spec->range[param]);
+    plants *= batch.steps[param];
+  }
+  if (plants > SWEEP_MAX_PLANTS)
+  {
+    fprintf(stderr, "Sweep of %.0f plants is over the limit of %d\n", plants, SWEEP_MAX_PLANTS);
+    return -1;
+  }
+
+  batch.result = aligned_alloc(CACHE_LINE, (size_t)plants * sizeof(sweep_result_t));
+  if (batch.result == NULL)
+  {
+    return -1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  workersRun(sweepJob, &batch, (int)plants);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  wall = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+  for (param = 0; param < NUM_SWEEP_PARAMS; param++)
+  {
+    fprintf(out, "%s,", paramNames[param]);
+  }
+  fprintf(out, "seed,blocks,accuracy,missed_gates,missorted,missed_counts,throughput\n");
+
+  for (job = 0; job < (int)plants; job++)
+  {
+    result = &batch.result[job];
+    blocks += result->stats.blocks;
+
+    // Wrong when a small block passes its gate or a big block is pushed off,
+    // blocks still on the belt at the end count as right
+    wrong = result->stats.missedGates + result->stats.missorted;
+
+    for (param = 0; param < NUM_SWEEP_PARAMS; param++)
+    {
+      fprintf(out, "%g,", result->value[param]);
+    }
+    fprintf(out, "%llu,%llu,%.6f,%llu,%llu,%llu,%.3f\n",
+            (unsigned long long)result->seed,
+            (unsigned long long)result->stats.blocks,
+            result->stats.blocks ? 1.0 - wrong / result->stats.blocks : 1.0,
+            (unsigned long long)result->stats.missedGates,
+            (unsigned long long)result->stats.missorted,
+            (unsigned long long)result->stats.missedCounts,
+            (result->stats.blocks - wrong) / spec->duration);
+  }
+
+  fprintf(stderr, "%.0f plants, %llu blocks in %.3f s on %d workers (%.2f M blocks/s)\n",
+          plants, (unsigned long long)blocks, wall, workersCount(), blocks / wall / 1e6);
+
+  free(batch.result);
+  return (batch.failed == FALSE) ? 0 : -1;
+}
+
+
+// Local functions
+
+/**
+ * @brief Checks a parameter range can be swept. Written so NaN fails too.
+ *
+ * @return int - TRUE if the range is usable
+ */
+static int sweepRangeOk(int param, double start, double stop, double step)
+{
+  if (!isfinite(start) || !isfinite(stop) || !isfinite(step) ||
+      !(start >= 0) || !(step >= 0) || !(stop >= start))
+  {
+    return FALSE;
+  }
+  // The poll period is task_delay / clock_rate, and blocks must be apart
+  return ((param != SWEEP_CLOCK_RATE && param != SWEEP_ARRIVAL_GAP) || start > 0) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Number of values in a range, a zero step gives just the start
+ *
+ */
+static int sweepSteps(const sweep_range_t *range)
+{
+  if (range->step <= 0 || range->stop <= range->start)
+  {
+    return 1;
+  }
+  // Small allowance so stop is included despite rounding
+  return (int)((range->stop - range->start) / range->step + 1e-9) + 1;
+}
+
+/**
+ * @brief Worker job, builds and runs the plant for one tuple and seed
+ *
+ * @param arg - sweep_batch_t
+ * @param job - plant number, seed varies fastest then the parameters in
+ *              SweepParams order
+ */
+static void sweepJob(void *arg, int job)
+{
+  sweep_batch_t *batch = arg;
+  const sweep_spec_t *spec = batch->spec;
+  sweep_result_t *result = &batch->result[job];
+  sim_params_t params;
+  sim_t sim;
+  rng_t rng;
+  sweep_plant_t plant;
+  int index = job / spec->seeds;
+  int param;
+  int lane;
+  int status;
+
+  for (param = 0; param < NUM_SWEEP_PARAMS; param++)
+  {
+    result->value[param] = spec->range[param].start + spec->range[param].step * (index % batch->steps[param]);
+    index /= batch->steps[param];
+  }
+  result->seed = spec->seed + job;
+
+  // Belt keeps the config.h timing, the controller gets the tuple
+  simDefaultParams(&params);
+  params.gateDelay  = result->value[SWEEP_GATE_DELAY];
+  params.gateClose  = result->value[SWEEP_GATE_CLOSE];
+  params.countDelay = result->value[SWEEP_COUNT_DELAY];
+  params.tickRate   = result->value[SWEEP_CLOCK_RATE];
+  params.pollPeriod = result->value[SWEEP_TASK_DELAY] / result->value[SWEEP_CLOCK_RATE];
+  params.arrivalGap = result->value[SWEEP_ARRIVAL_GAP];
+  params.lanes      = spec->lanes;
+  params.plantLanes = spec->lanes;
+
+  if (spec->useWorkload == TRUE)
+  {
+    plant.wl = spec->workload;
+    plant.wl.gap = params.arrivalGap;
+    for (lane = 0; lane < spec->lanes; lane++)
+    {
+      workloadLaneInit(&plant.wl, &plant.lane[lane], lane, result->seed);
+    }
+    status = simInit(&sim, &params, &workloadOps, &plant);
+  }
+  else
+  {
+    rngSeed(&rng, result->seed);
+    status = simInit(&sim, &params, &sweepOps, &rng);
+  }
+  if (status != 0)
+  {
+    batch->failed = TRUE;
+    memset(&result->stats, 0, sizeof(result->stats));
+    return;
+  }
+  simRunFor(&sim, SIM_SECONDS(spec->duration));
+  result->stats = sim.stats;
+  simFree(&sim);
+}
+
+/**
+ * @brief Plant size sensor, the same mix as the simulated interface: one in
+ *        ten slots empty, the rest split between big and small
+ *
+ */
+static int sweepDetect(void *arg, int lane)
+{
+  uint32_t value = rngBelow(arg, 10);
+
+  if (value == 9)
+  {
+    return SIZE_NONE;
+  }
+  return (value % 2 == 0) ? SIZE_BIG : SIZE_SMALL;
+}
+
+/**
+ * @brief Plant with a workload, takes the lane's next block from its stream
+ *
+ * @return sim_time_t - time of the block, SIM_NEVER when the lane has no more
+ */
+static sim_time_t sweepArrival(void *arg, int lane, sim_time_t now)
+{
+  sweep_plant_t *plant = arg;
+  double time;
+
+  if (workloadNext(&plant->wl, &plant->lane[lane], &time, &plant->size[lane]) != 0)
+  {
+    return SIM_NEVER;
+  }
+  return SIM_SECONDS(time);
+}
+
+/**
+ * @brief Plant size sensor with a workload, sees the block sweepArrival
+ *        generated
+ *
+ */
+static int sweepPlaced(void *arg, int lane)
+{
+  sweep_plant_t *plant = arg;
+
+  return plant->size[lane];
+}
+
+/**
+ * @brief Plant count sensor, the engine's statistics already record it
+ *
+ */
+static void sweepCollect(void *arg, int lane)
+{
+}
+
+/**
+ * @brief Plant gate, the engine's statistics already record it
+ *
+ */
+static void sweepGate(void *arg, int lane, int closed)
+{
+}
@@ -0,0 +1,273 @@
+/*
+ * ****************************************************************************
+ * File           : trace.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Maps sensor traces into memory for replay and records
+ *                  new ones. Replay never copies or reads the file, samples
+ *                  are served directly from the mapping.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//Project Header Files
+#include "../inc/trace.h"
+/* !SECTION Includes */
+
+/* Samples a lane's buffer starts with when recording */
+#define TRACE_WRITER_START 1024
+
+
+// Global functions
+
+/**
+ * @brief Maps a trace file read only and checks its header and lane table
+ *
+ * @param trace - filled with the mapped trace
+ * @param path  - trace file
+ * @return int - 0 on success, -1 if the file can't be mapped or is not a
+ *               valid trace
+ */
+int traceOpen(trace_t *trace, const char *path)
+{
+  struct stat st;
+  const trace_header_t *header;
+  const trace_lane_t *lane;
+  size_t tableEnd;
+  int fd;
+  int l;
+
+  memset(trace, 0, sizeof(*trace));
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(trace_header_t))
+  {
+    close(fd);
+    return -1;
+  }
+
+  trace->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (trace->map == MAP_FAILED)
+  {
+    trace->map = NULL;
+    return -1;
+  }
+  trace->length = st.st_size;
+  madvise(trace->map, trace->length, MADV_SEQUENTIAL);
+
+  header = trace->map;
+  lane = (const trace_lane_t *)(header + 1);
+  tableEnd = sizeof(trace_header_t) + header->lanes * sizeof(trace_lane_t);
+
+  if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION ||
+      header->tickUs == 0 || tableEnd > trace->length)
+  {
+    traceClose(trace);
+    return -1;
+  }
+
+  // Every lane's samples must lie inside the file and be aligned
+  for (l = 0; l < header->lanes; l++)
+  {
+    if (lane[l].offset < tableEnd || lane[l].offset > trace->length ||
+        lane[l].offset % sizeof(trace_sample_t) != 0 ||
+        lane[l].count > (trace->length - lane[l].offset) / sizeof(trace_sample_t))
+    {
+      traceClose(trace);
+      return -1;
+    }
+  }
+
+  trace->header = header;
+  trace->lane = lane;
+  return 0;
+}
+
+/**
+ * @brief Unmaps a trace opened with traceOpen
+ *
+ * @param trace - trace to close
+ */
+void traceClose(trace_t *trace)
+{
+  if (trace->map != NULL)
+  {
+    munmap(trace->map, trace->length);
+  }
+  memset(trace, 0, sizeof(*trace));
+}
+
+/**
+ * @brief Gets a lane's samples, pointing into the mapped file
+ *
+ * @param trace - open trace
+ * @param lane  - lane number
+ * @param count - set to the number of samples
+ * @return const trace_sample_t* - first sample, NULL if the lane is not in
+ *                                 the trace
+ */
+const trace_sample_t *traceSamples(const trace_t *trace, int lane, uint64_t *count)
+{
+  if (trace->header == NULL || lane < 0 || lane >= trace->header->lanes)
+  {
+    *count = 0;
+    return NULL;
+  }
+  *count = trace->lane[lane].count;
+  return (const trace_sample_t *)((const char *)trace->map + trace->lane[lane].offset);
+}
+
+/**
+ * @brief Starts recording a new trace
+ *
+ * @param writer - writer to set up
+ * @param lanes  - number of lanes in the trace
+ * @param tickUs - microseconds per timestamp tick
+ * @return int - 0 on success, -1 if out of memory
+ */
+int traceWriterInit(trace_writer_t *writer, int lanes, uint32_t tickUs)
+{
+  memset(writer, 0, sizeof(*writer));
+  writer->lanes    = lanes;
+  writer->tickUs   = (tickUs > 0) ? tickUs : 1;
+  writer->sample   = calloc(lanes, sizeof(trace_sample_t *));
+  writer->count    = calloc(lanes, sizeof(uint64_t));
+  writer->capacity = calloc(lanes, sizeof(uint64_t));
+
+  if (writer->sample == NULL || writer->count == NULL || writer->capacity == NULL)
+  {
+    traceWriterFree(writer);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Adds a sample to a lane. Lanes are independent, so different lanes
+ *        may be recorded from different threads.
+ *
+ * @param writer - trace being recorded
+ * @param lane   - lane the sample belongs to
+ * @param timeUs - sample time in microseconds
+ * @param valid  - which sensors were read, TRACE_SIZE and/or TRACE_COUNT
+ * @param size   - size sensor value
+ * @param count  - count sensor value
+ * @return int - 0 on success, -1 if out of memory or lane out of range
+ */
+int traceWriterAdd(trace_writer_t *writer, int lane, uint64_t timeUs, int valid, int size, int count)
+{
+  trace_sample_t *sample;
+
+  if (lane < 0 || lane >= writer->lanes)
+  {
+    return -1;
+  }
+
+  if (writer->count[lane] == writer->capacity[lane])
+  {
+    uint64_t capacity = writer->capacity[lane] ? 2 * writer->capacity[lane] : TRACE_WRITER_START;
+    trace_sample_t *grown = realloc(writer->sample[lane], capacity * sizeof(trace_sample_t));
+    if (grown == NULL)
+    {
+      return -1;
+    }
+    writer->sample[lane] = grown;
+    writer->capacity[lane] = capacity;
+  }
+
+  sample = &writer->sample[lane][writer->count[lane]++];
+  sample->time     = timeUs / writer->tickUs;
+  sample->size     = size;
+  sample->count    = count;
+  sample->valid    = valid;
+  memset(sample->reserved, 0, sizeof(sample->reserved));
+  return 0;
+}
+
+/**
+ * @brief Writes the recorded samples out as a trace file
+ *
+ * @param writer - trace being recorded
+ * @param path   - file to create
+ * @return int - 0 on success, -1 on a file error
+ */
+int traceWriterSave(const trace_writer_t *writer, const char *path)
+{
+  trace_header_t header;
+  trace_lane_t lane;
+  uint64_t offset;
+  FILE *file;
+  int l;
+  int ok = 1;
+
+  file = fopen(path, "wb");
+  if (file == NULL)
+  {
+    return -1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  header.magic   = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.lanes   = writer->lanes;
+  header.tickUs  = writer->tickUs;
+  ok &= fwrite(&header, sizeof(header), 1, file) == 1;
+
+  // Lane table, samples follow it in lane order
+  offset = sizeof(header) + writer->lanes * sizeof(trace_lane_t);
+  for (l = 0; l < writer->lanes; l++)
+  {
+    lane.offset = offset;
+    lane.count  = writer->count[l];
+    ok &= fwrite(&lane, sizeof(lane), 1, file) == 1;
+    offset += writer->count[l] * sizeof(trace_sample_t);
+  }
+
+  for (l = 0; l < writer->lanes; l++)
+  {
+    if (writer->count[l] > 0)
+    {
+      ok &= fwrite(writer->sample[l], sizeof(trace_sample_t), writer->count[l], file) == writer->count[l];
+    }
+  }
+
+  ok &= fclose(file) == 0;
+  return ok ? 0 : -1;
+}
+
+/**
+ * @brief Frees a trace writer's buffers
+ *
+ * @param writer - writer to free
+ */
+void traceWriterFree(trace_writer_t *writer)
+{
+  int l;
+
+  if (writer->sample != NULL)
+  {
+    for (l = 0; l < writer->lanes; l++)
+    {
+      free(writer->sample[l]);
+    }
+  }
+  free(writer->sample);
+  free(writer->count);
+  free(writer->capacity);
+  memset(writer, 0, sizeof(*writer));
+}
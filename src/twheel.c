@@ -0,0 +1,312 @@
+/*
+ * ****************************************************************************
+ * File           : twheel.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Hierarchical timing wheel, see twheel.h. Level 0 has a
+ *                  slot per tick, each higher level a slot per turn of the
+ *                  level below. When a level wraps, the next slot of the
+ *                  level above is cascaded down into it. Timers come from a
+ *                  fixed pool so starting one never allocates.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <stdlib.h>
+#include <string.h>
+
+//Project Header Files
+#include "../inc/config.h"
+#include "../inc/twheel.h"
+/* !SECTION Includes */
+
+/* Ticks the top level reaches */
+#define TW_SPAN ((tw_tick_t)1 << (TW_BITS * TW_LEVELS))
+
+// Function Decleration
+static void twPlace(twheel_t *tw, tw_timer_t *timer);
+static void twUnlink(tw_timer_t *timer);
+static void twRelease(twheel_t *tw, tw_timer_t *timer);
+static void twCascade(twheel_t *tw, int level);
+
+
+// Global functions
+
+/**
+ * @brief Sets up an empty wheel
+ *
+ * @param tw     - wheel to initialise
+ * @param timers - most timers running at once
+ * @param now    - current tick
+ * @return int - 0 on success, -1 if the pool could not be allocated
+ */
+int twInit(twheel_t *tw, int timers, tw_tick_t now)
+{
+  int level;
+  int slot;
+  int timer;
+
+  memset(tw, 0, sizeof(*tw));
+  tw->pool = calloc(timers, sizeof(tw_timer_t));
+  if (tw->pool == NULL)
+  {
+    return -1;
+  }
+  tw->timers = timers;
+  tw->now = now;
+
+  for (level = 0; level < TW_LEVELS; level++)
+  {
+    for (slot = 0; slot < TW_SLOTS; slot++)
+    {
+      tw->slot[level][slot].next = &tw->slot[level][slot];
+      tw->slot[level][slot].prev = &tw->slot[level][slot];
+    }
+  }
+  for (timer = 0; timer < timers; timer++)
+  {
+    tw->pool[timer].next = (timer + 1 < timers) ? &tw->pool[timer + 1] : NULL;
+  }
+  tw->freeList = tw->pool;
+
+  pthread_mutex_init(&tw->lock, NULL);
+  return 0;
+}
+
+/**
+ * @brief Drops every running timer and frees the pool
+ *
+ * @param tw - wheel to free
+ */
+void twFree(twheel_t *tw)
+{
+  pthread_mutex_destroy(&tw->lock);
+  free(tw->pool);
+  tw->pool = NULL;
+  tw->freeList = NULL;
+  tw->active = 0;
+}
+
+/**
+ * @brief Starts a one-shot timer, fn(arg) is called from twAdvance when the
+ *        wheel reaches now + delay
+ *
+ * @param tw    - wheel
+ * @param delay - ticks from now, 0 fires on the next advance
+ * @param fn    - called when the timer expires
+ * @param arg   - passed to fn
+ * @return tw_handle_t - timer NULL if every timer in the pool is running
+ */
+tw_handle_t twStart(twheel_t *tw, tw_tick_t delay, tw_fn_t fn, int arg)
+{
+  tw_handle_t handle = {NULL, 0};
+  tw_timer_t *timer;
+
+  pthread_mutex_lock(&tw->lock);
+  timer = tw->freeList;
+  if (timer != NULL)
+  {
+    tw->freeList = timer->next;
+    tw->active++;
+
+    // Due now goes in the next tick's slot, never one already passed
+    timer->expires = tw->now + ((delay > 0) ? delay : 1);
+    timer->fn  = fn;
+    timer->arg = arg;
+    twPlace(tw, timer);
+
+    handle.timer = timer;
+    handle.gen   = timer->gen;
+  }
+  pthread_mutex_unlock(&tw->lock);
+  return handle;
+}
+
+/**
+ * @brief Stops a timer before it fires
+ *
+ * @param tw     - wheel
+ * @param handle - from twStart
+ * @return int - 0 if the timer was stopped, -1 if it already fired or was
+ *               cancelled
+ */
+int twCancel(twheel_t *tw, tw_handle_t handle)
+{
+  int result = -1;
+
+  if (handle.timer == NULL)
+  {
+    return -1;
+  }
+
+  pthread_mutex_lock(&tw->lock);
+  if (handle.timer->gen == handle.gen)
+  {
+    twUnlink(handle.timer);
+    twRelease(tw, handle.timer);
+    result = 0;
+  }
+  pthread_mutex_unlock(&tw->lock);
+  return result;
+}
+
+/**
+ * @brief Turns the wheel to now, firing every timer due on the way in
+ *        deadline order. Callbacks run without the wheel locked, so they may
+ *        start or cancel timers. A late call catches up on every tick missed.
+ *
+ * @param tw  - wheel
+ * @param now - current tick
+ * @return int - number of timers fired
+ */
+int twAdvance(twheel_t *tw, tw_tick_t now)
+{
+  tw_timer_t *head;
+  tw_timer_t *timer;
+  tw_fn_t fn;
+  int arg;
+  int level;
+  int fired = 0;
+
+  pthread_mutex_lock(&tw->lock);
+  while (tw->now < now)
+  {
+    tw->now++;
+
+    // Wrapped levels take the next slot of the level above, highest first
+    for (level = 1; level < TW_LEVELS; level++)
+    {
+      if ((tw->now & (((tw_tick_t)1 << (TW_BITS * level)) - 1)) != 0)
+      {
+        break;
+      }
+    }
+    while (--level > 0)
+    {
+      twCascade(tw, level);
+    }
+
+    head = &tw->slot[0][tw->now & (TW_SLOTS - 1)];
+    while ((timer = head->next) != head)
+    {
+      twUnlink(timer);
+      fn  = timer->fn;
+      arg = timer->arg;
+      twRelease(tw, timer);
+
+      pthread_mutex_unlock(&tw->lock);
+      fn(arg);
+      fired++;
+      pthread_mutex_lock(&tw->lock);
+    }
+  }
+  pthread_mutex_unlock(&tw->lock);
+  return fired;
+}
+
+/**
+ * @brief Number of timers running
+ *
+ */
+int twActive(twheel_t *tw)
+{
+  int active;
+
+  pthread_mutex_lock(&tw->lock);
+  active = tw->active;
+  pthread_mutex_unlock(&tw->lock);
+  return active;
+}
+
+
+// Local functions
+
+/**
+ * @brief Puts a timer in the slot for its deadline, the lowest level whose
+ *        span reaches it. Deadlines past the top level go in its furthest
+ *        slot and are placed again when it cascades.
+ *
+ */
+static void twPlace(twheel_t *tw, tw_timer_t *timer)
+{
+  tw_tick_t expires = timer->expires;
+  tw_tick_t delta;
+  tw_timer_t *head;
+  int level = 0;
+
+  if (expires < tw->now)
+  {
+    expires = tw->now;
+  }
+  delta = expires - tw->now;
+  if (delta >= TW_SPAN)
+  {
+    expires = tw->now + TW_SPAN - 1;
+    delta = TW_SPAN - 1;
+  }
+  while (delta >= ((tw_tick_t)1 << (TW_BITS * (level + 1))))
+  {
+    level++;
+  }
+
+  head = &tw->slot[level][(expires >> (TW_BITS * level)) & (TW_SLOTS - 1)];
+  timer->next = head;
+  timer->prev = head->prev;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+/**
+ * @brief Takes a timer out of its slot
+ *
+ */
+static void twUnlink(tw_timer_t *timer)
+{
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+}
+
+/**
+ * @brief Returns a timer to the pool, making its handles stale
+ *
+ */
+static void twRelease(twheel_t *tw, tw_timer_t *timer)
+{
+  timer->gen++;
+  timer->next = tw->freeList;
+  tw->freeList = timer;
+  tw->active--;
+}
+
+/**
+ * @brief Moves the timers in a level's current slot down to lower levels
+ *
+ * @param level - level that has come round to its next slot
+ */
+static void twCascade(twheel_t *tw, int level)
+{
+  tw_timer_t *head = &tw->slot[level][(tw->now >> (TW_BITS * level)) & (TW_SLOTS - 1)];
+  tw_timer_t list;
+  tw_timer_t *timer;
+
+  if (head->next == head)
+  {
+    return;
+  }
+
+  // Detach the whole slot first, timers may be placed back in it
+  list.next = head->next;
+  list.prev = head->prev;
+  list.next->prev = &list;
+  list.prev->next = &list;
+  head->next = head;
+  head->prev = head;
+
+  while ((timer = list.next) != &list)
+  {
+    twUnlink(timer);
+    twPlace(tw, timer);
+  }
+}
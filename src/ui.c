@@ -14,6 +14,8 @@
 #include <unistd.h>
 
 #include "../inc/config.h"
+#include "../inc/counters.h"
+#include "../inc/lanes.h"
 #include "../inc/ui.h"
 
 
@@ -38,17 +40,8 @@ const char uiCounterMenu[UI_COUNTER_ITEMS][UI_STRING_LENGTH] = {
   {"[4] All\n"}
 };
 
-const char uiConveyorMenu[UI_CONV_ITEMS][UI_STRING_LENGTH] = {
-  {"\n\nWhich conveyor(s)? (1-3):\n"},
-  {"------------------------------------\n"},
-  {"[1] Right Conveyor\n"},
-  {"[2] Left Conveyer\n"},
-  {"[3] Both Conveyors\n"},
-};
-
 extern int shutdown;
 extern int debug;
-extern counter_t counters;
 
 /**
  * @brief prints all options for the ui menu menuArray
@@ -67,6 +60,24 @@ void ui_printf(const char menuArray[][UI_STRING_LENGTH], int numOptions)
 }
 
 
+/**
+ * @brief prints the conveyor menu, one option per lane followed by an option
+ *        for all lanes
+ *
+ */
+void ui_conveyor_menu(void)
+{
+  int lane;
+
+  printf("\n\nWhich conveyor(s)? (1-%d):\n", numLanes + 1);
+  printf("------------------------------------\n");
+  for (lane = 0; lane < numLanes; lane++)
+  {
+    printf("[%d] %s Conveyor\n", lane + 1, laneName(lane));
+  }
+  printf("[%d] All Conveyors\n", numLanes + 1);
+}
+
 /**
  * @brief Handles user inputs for the main menu and returns the next menu level
  *
@@ -103,30 +114,46 @@ menu_t ui_main(int input)
 }
 
 /**
- * @brief prints all options for the ui menu menuArray
+ * @brief checks if a conveyor menu selection includes a lane
  *
- * @param menuArray  pointer to array of strings for menu options
- * @param numOptions  number of options in menuArray
+ * @param cnv  conveyor menu selection, 1 to numLanes or numLanes+1 for all
+ * @param lane lane to check
+ * @return int TRUE if lane was selected
+ */
+static int ui_selected(int cnv, int lane)
+{
+  return (cnv == lane + 1) || (cnv == numLanes + 1);
+}
+
+/**
+ * @brief prints the selected counters for the selected conveyor(s), all
+ *        from one snapshot
+ *
+ * @param ctr  counter menu selection
+ * @param cnv  conveyor menu selection
  */
 void ui_counter(int ctr, int cnv)
 {
+  counter_snap_t snap[MAX_LANES];
   int side;
-  for ( side = 0; side < 2; side++)
+
+  countersRead(snap);
+  for ( side = 0; side < numLanes; side++)
   {
-    if(cnv & (side+1))
+    if(ui_selected(cnv, side))
     {
-      printf("%s conveyor:\n", sideString[side]);
+      printf("%s conveyor:\n", laneName(side));
       if(ctr == SMALL || ctr == ALL)
       {
-        printf("%d small blocks\n", counters.small[side]);
+        printf("%llu small blocks\n", (unsigned long long)snap[side].value[CTR_SMALL]);
       }
       if(ctr == BIG || ctr == ALL)
       {
-        printf("%d big blocks\n", counters.big[side]);
+        printf("%llu big blocks\n", (unsigned long long)snap[side].value[CTR_BIG]);
       }
       if(ctr == COLLECTED || ctr == ALL)
       {
-        printf("%d blocks collected\n", counters.collected[side]);
+        printf("%llu blocks collected\n", (unsigned long long)snap[side].value[CTR_COLLECTED]);
       }
       //sleep(1);
     }
@@ -135,32 +162,40 @@ void ui_counter(int ctr, int cnv)
 
 
 /**
- * @brief prints all options for the ui menu menuArray
+ * @brief resets the selected counters for the selected conveyor(s), the
+ *        counting tasks carry on undisturbed
  *
- * @param menuArray  pointer to array of strings for menu options
- * @param numOptions  number of options in menuArray
+ * @param ctr  counter menu selection
+ * @param cnv  conveyor menu selection
  */
 void ui_reset(int ctr, int cnv)
 {
+  counter_snap_t snap[MAX_LANES];
+  unsigned mask = 0;
   int side;
-  for ( side = 0; side < 2; side++)
+
+  if (ctr >= SMALL && ctr <= ALL)
   {
-    if(cnv && (side+1))
+    mask = (ctr == ALL) ? CTR_ALL : 1u << (ctr - SMALL);
+  }
+  countersReadReset(snap, (cnv >= 1 && cnv <= numLanes) ? cnv - 1 : -1,
+                    (cnv >= 1 && cnv <= numLanes + 1) ? mask : 0);
+
+  for ( side = 0; side < numLanes; side++)
+  {
+    if(ui_selected(cnv, side))
     {
-      printf("%s conveyor:\n", sideString[side]);
+      printf("%s conveyor:\n", laneName(side));
       if(ctr == SMALL || ctr == ALL)
       {
-        counters.small[side]=0;
         printf("Reset small count\n");
       }
       if(ctr == BIG || ctr == ALL)
       {
-        counters.big[side]=0;
         printf("Reset big count\n");
       }
       if(ctr == COLLECTED || ctr == ALL)
       {
-        counters.collected[side]=0;
         printf("Reset collected count\n");
       }
       //sleep(1);
@@ -170,20 +205,43 @@ void ui_reset(int ctr, int cnv)
 
 
 /**
- * @brief used to read user input from terminal
+ * @brief used to read user input from terminal, a whole line at a time so
+ *        numbers of any length work and nothing is left over for the next
+ *        menu
  *
- * @return int returns int value of user input
+ * @param min lowest valid option
+ * @param max highest valid option
+ * @return int returns int value of user input, 0 if it isn't a number from
+ *         min to max
  */
-int ui_input(void)
+int ui_input(int min, int max)
 {
-  int len = 3;
-  int val = 0;
-  char str[len];
+  char str[32];
+  char *end;
+  long val;
+  int c;
 
   // Get user input
-  fgets(str, len, stdin);
+  if (fgets(str, sizeof str, stdin) == NULL)
+  {
+    return 0;
+  }
+  // Throw away the rest of an over long line
+  if (strchr(str, '\n') == NULL)
+  {
+    while ((c = getchar()) != '\n' && c != EOF)
+    {
+    }
+  }
   // Convert to int
-  sscanf(str, "%d\n", &val);
-
-  return(val);
+  val = strtol(str, &end, 10);
+  while (*end == ' ' || *end == '\t' || *end == '\n')
+  {
+    end++;
+  }
+  if (end == str || *end != '\0' || val < min || val > max)
+  {
+    return 0;
+  }
+  return (int)val;
 }
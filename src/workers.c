@@ -0,0 +1,216 @@
+/*
+ * ****************************************************************************
+ * File           : workers.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Worker thread pool. Threads are created once and sleep
+ *                  between batches, jobs in a batch are handed out through
+ *                  an atomic counter so faster threads take more of them.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <pthread.h>
+#include <stdlib.h>
+
+//Project Header Files
+#include "../inc/config.h"
+#include "../inc/workers.h"
+/* !SECTION Includes */
+
+/* SECTION Local Variables --------------------------------------------------*/
+static pthread_t *threads;
+static int numThreads;
+
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  poolStart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  poolDone  = PTHREAD_COND_INITIALIZER;
+
+/* Current batch, protected by poolLock apart from nextJob */
+static work_fn_t batchFn;
+static void *batchArg;
+static int batchJobs;
+static unsigned batchNum;
+static int busyThreads;
+static int stopping;
+
+/* Next job to hand out, on its own line as every thread hammers it */
+static struct
+{
+  int job;
+} __attribute__((aligned(CACHE_LINE))) nextJob;
+/* !SECTION Local Variables */
+
+// Function Decleration
+static void *workerMain(void *unused);
+static void runJobs(work_fn_t fn, void *arg, int jobs);
+
+
+// Global functions
+
+/**
+ * @brief Starts the worker threads. The thread calling workersRun also
+ *        runs jobs, so count - 1 extra threads are created.
+ *
+ * @param count - number of threads to run jobs on, including the caller
+ * @return int - 0 on success, -1 if threads could not be created
+ */
+int workersStart(int count)
+{
+  int thread;
+
+  if (count < 1)
+  {
+    count = 1;
+  }
+
+  threads = calloc(count, sizeof(pthread_t));
+  if (threads == NULL)
+  {
+    return -1;
+  }
+
+  for (thread = 0; thread < count - 1; thread++)
+  {
+    if (pthread_create(&threads[thread], NULL, workerMain, NULL) != 0)
+    {
+      break;
+    }
+  }
+  numThreads = thread + 1;
+
+  return (numThreads == count) ? 0 : -1;
+}
+
+/**
+ * @brief Stops and joins the worker threads
+ *
+ */
+void workersStop(void)
+{
+  int thread;
+
+  pthread_mutex_lock(&poolLock);
+  stopping = TRUE;
+  pthread_cond_broadcast(&poolStart);
+  pthread_mutex_unlock(&poolLock);
+
+  for (thread = 0; thread < numThreads - 1; thread++)
+  {
+    pthread_join(threads[thread], NULL);
+  }
+  free(threads);
+  threads = NULL;
+  numThreads = 0;
+  stopping = FALSE;
+}
+
+/**
+ * @brief Number of threads jobs are spread over
+ *
+ */
+int workersCount(void)
+{
+  return (numThreads > 0) ? numThreads : 1;
+}
+
+/**
+ * @brief Runs fn(arg, job) for every job and returns once all have finished.
+ *        Only one batch runs at a time.
+ *
+ * @param fn   - job function
+ * @param arg  - passed to every call of fn
+ * @param jobs - number of jobs
+ */
+void workersRun(work_fn_t fn, void *arg, int jobs)
+{
+  if (numThreads <= 1 || jobs <= 1)
+  {
+    int job;
+    for (job = 0; job < jobs; job++)
+    {
+      fn(arg, job);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&poolLock);
+  batchFn   = fn;
+  batchArg  = arg;
+  batchJobs = jobs;
+  __atomic_store_n(&nextJob.job, 0, __ATOMIC_RELAXED);
+  busyThreads = numThreads - 1;
+  batchNum++;
+  pthread_cond_broadcast(&poolStart);
+  pthread_mutex_unlock(&poolLock);
+
+  // Caller helps out rather than sitting idle
+  runJobs(fn, arg, jobs);
+
+  pthread_mutex_lock(&poolLock);
+  while (busyThreads > 0)
+  {
+    pthread_cond_wait(&poolDone, &poolLock);
+  }
+  pthread_mutex_unlock(&poolLock);
+}
+
+
+// Local functions
+
+/**
+ * @brief Takes jobs until there are none left in the batch
+ *
+ */
+static void runJobs(work_fn_t fn, void *arg, int jobs)
+{
+  int job;
+
+  while ((job = __atomic_fetch_add(&nextJob.job, 1, __ATOMIC_RELAXED)) < jobs)
+  {
+    fn(arg, job);
+  }
+}
+
+/**
+ * @brief Worker thread, waits for a new batch then helps run it
+ *
+ */
+static void *workerMain(void *unused)
+{
+  unsigned seen = 0;
+  work_fn_t fn;
+  void *arg;
+  int jobs;
+
+  while (1)
+  {
+    pthread_mutex_lock(&poolLock);
+    while (batchNum == seen && stopping == FALSE)
+    {
+      pthread_cond_wait(&poolStart, &poolLock);
+    }
+    if (stopping == TRUE)
+    {
+      pthread_mutex_unlock(&poolLock);
+      break;
+    }
+    seen = batchNum;
+    fn   = batchFn;
+    arg  = batchArg;
+    jobs = batchJobs;
+    pthread_mutex_unlock(&poolLock);
+
+    runJobs(fn, arg, jobs);
+
+    pthread_mutex_lock(&poolLock);
+    if (--busyThreads == 0)
+    {
+      pthread_cond_signal(&poolDone);
+    }
+    pthread_mutex_unlock(&poolLock);
+  }
+  return NULL;
+}
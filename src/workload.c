@@ -0,0 +1,314 @@
+/*
+ * ****************************************************************************
+ * File           : workload.c
+ * Project        : Real Time Embedded Systems Coursework
+ *
+ * Description    : Block arrival generator, see workload.h. Workloads are
+ *                  given as text such as "poisson,gap=0.8,small=0.3" so they
+ *                  can be passed on the command line or in a sweep spec.
+ * ****************************************************************************
+ * ChangeLog:
+ */
+
+/* SECTION Includes ---------------------------------------------------------*/
+//Standard C Libraries
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Project Header Files
+#include "../inc/config.h"
+#include "../inc/workload.h"
+/* !SECTION Includes */
+
+/* Longest workload spec accepted */
+#define WL_SPEC_LENGTH 256
+
+// Function Decleration
+static double wlExponential(rng_t *rng, double mean);
+static double wlGap(const workload_t *wl, wl_lane_t *lane);
+
+
+// Global functions
+
+/**
+ * @brief Fixed pitch workload matching the simulator defaults in config.h
+ *
+ * @param wl - workload to fill
+ */
+void workloadDefaults(workload_t *wl)
+{
+  memset(wl, 0, sizeof(*wl));
+  wl->kind       = WL_FIXED;
+  wl->gap        = SIM_ARRIVAL_GAP;
+  wl->minGap     = 0;
+  wl->smallRatio = WL_SMALL_RATIO;
+  wl->emptyRatio = 0;
+  wl->burst      = WL_BURST;
+  wl->burstGap   = WL_BURST_GAP;
+}
+
+/**
+ * @brief Builds a workload from text, "kind[,key=value...]" where kind is
+ *        fixed, poisson, bursty or trace and the keys are
+ *
+ *          gap=<s>       mean gap between blocks (bursts for bursty)
+ *          mingap=<s>    minimum gap between blocks
+ *          small=<0-1>   fraction of blocks that are small
+ *          empty=<0-1>   fraction of arrival slots left empty
+ *          burst=<n>     bursty: mean blocks per burst
+ *          burstgap=<s>  bursty: mean gap between blocks in a burst
+ *          file=<path>   trace: trace to take arrivals from, always the
+ *                        last key as the path runs to the end of the spec
+ *                        and may contain commas
+ *
+ *        Missing keys keep the values from workloadDefaults.
+ *
+ * @param wl   - workload to fill
+ * @param spec - workload text
+ * @return int - 0 on success, -1 on a bad spec or unreadable trace
+ */
+int workloadParse(workload_t *wl, const char *spec)
+{
+  char text[WL_SPEC_LENGTH];
+  char *save = NULL;
+  char *item;
+  char *value;
+  const char *file = NULL;
+
+  workloadDefaults(wl);
+
+  if (strlen(spec) >= sizeof(text))
+  {
+    return -1;
+  }
+  strcpy(text, spec);
+
+  item = strtok_r(text, ",", &save);
+  if (item == NULL)
+  {
+    return -1;
+  }
+
+  if (strcmp(item, "fixed") == 0)
+  {
+    wl->kind = WL_FIXED;
+  }
+  else if (strcmp(item, "poisson") == 0)
+  {
+    wl->kind = WL_POISSON;
+  }
+  else if (strcmp(item, "bursty") == 0)
+  {
+    wl->kind = WL_BURSTY;
+  }
+  else if (strcmp(item, "trace") == 0)
+  {
+    wl->kind = WL_TRACE;
+  }
+  else
+  {
+    return -1;
+  }
+
+  while ((item = strtok_r(NULL, ",", &save)) != NULL)
+  {
+    value = strchr(item, '=');
+    if (value == NULL)
+    {
+      return -1;
+    }
+    *value++ = '\0';
+
+    if (strcmp(item, "gap") == 0)
+    {
+      wl->gap = atof(value);
+    }
+    else if (strcmp(item, "mingap") == 0)
+    {
+      wl->minGap = atof(value);
+    }
+    else if (strcmp(item, "small") == 0)
+    {
+      wl->smallRatio = atof(value);
+    }
+    else if (strcmp(item, "empty") == 0)
+    {
+      wl->emptyRatio = atof(value);
+    }
+    else if (strcmp(item, "burst") == 0)
+    {
+      wl->burst = atof(value);
+    }
+    else if (strcmp(item, "burstgap") == 0)
+    {
+      wl->burstGap = atof(value);
+    }
+    else if (strcmp(item, "file") == 0)
+    {
+      file = spec + (value - text);
+      break;
+    }
+    else
+    {
+      return -1;
+    }
+  }
+
+  if (wl->gap <= 0 || wl->minGap < 0 || wl->burst < 1 || wl->burstGap <= 0 ||
+      wl->smallRatio < 0 || wl->smallRatio > 1 || wl->emptyRatio < 0 || wl->emptyRatio >= 1)
+  {
+    return -1;
+  }
+
+  if (wl->kind == WL_TRACE)
+  {
+    if (file == NULL || traceOpen(&wl->trace, file) != 0)
+    {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Releases a workload's trace, if it has one
+ *
+ * @param wl - workload to free
+ */
+void workloadFree(workload_t *wl)
+{
+  if (wl->kind == WL_TRACE)
+  {
+    traceClose(&wl->trace);
+  }
+}
+
+/**
+ * @brief Starts a lane's block stream. Lanes with the same seed and lane
+ *        number always get the same stream.
+ *
+ * @param wl      - workload the lane follows
+ * @param lane    - lane stream to set up
+ * @param laneNum - plant lane number
+ * @param seed    - plant seed
+ */
+void workloadLaneInit(const workload_t *wl, wl_lane_t *lane, int laneNum, uint64_t seed)
+{
+  uint64_t samples;
+
+  memset(lane, 0, sizeof(*lane));
+  rngSeed(&lane->rng, seed * MAX_LANES + laneNum);
+
+  if (wl->kind == WL_TRACE)
+  {
+    lane->next   = traceSamples(&wl->trace, laneNum, &samples);
+    lane->end    = lane->next + samples;
+    lane->tickUs = wl->trace.header->tickUs;
+  }
+  else if (wl->kind == WL_FIXED)
+  {
+    // Random phase so fixed pitch lanes are not all in step
+    lane->time = -rngUniform(&lane->rng) * wl->gap;
+  }
+  else
+  {
+    lane->time = 0;
+  }
+}
+
+/**
+ * @brief Next block on a lane
+ *
+ * @param wl   - workload the lane follows
+ * @param lane - lane stream
+ * @param time - set to the block's arrival time in seconds
+ * @param size - set to SIZE_SMALL or SIZE_BIG
+ * @return int - 0 on success, -1 when the lane has no more blocks
+ */
+int workloadNext(const workload_t *wl, wl_lane_t *lane, double *time, int *size)
+{
+  const trace_sample_t *sample;
+
+  if (wl->kind == WL_TRACE)
+  {
+    for (sample = lane->next; sample < lane->end; sample++)
+    {
+      if ((sample->valid & TRACE_SIZE) && sample->size != SIZE_NONE)
+      {
+        lane->next = sample + 1;
+        *time = (double)sample->time * lane->tickUs / 1e6;
+        *size = sample->size;
+        return 0;
+      }
+    }
+    lane->next = lane->end;
+    return -1;
+  }
+
+  // Empty slots still take up their gap on the belt
+  do
+  {
+    lane->time += wlGap(wl, lane);
+  } while (wl->emptyRatio > 0 && rngUniform(&lane->rng) < wl->emptyRatio);
+
+  if (lane->time < 0)
+  {
+    lane->time = 0;
+  }
+
+  *time = lane->time;
+  *size = (rngUniform(&lane->rng) < wl->smallRatio) ? SIZE_SMALL : SIZE_BIG;
+  return 0;
+}
+
+
+// Local functions
+
+/**
+ * @brief Exponentially distributed random time
+ *
+ * @param mean - mean time
+ */
+static double wlExponential(rng_t *rng, double mean)
+{
+  return -mean * log(1.0 - rngUniform(rng));
+}
+
+/**
+ * @brief Time from the last block to the next one
+ *
+ */
+static double wlGap(const workload_t *wl, wl_lane_t *lane)
+{
+  double gap;
+
+  switch (wl->kind)
+  {
+  case WL_POISSON:
+    gap = wlExponential(&lane->rng, wl->gap);
+    break;
+
+  case WL_BURSTY:
+    if (lane->burstLeft > 0)
+    {
+      lane->burstLeft--;
+      gap = wlExponential(&lane->rng, wl->burstGap);
+    }
+    else
+    {
+      // Geometric burst length with mean wl->burst
+      lane->burstLeft = (int)(log(1.0 - rngUniform(&lane->rng)) / log(1.0 - 1.0 / wl->burst));
+      gap = wlExponential(&lane->rng, wl->gap);
+    }
+    break;
+
+  case WL_FIXED:
+  default:
+    gap = wl->gap;
+    break;
+  }
+
+  return (gap < wl->minGap) ? wl->minGap : gap;
+}
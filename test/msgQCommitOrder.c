@@ -0,0 +1,100 @@
+/*****************************************************************************
+ * msgQCommitOrder.c - regression test of the v2lin VxWorks (R) compatibility
+ *                     layer: two loaned messages committed in reverse order
+ *                     with two receivers blocked on the queue.  Both must
+ *                     receive a message, none may be left queued, and the
+ *                     test must exit 0.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+
+#include <stdio.h>
+
+#include "vxWorks.h"
+#include "msgQLib.h"
+#include "sysLib.h"
+#include "taskLib.h"
+
+#define RECEIVERS 2
+
+static MSG_Q_ID queue;
+static int received[RECEIVERS];
+
+/*****************************************************************************
+**  receiver - waits up to two seconds for one message
+*****************************************************************************/
+static int
+    receiver( int num )
+{
+    char msg[4];
+
+    if ( msgQReceive( queue, msg, sizeof( msg ), 2 * sysClkRateGet() ) > 0 )
+        received[num] = TRUE;
+    return( OK );
+}
+
+int
+    main( void )
+{
+    char *first;
+    char *second;
+    int num;
+
+    queue = msgQCreate( 4, 4, MSG_Q_FIFO );
+    if ( queue == (MSG_Q_ID)NULL )
+    {
+        printf( "msgQCommitOrder: can't create the queue\n" );
+        return( 1 );
+    }
+
+    for ( num = 0; num < RECEIVERS; num++ )
+    {
+        if ( taskSpawn( "tReceiver", 50, 0, 0, (FUNCPTR)receiver,
+                        num, 0, 0, 0, 0, 0, 0, 0, 0, 0 ) == ERROR )
+        {
+            printf( "msgQCommitOrder: can't spawn a receiver\n" );
+            return( 1 );
+        }
+    }
+    taskDelay( 5 );
+
+    /*
+    **  The second commit wakes a receiver that can't get past the first
+    **  loan, the first commit then has to serve both
+    */
+    first = msgQLoan( queue, NO_WAIT, MSG_PRI_NORMAL );
+    second = msgQLoan( queue, NO_WAIT, MSG_PRI_NORMAL );
+    if ( (first == (char *)NULL) || (second == (char *)NULL) )
+    {
+        printf( "msgQCommitOrder: can't loan two messages\n" );
+        return( 1 );
+    }
+    second[0] = 2;
+    msgQCommit( queue, second, 1 );
+    taskDelay( 5 );
+    first[0] = 1;
+    msgQCommit( queue, first, 1 );
+    for ( num = 0; (num < 3 * sysClkRateGet()) &&
+                   !(received[0] && received[1]); num++ )
+        taskDelay( 1 );
+
+    if ( !received[0] || !received[1] || (msgQNumMsgs( queue ) != 0) )
+    {
+        printf( "msgQCommitOrder: r0=%d r1=%d queued=%d\n",
+                received[0], received[1], msgQNumMsgs( queue ) );
+        return( 1 );
+    }
+    msgQDelete( queue );
+    printf( "msgQCommitOrder: ok\n" );
+    return( 0 );
+}
@@ -0,0 +1,78 @@
+/*****************************************************************************
+ * semPiDelete.c - regression test of the v2lin VxWorks (R) compatibility
+ *                 layer: taskDelete of a task blocked in semTake on a
+ *                 priority inheritance mutex.  The mutex must stay usable
+ *                 and the test must exit 0.
+ *
+ * VxWorks is a registered trademark of Wind River Systems, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ ****************************************************************************/
+
+#include <stdio.h>
+
+#include "vxWorks.h"
+#include "semLib.h"
+#include "taskLib.h"
+
+static SEM_ID mutex;
+static int took = FALSE;
+
+/*****************************************************************************
+**  waiter - blocks on the mutex the main task holds until it is deleted
+*****************************************************************************/
+static int
+    waiter( void )
+{
+    if ( semTake( mutex, WAIT_FOREVER ) == OK )
+        took = TRUE;
+    return( OK );
+}
+
+int
+    main( void )
+{
+    int task;
+
+    mutex = semMCreate( SEM_Q_PRIORITY | SEM_INVERSION_SAFE );
+    if ( (mutex == (SEM_ID)NULL) || (semTake( mutex, NO_WAIT ) != OK) )
+    {
+        printf( "semPiDelete: can't create and take the mutex\n" );
+        return( 1 );
+    }
+
+    task = taskSpawn( "tWaiter", 50, 0, 0, (FUNCPTR)waiter,
+                      0, 0, 0, 0, 0, 0, 0, 0, 0, 0 );
+    if ( task == ERROR )
+    {
+        printf( "semPiDelete: can't spawn the waiter\n" );
+        return( 1 );
+    }
+    taskDelay( 5 );
+
+    if ( taskDelete( task ) != OK )
+    {
+        printf( "semPiDelete: taskDelete of the blocked waiter failed\n" );
+        return( 1 );
+    }
+
+    /*
+    **  The deleted waiter must have left no trace on the mutex
+    */
+    if ( (semGive( mutex ) != OK) || (semTake( mutex, NO_WAIT ) != OK) ||
+         (semGive( mutex ) != OK) || (semDelete( mutex ) != OK) || took )
+    {
+        printf( "semPiDelete: mutex unusable after deleting its waiter\n" );
+        return( 1 );
+    }
+    printf( "semPiDelete: ok\n" );
+    return( 0 );
+}